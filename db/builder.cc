@@ -19,6 +19,7 @@ Status BuildTable(const std::string& dbname,
                   const Options& options,
                   TableCache* table_cache,
                   Iterator* iter,
+                  int level,
                   FileMetaData* meta) {
   Status s;
   meta->file_size = 0;
@@ -27,7 +28,11 @@ Status BuildTable(const std::string& dbname,
   std::string fname = TableFileName(dbname, meta->number);
   if (iter->Valid()) {
     WritableFile* file;
-    s = env->NewWritableFile(fname, &file);//DHQ: 新创建一个file
+    if (options.use_direct_io_for_flush_and_compaction) {
+      s = env->NewDirectWritableFile(fname, &file);
+    } else {
+      s = env->NewWritableFile(fname, &file);//DHQ: 新创建一个file
+    }
     if (!s.ok()) {
       return s;
     }
@@ -37,7 +42,13 @@ Status BuildTable(const std::string& dbname,
     for (; iter->Valid(); iter->Next()) {//没有考虑seqno，如果用户多次插入同一个key，全部持久化？还是在插入memtable时检查了？
       Slice key = iter->key();
       meta->largest.DecodeFrom(key);
-      builder->Add(key, iter->value()); //DHQ: Key/val Add进去
+      ParsedInternalKey ikey;
+      if (ParseInternalKey(key, &ikey)) {
+        builder->Add(key, iter->value(), ikey.sequence,
+                     ikey.type == kTypeDeletion);
+      } else {
+        builder->Add(key, iter->value()); //DHQ: Key/val Add进去
+      }
     }
 
     // Finish and check for builder errors
@@ -62,7 +73,9 @@ Status BuildTable(const std::string& dbname,
       // Verify that the table is usable
       Iterator* it = table_cache->NewIterator(ReadOptions(),
                                               meta->number,
-                                              meta->file_size);
+                                              meta->file_size,
+                                              nullptr,
+                                              level);
       s = it->status();
       delete it;
     }
@@ -21,12 +21,15 @@ class VersionEdit;
 // will be named according to meta->number.  On success, the rest of
 // *meta will be filled with metadata about the generated table.
 // If no data is present in *iter, meta->file_size will be set to
-// zero, and no Table file will be produced.
+// zero, and no Table file will be produced.  "level" is the level the
+// table will be added to, which the table cache uses as a hint when it
+// opens the table to verify it.
 Status BuildTable(const std::string& dbname,
                   Env* env,
                   const Options& options,
                   TableCache* table_cache,
                   Iterator* iter,
+                  int level,
                   FileMetaData* meta);
 
 }  // namespace leveldb
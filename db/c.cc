@@ -29,6 +29,7 @@ using leveldb::Logger;
 using leveldb::NewBloomFilterPolicy;
 using leveldb::NewLRUCache;
 using leveldb::Options;
+using leveldb::PinnableSlice;
 using leveldb::RandomAccessFile;
 using leveldb::Range;
 using leveldb::ReadOptions;
@@ -55,6 +56,7 @@ struct leveldb_randomfile_t   { RandomAccessFile* rep; };
 struct leveldb_writablefile_t { WritableFile*     rep; };
 struct leveldb_logger_t       { Logger*           rep; };
 struct leveldb_filelock_t     { FileLock*         rep; };
+struct leveldb_pinnableslice_t { PinnableSlice    rep; };
 
 struct leveldb_comparator_t : public Comparator {
   void* state_;
@@ -214,6 +216,23 @@ char* leveldb_get(
   return result;
 }
 
+leveldb_pinnableslice_t* leveldb_get_pinned(
+    leveldb_t* db,
+    const leveldb_readoptions_t* options,
+    const char* key, size_t keylen,
+    char** errptr) {
+  leveldb_pinnableslice_t* result = new leveldb_pinnableslice_t;
+  Status s = db->rep->Get(options->rep, Slice(key, keylen), &result->rep);
+  if (!s.ok()) {
+    delete result;
+    result = nullptr;
+    if (!s.IsNotFound()) {
+      SaveError(errptr, s);
+    }
+  }
+  return result;
+}
+
 leveldb_iterator_t* leveldb_create_iterator(
     leveldb_t* db,
     const leveldb_readoptions_t* options) {
@@ -274,6 +293,16 @@ void leveldb_compact_range(
       (limit_key ? (b = Slice(limit_key, limit_key_len), &b) : nullptr));
 }
 
+const char* leveldb_pinnableslice_value(const leveldb_pinnableslice_t* slice,
+                                        size_t* vallen) {
+  *vallen = slice->rep.size();
+  return slice->rep.data();
+}
+
+void leveldb_pinnableslice_destroy(leveldb_pinnableslice_t* slice) {
+  delete slice;
+}
+
 void leveldb_destroy_db(
     const leveldb_options_t* options,
     const char* name,
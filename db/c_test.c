@@ -59,10 +59,21 @@ static void CheckGet(
   char* err = NULL;
   size_t val_len;
   char* val;
+  leveldb_pinnableslice_t* pinned;
   val = leveldb_get(db, options, key, strlen(key), &val_len, &err);
   CheckNoError(err);
   CheckEqual(expected, val, val_len);
   Free(&val);
+
+  pinned = leveldb_get_pinned(db, options, key, strlen(key), &err);
+  CheckNoError(err);
+  if (pinned == NULL) {
+    CheckEqual(expected, NULL, 0);
+  } else {
+    val = (char*) leveldb_pinnableslice_value(pinned, &val_len);
+    CheckEqual(expected, val, val_len);
+    leveldb_pinnableslice_destroy(pinned);
+  }
 }
 
 static void CheckIter(leveldb_iterator_t* iter,
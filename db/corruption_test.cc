@@ -270,6 +270,21 @@ TEST(CorruptionTest, TableFileIndexData) {
   Check(5000, 9999);
 }
 
+TEST(CorruptionTest, TableFilePreload) {
+  Build(10000);  // Enough to build multiple Tables
+  DBImpl* dbi = reinterpret_cast<DBImpl*>(db_);
+  dbi->TEST_CompactMemTable();
+
+  Corrupt(kTableFile, -2000, 500);
+  options_.preload_tables_on_open = true;
+  Reopen();  // Errors are left to the first use of the table
+  options_.paranoid_checks = true;
+  Status s = TryReopen();
+  ASSERT_TRUE(s.IsCorruption()) << s.ToString();
+  options_.preload_tables_on_open = false;
+  Reopen();
+}
+
 TEST(CorruptionTest, MissingDescriptor) {
   Build(1000);
   RepairDB();
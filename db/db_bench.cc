@@ -6,11 +6,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "leveldb/cache.h"
+#include "leveldb/comparator.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/persistent_cache.h"
 #include "leveldb/write_batch.h"
 #include "port/port.h"
+#include "table/block.h"
+#include "table/block_builder.h"
+#include "table/format.h"
+#include "table/merger.h"
+#include "util/coding.h"
 #include "util/crc32c.h"
 #include "util/histogram.h"
 #include "util/mutexlock.h"
@@ -28,12 +35,20 @@
 //      deleterandom  -- delete N keys in random order
 //      readseq       -- read N times sequentially
 //      readreverse   -- read N times in reverse order
+//      readparallel  -- read the whole DB with DB::ParallelScan() split
+//                       into --scan_shards shards
 //      readrandom    -- read N times in random order
 //      readmissing   -- read N missing keys in random order
 //      readhot       -- read N times in random order from 1% section of DB
 //      seekrandom    -- N random seeks
 //      open          -- cost of opening a DB
 //      crc32c        -- repeated crc32c of 4K of data
+//      bloomprobe    -- N probes of a bloom filter built over N keys
+//      blockedbloomprobe -- same as bloomprobe, for the cache-line-blocked
+//                       bloom filter
+//      ribbonprobe   -- same as bloomprobe, for the equivalent ribbon filter
+//      mergeiter     -- scan forward and in reverse over the merge of N keys
+//                       spread over --merge_width blocks
 //      acquireload   -- load N*1000 times
 //   Meta operations:
 //      compact     -- Compact the entire DB
@@ -95,13 +110,82 @@ static int FLAGS_block_size = 0;
 // Negative means use default settings.
 static int FLAGS_cache_size = -1;
 
+// If true, use NewClockCache() instead of NewLRUCache() for --cache_size.
+static bool FLAGS_clock_cache = false;
+
+// Fraction of --cache_size reserved for blocks used more than once and for
+// index and filter blocks.  0 makes the block cache a plain LRU cache.
+static double FLAGS_cache_high_pri_pool_ratio = 0.5;
+
+// Number of bytes to use as a cache of point lookup results (0 = none).
+static int FLAGS_row_cache_size = 0;
+
+// Number of bytes to use as a cache of compressed blocks behind the block
+// cache (0 = none).
+static int FLAGS_compressed_cache_size = 0;
+
+// If non-null, keep a persistent cache of blocks in this directory, which
+// should be on a faster device than --db.
+static const char* FLAGS_persistent_cache_dir = nullptr;
+
+// Number of bytes the persistent cache may use.
+static int FLAGS_persistent_cache_size = 256 << 20;
+
 // Maximum number of files to keep open at the same time (use default if == 0)
 static int FLAGS_open_files = 0;
 
+// If true, open the table files of an existing database in DB::Open.
+static bool FLAGS_preload_tables_on_open = false;
+
+// Table files at higher levels than this are read without mmap.
+static int FLAGS_mmap_max_level = 6;
+
+// Maximum number of files the Env may mmap (use default if < 0)
+static int FLAGS_max_mapped_files = -1;
+
+// If true, hint random access when opening table files.
+static bool FLAGS_advise_random_on_open = false;
+
+// If true, read table files with direct I/O.
+static bool FLAGS_use_direct_reads = false;
+
+// If true, write table files with direct I/O.
+static bool FLAGS_use_direct_io_for_flush_and_compaction = false;
+
+// Number of children merged by the mergeiter benchmark.
+static int FLAGS_merge_width = 16;
+
 // Bloom filter bits per key.
 // Negative means use default settings.
 static int FLAGS_bloom_bits = -1;
 
+// If true, use the cache-line-blocked bloom filter for --bloom_bits.
+static bool FLAGS_blocked_bloom = false;
+
+// ReadOptions::readahead_size of the readseq and readreverse iterators.
+static int FLAGS_readahead_size = 0;
+
+// ReadOptions::async_prefetch of the readseq and readreverse iterators.
+static bool FLAGS_async_prefetch = false;
+
+// ReadOptions::pin_data of the readseq and readreverse iterators.
+static bool FLAGS_pin_data = false;
+
+// If true, seekrandom re-seeks one ReadOptions::tailing iterator instead
+// of creating an iterator per seek.
+static bool FLAGS_tailing = false;
+
+// If true, seekrandom re-seeks one iterator after calling Iterator::Refresh()
+// instead of creating an iterator per seek.
+static bool FLAGS_refresh = false;
+
+// Number of shards of the readparallel benchmark.
+static int FLAGS_scan_shards = 4;
+
+// If true, readrandom and readhot use the DB::Get() overload that pins
+// values instead of copying them.
+static bool FLAGS_pinned_get = false;
+
 // If true, do not destroy the existing database.  If you set this
 // flag and also specify a benchmark that wants a fresh database, that
 // benchmark will fail.
@@ -220,6 +304,12 @@ class Stats {
     AppendWithSpace(&message_, msg);
   }
 
+  // Like "n" calls of FinishedSingleOp(), for ops that were not timed
+  // one at a time.
+  void FinishedOps(int n) {
+    done_ += n;
+  }
+
   void FinishedSingleOp() {
     if (FLAGS_histogram) {
       double now = g_env->NowMicros();
@@ -317,6 +407,9 @@ struct ThreadState {
 class Benchmark {
  private:
   Cache* cache_;
+  Cache* row_cache_;
+  Cache* compressed_cache_;
+  PersistentCache* persistent_cache_;
   const FilterPolicy* filter_policy_;
   DB* db_;
   int num_;
@@ -402,10 +495,18 @@ class Benchmark {
 
  public:
   Benchmark()
-  : cache_(FLAGS_cache_size >= 0 ? NewLRUCache(FLAGS_cache_size) : nullptr),
-    filter_policy_(FLAGS_bloom_bits >= 0
-                   ? NewBloomFilterPolicy(FLAGS_bloom_bits)
-                   : nullptr),
+  : cache_(FLAGS_cache_size < 0 ? nullptr
+           : FLAGS_clock_cache ? NewClockCache(FLAGS_cache_size)
+           : NewLRUCache(FLAGS_cache_size, FLAGS_cache_high_pri_pool_ratio)),
+    row_cache_(FLAGS_row_cache_size > 0 ? NewLRUCache(FLAGS_row_cache_size)
+               : nullptr),
+    compressed_cache_(FLAGS_compressed_cache_size > 0
+                      ? NewLRUCache(FLAGS_compressed_cache_size) : nullptr),
+    persistent_cache_(nullptr),
+    filter_policy_(FLAGS_bloom_bits < 0 ? nullptr
+                   : FLAGS_blocked_bloom
+                   ? NewBlockedBloomFilterPolicy(FLAGS_bloom_bits)
+                   : NewBloomFilterPolicy(FLAGS_bloom_bits)),
     db_(nullptr),
     num_(FLAGS_num),
     value_size_(FLAGS_value_size),
@@ -422,14 +523,31 @@ class Benchmark {
     if (!FLAGS_use_existing_db) {
       DestroyDB(FLAGS_db, Options());
     }
+    OpenPersistentCache();
   }
 
   ~Benchmark() {
     delete db_;
     delete cache_;
+    delete row_cache_;
+    delete compressed_cache_;
+    delete persistent_cache_;
     delete filter_policy_;
   }
 
+  void OpenPersistentCache() {
+    if (FLAGS_persistent_cache_dir == nullptr) {
+      return;
+    }
+    Status s = NewPersistentCache(g_env, FLAGS_persistent_cache_dir,
+                                  FLAGS_persistent_cache_size,
+                                  &persistent_cache_);
+    if (!s.ok()) {
+      fprintf(stderr, "persistent cache error: %s\n", s.ToString().c_str());
+      exit(1);
+    }
+  }
+
   void Run() {
     PrintHeader();
     Open();
@@ -488,6 +606,8 @@ class Benchmark {
         method = &Benchmark::ReadSequential;
       } else if (name == Slice("readreverse")) {
         method = &Benchmark::ReadReverse;
+      } else if (name == Slice("readparallel")) {
+        method = &Benchmark::ReadParallel;
       } else if (name == Slice("readrandom")) {
         method = &Benchmark::ReadRandom;
       } else if (name == Slice("readmissing")) {
@@ -510,6 +630,14 @@ class Benchmark {
         method = &Benchmark::Compact;
       } else if (name == Slice("crc32c")) {
         method = &Benchmark::Crc32c;
+      } else if (name == Slice("bloomprobe")) {
+        method = &Benchmark::BloomProbe;
+      } else if (name == Slice("blockedbloomprobe")) {
+        method = &Benchmark::BlockedBloomProbe;
+      } else if (name == Slice("ribbonprobe")) {
+        method = &Benchmark::RibbonProbe;
+      } else if (name == Slice("mergeiter")) {
+        method = &Benchmark::MergeIter;
       } else if (name == Slice("acquireload")) {
         method = &Benchmark::AcquireLoad;
       } else if (name == Slice("snappycomp")) {
@@ -639,6 +767,99 @@ class Benchmark {
     thread->stats.AddMessage(label);
   }
 
+  void BloomProbe(ThreadState* thread) {
+    FilterProbe(thread, NewBloomFilterPolicy(BitsPerKey()));
+  }
+
+  void BlockedBloomProbe(ThreadState* thread) {
+    FilterProbe(thread, NewBlockedBloomFilterPolicy(BitsPerKey()));
+  }
+
+  void RibbonProbe(ThreadState* thread) {
+    FilterProbe(thread, NewRibbonFilterPolicy(BitsPerKey()));
+  }
+
+  static int BitsPerKey() {
+    return FLAGS_bloom_bits >= 0 ? FLAGS_bloom_bits : 10;
+  }
+
+  // Builds one filter over num_ keys and probes it reads_ times with
+  // random keys, half of which were added to the filter.
+  void FilterProbe(ThreadState* thread, const FilterPolicy* policy) {
+    std::string keys(num_ * 8, '\0');
+    std::vector<Slice> key_slices(num_);
+    for (int i = 0; i < num_; i++) {
+      EncodeFixed64(&keys[i * 8], i);
+      key_slices[i] = Slice(&keys[i * 8], 8);
+    }
+    std::string filter;
+    policy->CreateFilter(key_slices.data(), num_, &filter);
+    thread->stats.Start();  // Only time the probes
+
+    char key[8];
+    int found = 0;
+    for (int i = 0; i < reads_; i++) {
+      EncodeFixed64(key, thread->rand.Next() % (2 * num_));
+      if (policy->KeyMayMatch(Slice(key, 8), filter)) {
+        found++;
+      }
+      thread->stats.FinishedSingleOp();
+    }
+    char msg[100];
+    snprintf(msg, sizeof(msg), "(%d of %d match; filter %d bytes)",
+             found, reads_, static_cast<int>(filter.size()));
+    thread->stats.AddMessage(msg);
+    delete policy;
+  }
+
+  void MergeIter(ThreadState* thread) {
+    // Key i goes to child i % width, so that every step of the merge
+    // switches children.
+    const int width = FLAGS_merge_width;
+    Options options;
+    std::vector<std::string> contents(width);
+    for (int c = 0; c < width; c++) {
+      BlockBuilder builder(&options);
+      char key[100];
+      for (int i = c; i < num_; i += width) {
+        snprintf(key, sizeof(key), "%016d", i);
+        builder.Add(key, Slice());
+      }
+      contents[c] = builder.Finish().ToString();
+    }
+    std::vector<Block*> blocks;
+    std::vector<Iterator*> children;
+    for (int c = 0; c < width; c++) {
+      BlockContents block_contents;
+      block_contents.data = contents[c];
+      block_contents.cachable = false;
+      block_contents.heap_allocated = false;
+      blocks.push_back(new Block(block_contents));
+      children.push_back(blocks.back()->NewIterator(BytewiseComparator()));
+    }
+    Iterator* iter = NewMergingIterator(BytewiseComparator(), &children[0],
+                                        width);
+    thread->stats.Start();  // Only time the scans
+
+    int64_t bytes = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      bytes += iter->key().size();
+      thread->stats.FinishedSingleOp();
+    }
+    for (iter->SeekToLast(); iter->Valid(); iter->Prev()) {
+      bytes += iter->key().size();
+      thread->stats.FinishedSingleOp();
+    }
+    thread->stats.AddBytes(bytes);
+    char msg[100];
+    snprintf(msg, sizeof(msg), "(%d children)", width);
+    thread->stats.AddMessage(msg);
+    delete iter;
+    for (int c = 0; c < width; c++) {
+      delete blocks[c];
+    }
+  }
+
   void AcquireLoad(ThreadState* thread) {
     int dummy;
     port::AtomicPointer ap(&dummy);
@@ -708,10 +929,19 @@ class Benchmark {
     options.env = g_env;
     options.create_if_missing = !FLAGS_use_existing_db;
     options.block_cache = cache_;
+    options.row_cache = row_cache_;
+    options.compressed_block_cache = compressed_cache_;
+    options.persistent_cache = persistent_cache_;
     options.write_buffer_size = FLAGS_write_buffer_size;
     options.max_file_size = FLAGS_max_file_size;
     options.block_size = FLAGS_block_size;
     options.max_open_files = FLAGS_open_files;
+    options.preload_tables_on_open = FLAGS_preload_tables_on_open;
+    options.mmap_max_level = FLAGS_mmap_max_level;
+    options.advise_random_on_open = FLAGS_advise_random_on_open;
+    options.use_direct_reads = FLAGS_use_direct_reads;
+    options.use_direct_io_for_flush_and_compaction =
+        FLAGS_use_direct_io_for_flush_and_compaction;
     options.filter_policy = filter_policy_;
     options.reuse_logs = FLAGS_reuse_logs;
     Status s = DB::Open(options, FLAGS_db, &db_);
@@ -768,7 +998,11 @@ class Benchmark {
   }
 
   void ReadSequential(ThreadState* thread) {
-    Iterator* iter = db_->NewIterator(ReadOptions());
+    ReadOptions options;
+    options.readahead_size = FLAGS_readahead_size;
+    options.async_prefetch = FLAGS_async_prefetch;
+    options.pin_data = FLAGS_pin_data;
+    Iterator* iter = db_->NewIterator(options);
     int i = 0;
     int64_t bytes = 0;
     for (iter->SeekToFirst(); i < reads_ && iter->Valid(); iter->Next()) {
@@ -780,8 +1014,47 @@ class Benchmark {
     thread->stats.AddBytes(bytes);
   }
 
+  // Entries and bytes seen by each shard of ReadParallel()
+  struct ShardCounts {
+    std::vector<int64_t> entries;
+    std::vector<int64_t> bytes;
+  };
+
+  static bool CountShardEntry(void* arg, int shard, const Slice& key,
+                              const Slice& value) {
+    ShardCounts* counts = reinterpret_cast<ShardCounts*>(arg);
+    counts->entries[shard]++;
+    counts->bytes[shard] += key.size() + value.size();
+    return true;
+  }
+
+  void ReadParallel(ThreadState* thread) {
+    ShardCounts counts;
+    counts.entries.resize(FLAGS_scan_shards);
+    counts.bytes.resize(FLAGS_scan_shards);
+    Status s = db_->ParallelScan(ReadOptions(), nullptr, nullptr,
+                                 FLAGS_scan_shards, &CountShardEntry, &counts);
+    if (!s.ok()) {
+      fprintf(stderr, "scan error: %s\n", s.ToString().c_str());
+      exit(1);
+    }
+    int used = 0;
+    for (int i = 0; i < FLAGS_scan_shards; i++) {
+      thread->stats.FinishedOps(static_cast<int>(counts.entries[i]));
+      thread->stats.AddBytes(counts.bytes[i]);
+      if (counts.entries[i] > 0) used++;
+    }
+    char msg[100];
+    snprintf(msg, sizeof(msg), "(%d shards)", used);
+    thread->stats.AddMessage(msg);
+  }
+
   void ReadReverse(ThreadState* thread) {
-    Iterator* iter = db_->NewIterator(ReadOptions());
+    ReadOptions options;
+    options.readahead_size = FLAGS_readahead_size;
+    options.async_prefetch = FLAGS_async_prefetch;
+    options.pin_data = FLAGS_pin_data;
+    Iterator* iter = db_->NewIterator(options);
     int i = 0;
     int64_t bytes = 0;
     for (iter->SeekToLast(); i < reads_ && iter->Valid(); iter->Prev()) {
@@ -796,12 +1069,15 @@ class Benchmark {
   void ReadRandom(ThreadState* thread) {
     ReadOptions options;
     std::string value;
+    PinnableSlice pinned;
     int found = 0;
     for (int i = 0; i < reads_; i++) {
       char key[100];
       const int k = thread->rand.Next() % FLAGS_num;
       snprintf(key, sizeof(key), "%016d", k);
-      if (db_->Get(options, key, &value).ok()) {
+      Status s = FLAGS_pinned_get ? db_->Get(options, key, &pinned)
+                                  : db_->Get(options, key, &value);
+      if (s.ok()) {
         found++;
       }
       thread->stats.FinishedSingleOp();
@@ -826,29 +1102,43 @@ class Benchmark {
   void ReadHot(ThreadState* thread) {
     ReadOptions options;
     std::string value;
+    PinnableSlice pinned;
     const int range = (FLAGS_num + 99) / 100;
     for (int i = 0; i < reads_; i++) {
       char key[100];
       const int k = thread->rand.Next() % range;
       snprintf(key, sizeof(key), "%016d", k);
-      db_->Get(options, key, &value);
+      if (FLAGS_pinned_get) {
+        db_->Get(options, key, &pinned);
+      } else {
+        db_->Get(options, key, &value);
+      }
       thread->stats.FinishedSingleOp();
     }
   }
 
   void SeekRandom(ThreadState* thread) {
     ReadOptions options;
+    options.tailing = FLAGS_tailing;
+    Iterator* reused_iter = (FLAGS_tailing || FLAGS_refresh)
+                            ? db_->NewIterator(options) : nullptr;
     int found = 0;
     for (int i = 0; i < reads_; i++) {
-      Iterator* iter = db_->NewIterator(options);
+      Iterator* iter = reused_iter;
+      if (iter == nullptr) {
+        iter = db_->NewIterator(options);
+      } else if (FLAGS_refresh) {
+        iter->Refresh();
+      }
       char key[100];
       const int k = thread->rand.Next() % FLAGS_num;
       snprintf(key, sizeof(key), "%016d", k);
       iter->Seek(key); //DHQ: 先 Seek，然后判断 key 确定是否 seek 成功。
       if (iter->Valid() && iter->key() == key) found++;
-      delete iter;
+      if (iter != reused_iter) delete iter;
       thread->stats.FinishedSingleOp();
     }
+    delete reused_iter;
     char msg[100];
     snprintf(msg, sizeof(msg), "(%d of %d found)", found, num_);
     thread->stats.AddMessage(msg);
@@ -989,10 +1279,68 @@ int main(int argc, char** argv) {
       FLAGS_block_size = n;
     } else if (sscanf(argv[i], "--cache_size=%d%c", &n, &junk) == 1) {
       FLAGS_cache_size = n;
+    } else if (sscanf(argv[i], "--clock_cache=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_clock_cache = n;
+    } else if (sscanf(argv[i], "--cache_high_pri_pool_ratio=%lf%c",
+                      &d, &junk) == 1 && d >= 0.0 && d <= 1.0) {
+      FLAGS_cache_high_pri_pool_ratio = d;
+    } else if (sscanf(argv[i], "--row_cache_size=%d%c", &n, &junk) == 1) {
+      FLAGS_row_cache_size = n;
+    } else if (sscanf(argv[i], "--compressed_cache_size=%d%c",
+                      &n, &junk) == 1) {
+      FLAGS_compressed_cache_size = n;
+    } else if (strncmp(argv[i], "--persistent_cache_dir=", 23) == 0) {
+      FLAGS_persistent_cache_dir = argv[i] + 23;
+    } else if (sscanf(argv[i], "--persistent_cache_size=%d%c",
+                      &n, &junk) == 1) {
+      FLAGS_persistent_cache_size = n;
     } else if (sscanf(argv[i], "--bloom_bits=%d%c", &n, &junk) == 1) {
       FLAGS_bloom_bits = n;
+    } else if (sscanf(argv[i], "--blocked_bloom=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_blocked_bloom = n;
+    } else if (sscanf(argv[i], "--readahead_size=%d%c", &n, &junk) == 1) {
+      FLAGS_readahead_size = n;
+    } else if (sscanf(argv[i], "--async_prefetch=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_async_prefetch = n;
+    } else if (sscanf(argv[i], "--pin_data=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_pin_data = n;
+    } else if (sscanf(argv[i], "--tailing=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_tailing = n;
+    } else if (sscanf(argv[i], "--refresh=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_refresh = n;
+    } else if (sscanf(argv[i], "--scan_shards=%d%c", &n, &junk) == 1 &&
+               n > 0) {
+      FLAGS_scan_shards = n;
+    } else if (sscanf(argv[i], "--pinned_get=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_pinned_get = n;
     } else if (sscanf(argv[i], "--open_files=%d%c", &n, &junk) == 1) {
       FLAGS_open_files = n;
+    } else if (sscanf(argv[i], "--preload_tables_on_open=%d%c",
+                      &n, &junk) == 1 && (n == 0 || n == 1)) {
+      FLAGS_preload_tables_on_open = n;
+    } else if (sscanf(argv[i], "--mmap_max_level=%d%c", &n, &junk) == 1) {
+      FLAGS_mmap_max_level = n;
+    } else if (sscanf(argv[i], "--max_mapped_files=%d%c", &n, &junk) == 1) {
+      FLAGS_max_mapped_files = n;
+    } else if (sscanf(argv[i], "--advise_random_on_open=%d%c",
+                      &n, &junk) == 1 && (n == 0 || n == 1)) {
+      FLAGS_advise_random_on_open = n;
+    } else if (sscanf(argv[i], "--use_direct_reads=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_use_direct_reads = n;
+    } else if (sscanf(argv[i], "--use_direct_io_for_flush_and_compaction=%d%c",
+                      &n, &junk) == 1 && (n == 0 || n == 1)) {
+      FLAGS_use_direct_io_for_flush_and_compaction = n;
+    } else if (sscanf(argv[i], "--merge_width=%d%c", &n, &junk) == 1 &&
+               n > 0) {
+      FLAGS_merge_width = n;
     } else if (strncmp(argv[i], "--db=", 5) == 0) {
       FLAGS_db = argv[i] + 5;
     } else {
@@ -1002,6 +1350,9 @@ int main(int argc, char** argv) {
   }
 
   leveldb::g_env = leveldb::Env::Default();
+  if (FLAGS_max_mapped_files >= 0) {
+    leveldb::g_env->SetMaxMappedFiles(FLAGS_max_mapped_files);
+  }
 
   // Choose a location for the test database if none given with --db=<path>
   if (FLAGS_db == nullptr) {
@@ -8,6 +8,7 @@
 #include <stdio.h>
 
 #include <algorithm>
+#include <list>
 #include <set>
 #include <string>
 #include <vector>
@@ -92,14 +93,18 @@ static void ClipToRange(T* ptr, V minvalue, V maxvalue) {
 Options SanitizeOptions(const std::string& dbname,
                         const InternalKeyComparator* icmp,
                         const InternalFilterPolicy* ipolicy,
+                        const InternalKeySliceTransform* iprefix,
                         const Options& src) {
   Options result = src;
   result.comparator = icmp;
   result.filter_policy = (src.filter_policy != nullptr) ? ipolicy : nullptr;
+  result.prefix_extractor =
+      (src.prefix_extractor != nullptr) ? iprefix : nullptr;
   ClipToRange(&result.max_open_files,    64 + kNumNonTableCacheFiles, 50000);
   ClipToRange(&result.write_buffer_size, 64<<10,                      1<<30);
   ClipToRange(&result.max_file_size,     1<<20,                       1<<30);
   ClipToRange(&result.block_size,        1<<10,                       4<<20);
+  ClipToRange(&result.max_file_opening_threads, 1,                    64);
   if (result.info_log == nullptr) {
     // Open a log file in the same directory as the db
     src.env->CreateDir(dbname);  // In case it does not exist
@@ -125,8 +130,10 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
     : env_(raw_options.env),
       internal_comparator_(raw_options.comparator),
       internal_filter_policy_(raw_options.filter_policy),
+      internal_prefix_extractor_(raw_options.prefix_extractor),
       options_(SanitizeOptions(dbname, &internal_comparator_,
-                               &internal_filter_policy_, raw_options)),
+                               &internal_filter_policy_,
+                               &internal_prefix_extractor_, raw_options)),
       owns_info_log_(options_.info_log != raw_options.info_log),
       owns_cache_(options_.block_cache != raw_options.block_cache),
       dbname_(dbname),
@@ -259,6 +266,7 @@ void DBImpl::DeleteObsoleteFiles() {
         case kCurrentFile:
         case kDBLockFile:
         case kInfoLogFile:
+        case kIdentityFile:
           keep = true;
           break;
       }
@@ -275,6 +283,97 @@ void DBImpl::DeleteObsoleteFiles() {
     }
   }
 }
+
+namespace {
+
+// State shared by the threads of DBImpl::PreloadTables()
+struct PreloadState {
+  TableCache* table_cache;
+  Logger* info_log;
+  std::vector<FileMetaData*> files;
+  std::vector<int> levels;  // Level of each file
+
+  port::Mutex mu;
+  port::CondVar cv;
+  size_t next GUARDED_BY(mu);  // Index of the next file to open
+  int running GUARDED_BY(mu);  // Threads that have not finished
+  Status status GUARDED_BY(mu);  // First error
+
+  PreloadState() : cv(&mu), next(0), running(0) { }
+};
+
+}  // namespace
+
+static void PreloadWork(void* arg) {
+  PreloadState* state = reinterpret_cast<PreloadState*>(arg);
+  MutexLock l(&state->mu);
+  while (state->next < state->files.size()) {
+    const size_t i = state->next++;
+    const FileMetaData* f = state->files[i];
+    state->mu.Unlock();
+    Status s = state->table_cache->Preload(f->number, f->file_size,
+                                           state->levels[i]);
+    if (!s.ok()) {
+      Log(state->info_log, "Preloading table #%llu: %s\n",
+          static_cast<unsigned long long>(f->number), s.ToString().c_str());
+    }
+    state->mu.Lock();
+    if (state->status.ok()) {
+      state->status = s;
+    }
+  }
+  state->running--;
+  state->cv.SignalAll();
+}
+
+Status DBImpl::PreloadTables() {
+  mutex_.AssertHeld();
+  PreloadState state;
+  state.table_cache = table_cache_;
+  state.info_log = options_.info_log;
+
+  // Files that do not fit in the table cache would only evict others.
+  const size_t limit = TableCacheSize(options_);
+  Version* current = versions_->current();
+  current->Ref();
+  for (int level = 0; level < config::kNumLevels; level++) {
+    std::vector<FileMetaData*> files;
+    current->GetOverlappingInputs(level, nullptr, nullptr, &files);
+    for (size_t i = 0; i < files.size() && state.files.size() < limit; i++) {
+      state.files.push_back(files[i]);
+      state.levels.push_back(level);
+    }
+  }
+  mutex_.Unlock();
+
+  // This thread opens files along with the threads it starts.
+  const int threads = std::min<size_t>(options_.max_file_opening_threads,
+                                       state.files.size());
+  Status s;
+  {
+    MutexLock l(&state.mu);
+    state.running = threads;
+    for (int i = 1; i < threads; i++) {
+      env_->StartThread(&PreloadWork, &state);
+    }
+  }
+  if (threads > 0) {
+    PreloadWork(&state);
+  }
+  {
+    MutexLock l(&state.mu);
+    while (state.running > 0) {
+      state.cv.Wait();
+    }
+    s = state.status;
+  }
+  Log(options_.info_log, "Preloaded %d table files on %d threads\n",
+      static_cast<int>(state.files.size()), threads);
+
+  mutex_.Lock();
+  current->Unref();
+  return options_.paranoid_checks ? s : Status::OK();
+}
 //DHQ： edit，是用来记录RecoverLogFile获得的修改。而不是manifest中记录的edit，后者有 VerstionSet->Recovery()处理了
 Status DBImpl::Recover(VersionEdit* edit, bool *save_manifest) {
   mutex_.AssertHeld();
@@ -306,6 +405,17 @@ Status DBImpl::Recover(VersionEdit* edit, bool *save_manifest) {
     }
   }
 
+  if (options_.persistent_cache != nullptr) {
+    // Keys of the persistent cache include the identity, so that blocks
+    // of another db never match tables of this one.
+    std::string identity;
+    s = GetOrCreateIdentity(env_, dbname_, &identity);
+    if (!s.ok()) {
+      return s;
+    }
+    table_cache_->SetPersistentCacheIdentity(identity);
+  }
+
   s = versions_->Recover(save_manifest);//DHQ: 这里面会根据manifest，恢复VersionSet。后面RecoverLogFile还好产生VersionEdit
   if (!s.ok()) {
     return s;
@@ -501,10 +611,24 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
   Log(options_.info_log, "Level-0 table #%llu: started",
       (unsigned long long) meta.number);
 
+  // Pick the level first, so that BuildTable() opens the new table the
+  // way tables of that level are opened (see Options::mmap_max_level).
+  int level = 0;
+  iter->SeekToFirst();
+  if (base != nullptr && iter->Valid()) {
+    InternalKey smallest, largest;
+    smallest.DecodeFrom(iter->key());
+    iter->SeekToLast();
+    largest.DecodeFrom(iter->key());
+    level = base->PickLevelForMemTableOutput(smallest.user_key(),
+                                             largest.user_key()); //DHQ: pick level, may sink down. 
+  }
+
   Status s;
   {
     mutex_.Unlock();//DHQ: 先unlock, it is time consuming
-    s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta); //DHQ: write file inside
+    s = BuildTable(dbname_, env_, options_, table_cache_, iter, level,
+                   &meta); //DHQ: write file inside
     mutex_.Lock();//Lock again
   }
 
@@ -518,13 +642,7 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
 
   // Note that if file_size is zero, the file has been deleted and
   // should not be added to the manifest.
-  int level = 0;
   if (s.ok() && meta.file_size > 0) {
-    const Slice min_user_key = meta.smallest.user_key();
-    const Slice max_user_key = meta.largest.user_key();
-    if (base != nullptr) {
-      level = base->PickLevelForMemTableOutput(min_user_key, max_user_key); //DHQ: pick level, may sink down. 
-    }
     edit->AddFile(level, meta.number, meta.file_size,
                   meta.smallest, meta.largest);
   }
@@ -809,7 +927,12 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
 
   // Make the output file
   std::string fname = TableFileName(dbname_, file_number);
-  Status s = env_->NewWritableFile(fname, &compact->outfile);
+  Status s;
+  if (options_.use_direct_io_for_flush_and_compaction) {
+    s = env_->NewDirectWritableFile(fname, &compact->outfile);
+  } else {
+    s = env_->NewWritableFile(fname, &compact->outfile);
+  }
   if (s.ok()) {
     compact->builder = new TableBuilder(options_, compact->outfile);
   }
@@ -851,9 +974,9 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
 
   if (s.ok() && current_entries > 0) {
     // Verify that the table is usable
-    Iterator* iter = table_cache_->NewIterator(ReadOptions(),
-                                               output_number,
-                                               current_bytes);
+    Iterator* iter = table_cache_->NewIterator(
+        ReadOptions(), output_number, current_bytes, nullptr,
+        compact->compaction->level() + 1);
     s = iter->status();
     delete iter;
     if (s.ok()) {
@@ -944,7 +1067,8 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
 
     // Handle key/value, add to state, etc.
     bool drop = false;
-    if (!ParseInternalKey(key, &ikey)) {//DHQ: 解析错误
+    const bool parsed = ParseInternalKey(key, &ikey);
+    if (!parsed) {//DHQ: 解析错误
       // Do not hide error keys
       current_user_key.clear();
       has_current_user_key = false;
@@ -1000,7 +1124,12 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         compact->current_output()->smallest.DecodeFrom(key);
       }
       compact->current_output()->largest.DecodeFrom(key);
-      compact->builder->Add(key, input->value());
+      if (parsed) {
+        compact->builder->Add(key, input->value(), ikey.sequence,
+                              ikey.type == kTypeDeletion);
+      } else {
+        compact->builder->Add(key, input->value());
+      }
       //DHQ: 判断大小，超出了则要换文件
       // Close output file if it is big enough
       if (compact->builder->FileSize() >=
@@ -1055,24 +1184,204 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
 
 namespace {
 
-struct IterState {
-  port::Mutex* const mu;
-  Version* const version GUARDED_BY(mu);
-  MemTable* const mem GUARDED_BY(mu);
-  MemTable* const imm GUARDED_BY(mu);
+// Internal iterator of a DBIter.  It merges one child iterator per
+// memtable, per level-0 file and per non-empty level > 0 of the version
+// it reads.  Renew() moves it to other memtables and another version and
+// only rebuilds the children whose memtable or files changed, so that
+// tailing iterators and Iterator::Refresh() can follow the DB cheaply.
+class RenewableIterator : public Iterator {
+ public:
+  RenewableIterator(port::Mutex* mu, const InternalKeyComparator* icmp,
+                    const ReadOptions& options);
+  ~RenewableIterator() override;
+
+  // Read "mem", "imm" (may be nullptr) and "version" from now on.  The
+  // iterator is left unpositioned unless nothing changed.
+  // REQUIRES: *mu held
+  void Renew(MemTable* mem, MemTable* imm, Version* version);
+
+  bool Valid() const override { return merger_->Valid(); }
+  void Seek(const Slice& target) override { merger_->Seek(target); }
+  void SeekToFirst() override { merger_->SeekToFirst(); }
+  void SeekToLast() override { merger_->SeekToLast(); }
+  void Next() override { merger_->Next(); }
+  void Prev() override { merger_->Prev(); }
+  Slice key() const override { return merger_->key(); }
+  Slice value() const override { return merger_->value(); }
+  Status status() const override { return merger_->status(); }
+
+ private:
+  // What a child iterator reads
+  struct Child {
+    Iterator* iter;
+    MemTable* mem;     // Memtable (referenced by the child), or nullptr
+    uint64_t number;   // Level-0 file, or 0
+    int level;         // Level > 0, or 0
+    Version* version;  // Version (referenced) whose "level" iter reads
+    uint64_t tag;      // version->level_tag(level)
+
+    bool SameSource(const Child& other) const {
+      return mem == other.mem && number == other.number &&
+             level == other.level && tag == other.tag;
+    }
+  };
 
-  IterState(port::Mutex* mutex, MemTable* mem, MemTable* imm, Version* version)
-      : mu(mutex), version(version), mem(mem), imm(imm) { }
+  // Drop the references held by the children in "list".
+  // REQUIRES: *mu_ held
+  static void UnrefChildren(const std::list<Child>& list);
+
+  // Move the child of *old that reads the same as "c" to children_.
+  // Returns false if there is none.
+  bool Reuse(const Child& c, std::list<Child>* old);
+
+  port::Mutex* const mu_;
+  const InternalKeyComparator* const icmp_;
+  ReadOptions options_;  // With the iterate bounds as internal keys
+  InternalKey lower_bound_;
+  InternalKey upper_bound_;
+  Slice lower_bound_key_;
+  Slice upper_bound_key_;
+
+  std::list<Child> children_;
+  std::list<Child> retired_;  // Replaced children kept for pin_data
+  Iterator* merger_;  // Merges the iterators of children_
+  MemTable* mem_;
+  MemTable* imm_;
+  Version* version_;  // Referenced
 };
 
-static void CleanupIteratorState(void* arg1, void* arg2) {
-  IterState* state = reinterpret_cast<IterState*>(arg1);
-  state->mu->Lock();
-  state->mem->Unref();
-  if (state->imm != nullptr) state->imm->Unref();
-  state->version->Unref();
-  state->mu->Unlock();
-  delete state;
+RenewableIterator::RenewableIterator(port::Mutex* mu,
+                                     const InternalKeyComparator* icmp,
+                                     const ReadOptions& options)
+    : mu_(mu),
+      icmp_(icmp),
+      options_(options),
+      merger_(NewEmptyIterator()),
+      mem_(nullptr),
+      imm_(nullptr),
+      version_(nullptr) {
+  // Files and blocks are compared with the bounds as internal keys.  The
+  // smallest internal key of a user key stands for that user key.
+  if (options.iterate_lower_bound != nullptr) {
+    lower_bound_ = InternalKey(*options.iterate_lower_bound,
+                               kMaxSequenceNumber, kValueTypeForSeek);
+    lower_bound_key_ = lower_bound_.Encode();
+    options_.iterate_lower_bound = &lower_bound_key_;
+  }
+  if (options.iterate_upper_bound != nullptr) {
+    upper_bound_ = InternalKey(*options.iterate_upper_bound,
+                               kMaxSequenceNumber, kValueTypeForSeek);
+    upper_bound_key_ = upper_bound_.Encode();
+    options_.iterate_upper_bound = &upper_bound_key_;
+  }
+}
+
+RenewableIterator::~RenewableIterator() {
+  delete merger_;
+  children_.splice(children_.end(), retired_);
+  for (std::list<Child>::iterator c = children_.begin();
+       c != children_.end(); ++c) {
+    delete c->iter;
+  }
+  MutexLock l(mu_);
+  UnrefChildren(children_);
+  if (version_ != nullptr) version_->Unref();
+}
+
+void RenewableIterator::UnrefChildren(const std::list<Child>& list) {
+  for (std::list<Child>::const_iterator c = list.begin();
+       c != list.end(); ++c) {
+    if (c->mem != nullptr) c->mem->Unref();
+    if (c->version != nullptr) c->version->Unref();
+  }
+}
+
+bool RenewableIterator::Reuse(const Child& c, std::list<Child>* old) {
+  for (std::list<Child>::iterator o = old->begin(); o != old->end(); ++o) {
+    if (o->SameSource(c)) {
+      children_.splice(children_.end(), *old, o);
+      return true;
+    }
+  }
+  return false;
+}
+
+void RenewableIterator::Renew(MemTable* mem, MemTable* imm,
+                              Version* version) {
+  mu_->AssertHeld();
+  if (mem == mem_ && imm == imm_ && version == version_) {
+    return;
+  }
+  delete merger_;
+  std::list<Child> old;
+  old.swap(children_);
+
+  MemTable* mems[2] = { mem, imm };
+  for (int i = 0; i < 2; i++) {
+    Child c;
+    c.mem = mems[i];
+    c.number = 0;
+    c.level = 0;
+    c.version = nullptr;
+    c.tag = 0;
+    if (c.mem != nullptr && !Reuse(c, &old)) {
+      c.iter = c.mem->NewIterator();
+      c.mem->Ref();
+      children_.push_back(c);
+    }
+  }
+  const std::vector<FileMetaData*>& level0 = version->files(0);
+  for (size_t i = 0; i < level0.size(); i++) {
+    Child c;
+    c.mem = nullptr;
+    c.number = level0[i]->number;
+    c.level = 0;
+    c.version = nullptr;
+    c.tag = 0;
+    if (!Reuse(c, &old)) {
+      c.iter = version->NewLevel0Iterator(options_, level0[i]);
+      if (c.iter != nullptr) {
+        children_.push_back(c);
+      }
+    }
+  }
+  for (int level = 1; level < config::kNumLevels; level++) {
+    Child c;
+    c.mem = nullptr;
+    c.number = 0;
+    c.level = level;
+    c.version = version;
+    c.tag = version->level_tag(level);
+    if (!version->files(level).empty() && !Reuse(c, &old)) {
+      c.iter = version->NewConcatenatingIterator(options_, level);
+      version->Ref();
+      children_.push_back(c);
+    }
+  }
+
+  // Drop the children that were not carried over, unless their values
+  // must stay alive.
+  if (options_.pin_data) {
+    retired_.splice(retired_.end(), old);
+  } else {
+    for (std::list<Child>::iterator c = old.begin(); c != old.end(); ++c) {
+      delete c->iter;
+    }
+    UnrefChildren(old);
+  }
+
+  version->Ref();
+  if (version_ != nullptr) version_->Unref();
+  mem_ = mem;
+  imm_ = imm;
+  version_ = version;
+
+  std::vector<Iterator*> list;
+  for (std::list<Child>::iterator c = children_.begin();
+       c != children_.end(); ++c) {
+    list.push_back(c->iter);
+  }
+  merger_ = NewBorrowingMergingIterator(icmp_, &list[0], list.size());
 }
 
 }  // anonymous namespace
@@ -1082,28 +1391,22 @@ Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
                                       uint32_t* seed) {
   mutex_.Lock(); //DHQ: 先获得 lock，这样 sequence 与 current 也是一致的
   *latest_snapshot = versions_->LastSequence();//DHQ: 先获取 snapshot number
-
-  // Collect together all needed child iterators
-  std::vector<Iterator*> list;
-  list.push_back(mem_->NewIterator()); //DHQ: memtable 的 iter，先放到 list
-  mem_->Ref(); //DHQ: mem_, imm_, current，都做了Ref，上面的cleanup，要 Unref
-  if (imm_ != nullptr) {
-    list.push_back(imm_->NewIterator()); //DHQ: imm 的 iter, 放到 list
-    imm_->Ref();
-  }
-  versions_->current()->AddIterators(options, &list); //DHQ: VersionSet的iters (应该每个level都有)，加入list
-  Iterator* internal_iter =
-      NewMergingIterator(&internal_comparator_, &list[0], list.size()); //DHQ: 创建一个 Merging Iter
-  versions_->current()->Ref();
-
-  IterState* cleanup = new IterState(&mutex_, mem_, imm_, versions_->current()); //DHQ: 创建了一个用于 cleanup的 IterState
-  internal_iter->RegisterCleanup(CleanupIteratorState, cleanup, nullptr);
-
+  RenewableIterator* internal_iter =
+      new RenewableIterator(&mutex_, &internal_comparator_, options);
+  internal_iter->Renew(mem_, imm_, versions_->current());
   *seed = ++seed_;
   mutex_.Unlock();
   return internal_iter; //DHQ: 返回一个 iter list的 iter
 }
 
+void DBImpl::RenewInternalIterator(Iterator* iter,
+                                   SequenceNumber* latest_snapshot) {
+  MutexLock l(&mutex_);
+  *latest_snapshot = versions_->LastSequence();
+  reinterpret_cast<RenewableIterator*>(iter)->Renew(mem_, imm_,
+                                                    versions_->current());
+}
+
 Iterator* DBImpl::TEST_NewInternalIterator() {
   SequenceNumber ignored;
   uint32_t ignored_seed;
@@ -1118,6 +1421,26 @@ int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes() {
 Status DBImpl::Get(const ReadOptions& options,
                    const Slice& key,
                    std::string* value) {
+  return GetImpl(options, key, value, nullptr);
+}
+
+Status DBImpl::Get(const ReadOptions& options,
+                   const Slice& key,
+                   PinnableSlice* value) {
+  value->Reset();
+  return GetImpl(options, key, nullptr, value);
+}
+
+void DBImpl::UnrefMemTable(void* db, void* mem) {
+  DBImpl* impl = reinterpret_cast<DBImpl*>(db);
+  MutexLock l(&impl->mutex_);
+  reinterpret_cast<MemTable*>(mem)->Unref();
+}
+
+Status DBImpl::GetImpl(const ReadOptions& options,
+                       const Slice& key,
+                       std::string* value,
+                       PinnableSlice* pinned) {
   Status s;
   MutexLock l(&mutex_); //DHQ: 先lock
   SequenceNumber snapshot;
@@ -1137,27 +1460,46 @@ Status DBImpl::Get(const ReadOptions& options,
 
   bool have_stat_update = false;
   Version::GetStats stats;
+  MemTable* found_in = nullptr;  // Memtable holding the value, if any
 
   // Unlock while reading from files and memtables
   {
     mutex_.Unlock(); //DHQ: 已获取 ref，可以unlock
     // First look in the memtable, then in the immutable memtable (if any).
     LookupKey lkey(key, snapshot);
-    if (mem->Get(lkey, value, &s)) {
-      // Done
-    } else if (imm != nullptr && imm->Get(lkey, value, &s)) {
-      // Done
+    Slice v;
+    if (mem->Get(lkey, &v, &s)) {
+      found_in = mem;
+    } else if (imm != nullptr && imm->Get(lkey, &v, &s)) {
+      found_in = imm;
     } else {
-      s = current->Get(options, lkey, value, &stats);
+      PinnableSlice tmp;
+      s = current->Get(options, lkey, pinned ? pinned : &tmp, &stats);
+      if (s.ok() && value != nullptr) {
+        value->assign(tmp.data(), tmp.size());
+      }
       have_stat_update = true;
     }
+    if (found_in != nullptr && s.ok()) {
+      if (value != nullptr) {
+        value->assign(v.data(), v.size());
+      } else {
+        // Our reference to the memtable now belongs to *pinned
+        pinned->PinSlice(v, &DBImpl::UnrefMemTable, this, found_in);
+        if (found_in == mem) {
+          mem = nullptr;
+        } else {
+          imm = nullptr;
+        }
+      }
+    }
     mutex_.Lock(); //DHQ: 我认为这里恢复Lock，一是为了利用MutexLock，并不是为了Unref之类的。MaybeScheduleCompaction可能需要lock
   }
 
   if (have_stat_update && current->UpdateStats(stats)) {
     MaybeScheduleCompaction();
   }
-  mem->Unref();
+  if (mem != nullptr) mem->Unref();
   if (imm != nullptr) imm->Unref();
   current->Unref();//DHQ: unref 
   return s;
@@ -1169,10 +1511,14 @@ Iterator* DBImpl::NewIterator(const ReadOptions& options) {
   Iterator* iter = NewInternalIterator(options, &latest_snapshot, &seed); //DHQ: 内部获取了各种 Ref
   return NewDBIterator(
       this, user_comparator(), iter,
-      (options.snapshot != nullptr
+      (options.snapshot != nullptr && !options.tailing
        ? static_cast<const SnapshotImpl*>(options.snapshot)->sequence_number()
        : latest_snapshot),
-      seed);
+      seed,
+      options.prefix_same_as_start ? internal_prefix_extractor_.user_transform()
+                                   : nullptr,
+      options.iterate_lower_bound, options.iterate_upper_bound,
+      options.pin_data, options.tailing);
 }
 
 void DBImpl::RecordReadSample(Slice key) {
@@ -1482,6 +1828,246 @@ void DBImpl::GetApproximateSizes(//DHQ: 获取多个 Range的大小
   }
 }
 
+Status DBImpl::GetPropertiesOfAllTables(TablePropertiesCollection* props) {
+  props->clear();
+  Version* v;
+  {
+    MutexLock l(&mutex_);
+    versions_->current()->Ref();
+    v = versions_->current();
+  }
+
+  Status s;
+  for (int level = 0; s.ok() && level < config::kNumLevels; level++) {
+    const std::vector<FileMetaData*>& files = v->files(level);
+    for (size_t i = 0; s.ok() && i < files.size(); i++) {
+      TableProperties p;
+      s = table_cache_->GetProperties(files[i]->number, files[i]->file_size,
+                                      level, &p);
+      if (s.ok()) {
+        (*props)[TableFileName(dbname_, files[i]->number)] = p;
+      } else if (s.IsNotFound()) {
+        s = Status::OK();  // Written without properties
+      }
+    }
+  }
+
+  {
+    MutexLock l(&mutex_);
+    v->Unref();
+  }
+  return s;
+}
+
+// Calls (*function)(arg, shard, ...) for the entries of "db" with keys in
+// [*lower,*upper), where null bounds leave the range open.
+static Status ScanShard(DB* db, const ReadOptions& options,
+                        const Slice* lower, const Slice* upper, int shard,
+                        DB::ScanFunction function, void* arg) {
+  ReadOptions shard_options = options;
+  shard_options.iterate_lower_bound = lower;
+  shard_options.iterate_upper_bound = upper;
+  shard_options.prefix_same_as_start = false;
+  shard_options.tailing = false;
+  Iterator* iter = db->NewIterator(shard_options);
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    if (!(*function)(arg, shard, iter->key(), iter->value())) {
+      break;
+    }
+  }
+  Status s = iter->status();
+  delete iter;
+  return s;
+}
+
+namespace {
+
+// Most threads that one call of DBImpl::ParallelScan() scans shards on
+static const int kMaxScanThreads = 64;
+
+// Order user keys held in strings by a user comparator
+struct UserKeyLess {
+  const Comparator* ucmp;
+  explicit UserKeyLess(const Comparator* c) : ucmp(c) { }
+  bool operator()(const std::string& a, const std::string& b) const {
+    return ucmp->Compare(a, b) < 0;
+  }
+};
+
+struct UserKeyEqual {
+  const Comparator* ucmp;
+  explicit UserKeyEqual(const Comparator* c) : ucmp(c) { }
+  bool operator()(const std::string& a, const std::string& b) const {
+    return ucmp->Compare(a, b) == 0;
+  }
+};
+
+// State shared by the threads of DBImpl::ParallelScan()
+struct ScanState {
+  DB* db;
+  ReadOptions options;
+  // Shard i holds the keys in [*lower[i],*lower[i+1]), where
+  // lower[num_shards] is the end of the range.
+  std::vector<const Slice*> lower;
+  int num_shards;
+  DB::ScanFunction function;
+  void* arg;
+
+  port::Mutex mu;
+  port::CondVar cv;
+  int next GUARDED_BY(mu);     // Next shard to scan
+  int running GUARDED_BY(mu);  // Threads that have not finished
+  Status status GUARDED_BY(mu);  // First error
+
+  ScanState() : cv(&mu), next(0), running(0) { }
+};
+
+}  // namespace
+
+static void ScanWork(void* arg) {
+  ScanState* state = reinterpret_cast<ScanState*>(arg);
+  MutexLock l(&state->mu);
+  while (state->next < state->num_shards) {
+    const int shard = state->next++;
+    state->mu.Unlock();
+    Status s = ScanShard(state->db, state->options, state->lower[shard],
+                         state->lower[shard + 1], shard, state->function,
+                         state->arg);
+    state->mu.Lock();
+    if (state->status.ok()) {
+      state->status = s;
+    }
+  }
+  state->running--;
+  state->cv.SignalAll();
+}
+
+void DBImpl::SplitScanRange(const Slice* begin, const Slice* end,
+                            int n_shards, std::vector<std::string>* cuts) {
+  const Comparator* ucmp = user_comparator();
+  Version* v;
+  std::vector<std::string> candidates;
+  uint64_t total_size = 0;
+  {
+    MutexLock l(&mutex_);
+    v = versions_->current();
+    v->Ref();
+  }
+  for (int level = 0; level < config::kNumLevels; level++) {
+    std::vector<FileMetaData*> files;
+    v->GetOverlappingInputs(level, nullptr, nullptr, &files);
+    for (size_t i = 0; i < files.size(); i++) {
+      total_size += files[i]->file_size;
+      candidates.push_back(files[i]->smallest.user_key().ToString());
+      candidates.push_back(files[i]->largest.user_key().ToString());
+    }
+  }
+
+  // Only keys strictly inside the range can split it.
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < candidates.size(); i++) {
+    const Slice key = candidates[i];
+    if ((begin == nullptr || ucmp->Compare(key, *begin) > 0) &&
+        (end == nullptr || ucmp->Compare(key, *end) < 0)) {
+      keys.push_back(candidates[i]);
+    }
+  }
+  std::sort(keys.begin(), keys.end(), UserKeyLess(ucmp));
+  keys.erase(std::unique(keys.begin(), keys.end(), UserKeyEqual(ucmp)),
+             keys.end());
+
+  // Cut at the keys that come closest to splitting the data before the
+  // end of the range into equal parts.
+  const uint64_t start_offset =
+      (begin == nullptr) ? 0 : ApproximateUserKeyOffset(v, *begin);
+  const uint64_t end_offset =
+      (end == nullptr) ? total_size : ApproximateUserKeyOffset(v, *end);
+  size_t lo = 0;
+  for (int i = 1; i < n_shards && end_offset > start_offset; i++) {
+    const uint64_t target = start_offset + static_cast<uint64_t>(
+        (end_offset - start_offset) * (static_cast<double>(i) / n_shards));
+    // Find the first key at or past the target
+    size_t left = lo;
+    size_t right = keys.size();
+    while (left < right) {
+      const size_t mid = left + (right - left) / 2;
+      if (ApproximateUserKeyOffset(v, keys[mid]) < target) {
+        left = mid + 1;
+      } else {
+        right = mid;
+      }
+    }
+    if (left == keys.size()) {
+      break;
+    }
+    cuts->push_back(keys[left]);
+    lo = left + 1;
+  }
+
+  {
+    MutexLock l(&mutex_);
+    v->Unref();
+  }
+}
+
+uint64_t DBImpl::ApproximateUserKeyOffset(Version* v, const Slice& user_key) {
+  InternalKey k(user_key, kMaxSequenceNumber, kValueTypeForSeek);
+  return versions_->ApproximateOffsetOf(v, k);
+}
+
+Status DBImpl::ParallelScan(const ReadOptions& options,
+                            const Slice* begin, const Slice* end,
+                            int n_shards, ScanFunction function, void* arg) {
+  if (n_shards < 1) {
+    return Status::InvalidArgument("ParallelScan needs at least one shard");
+  }
+  ScanState state;
+  state.db = this;
+  state.options = options;
+  state.function = function;
+  state.arg = arg;
+  const Snapshot* snapshot = nullptr;
+  if (options.snapshot == nullptr) {
+    // All shards must see the same state
+    snapshot = GetSnapshot();
+    state.options.snapshot = snapshot;
+  }
+
+  std::vector<std::string> cuts;
+  SplitScanRange(begin, end, n_shards, &cuts);
+  std::vector<Slice> cut_slices(cuts.begin(), cuts.end());
+  state.lower.push_back(begin);
+  for (size_t i = 0; i < cut_slices.size(); i++) {
+    state.lower.push_back(&cut_slices[i]);
+  }
+  state.lower.push_back(end);
+  state.num_shards = static_cast<int>(cut_slices.size()) + 1;
+
+  // This thread scans shards along with the threads it starts.
+  const int threads = std::min(state.num_shards, kMaxScanThreads);
+  Status s;
+  {
+    MutexLock l(&state.mu);
+    state.running = threads;
+    for (int i = 1; i < threads; i++) {
+      env_->StartThread(&ScanWork, &state);
+    }
+  }
+  ScanWork(&state);
+  {
+    MutexLock l(&state.mu);
+    while (state.running > 0) {
+      state.cv.Wait();
+    }
+    s = state.status;
+  }
+
+  if (snapshot != nullptr) {
+    ReleaseSnapshot(snapshot);
+  }
+  return s;
+}
+
 // Default implementations of convenience methods that subclasses of DB
 // can call if they wish
 Status DB::Put(const WriteOptions& opt, const Slice& key, const Slice& value) {
@@ -1496,6 +2082,31 @@ Status DB::Delete(const WriteOptions& opt, const Slice& key) {
   return Write(opt, &batch);
 }
 
+Status DB::Get(const ReadOptions& options, const Slice& key,
+               PinnableSlice* value) {
+  std::string tmp;
+  Status s = Get(options, key, &tmp);
+  if (s.ok()) {
+    value->PinSelf(tmp);
+  } else {
+    value->Reset();
+  }
+  return s;
+}
+
+Status DB::ParallelScan(const ReadOptions& options,
+                        const Slice* begin, const Slice* end,
+                        int n_shards, ScanFunction function, void* arg) {
+  if (n_shards < 1) {
+    return Status::InvalidArgument("ParallelScan needs at least one shard");
+  }
+  return ScanShard(this, options, begin, end, 0, function, arg);
+}
+
+Status DB::GetPropertiesOfAllTables(TablePropertiesCollection* props) {
+  return Status::NotSupported("GetPropertiesOfAllTables");
+}
+
 DB::~DB() { }
 //DHQ: Open，返回 DBImpl 
 Status DB::Open(const Options& options, const std::string& dbname,
@@ -1530,6 +2141,11 @@ Status DB::Open(const Options& options, const std::string& dbname,
   }
   if (s.ok()) {
     impl->DeleteObsoleteFiles();
+    if (options.preload_tables_on_open) {
+      s = impl->PreloadTables();
+    }
+  }
+  if (s.ok()) {
     impl->MaybeScheduleCompaction();
   }
   impl->mutex_.Unlock();
@@ -7,6 +7,8 @@
 
 #include <deque>
 #include <set>
+#include <string>
+#include <vector>
 #include "db/dbformat.h"
 #include "db/log_writer.h"
 #include "db/snapshot.h"
@@ -35,11 +37,18 @@ class DBImpl : public DB {
   virtual Status Get(const ReadOptions& options,
                      const Slice& key,
                      std::string* value);
+  virtual Status Get(const ReadOptions& options,
+                     const Slice& key,
+                     PinnableSlice* value);
   virtual Iterator* NewIterator(const ReadOptions&);
   virtual const Snapshot* GetSnapshot();
   virtual void ReleaseSnapshot(const Snapshot* snapshot);
   virtual bool GetProperty(const Slice& property, std::string* value);
   virtual void GetApproximateSizes(const Range* range, int n, uint64_t* sizes);
+  virtual Status GetPropertiesOfAllTables(TablePropertiesCollection* props);
+  virtual Status ParallelScan(const ReadOptions& options,
+                              const Slice* begin, const Slice* end,
+                              int n_shards, ScanFunction function, void* arg);
   virtual void CompactRange(const Slice* begin, const Slice* end);
 
   // Extra methods (for testing) that are not in the public DB interface
@@ -64,6 +73,11 @@ class DBImpl : public DB {
   // bytes.
   void RecordReadSample(Slice key);
 
+  // Point "iter", the internal iterator of a DBIter, at the current
+  // memtables and version if it no longer reads them, and store the
+  // latest sequence number in *latest_snapshot.
+  void RenewInternalIterator(Iterator* iter, SequenceNumber* latest_snapshot);
+
  private:
   friend class DB;
   struct CompactionState;
@@ -73,6 +87,22 @@ class DBImpl : public DB {
                                 SequenceNumber* latest_snapshot,
                                 uint32_t* seed);
 
+  // Looks up "key".  If it is found, stores a copy of its value in *value
+  // if "value" is non-null, and pins it in *pinned otherwise.
+  Status GetImpl(const ReadOptions& options, const Slice& key,
+                 std::string* value, PinnableSlice* pinned);
+
+  // Releases a value pinned in MemTable "mem" of DBImpl "db".
+  static void UnrefMemTable(void* db, void* mem);
+
+  // Store in *cuts the user keys, in increasing order, at which
+  // ParallelScan() splits [*begin,*end) into at most "n_shards" shards.
+  void SplitScanRange(const Slice* begin, const Slice* end, int n_shards,
+                      std::vector<std::string>* cuts);
+
+  // Approximate offset of "user_key" in the files of "v"
+  uint64_t ApproximateUserKeyOffset(Version* v, const Slice& user_key);
+
   Status NewDB();
 
   // Recover the descriptor from persistent storage.  May do a significant
@@ -86,6 +116,11 @@ class DBImpl : public DB {
   // Delete any unneeded files and stale in-memory entries.
   void DeleteObsoleteFiles() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Open the table files of the current version into table_cache_ on
+  // options_.max_file_opening_threads threads (see
+  // Options::preload_tables_on_open).  Releases mutex_ while it works.
+  Status PreloadTables() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   // Compact the in-memory write buffer to disk.  Switches to a new
   // log-file/memtable and writes a new descriptor iff successful.
   // Errors are recorded in bg_error_.
@@ -123,6 +158,7 @@ class DBImpl : public DB {
   Env* const env_;
   const InternalKeyComparator internal_comparator_;
   const InternalFilterPolicy internal_filter_policy_;
+  const InternalKeySliceTransform internal_prefix_extractor_;
   const Options options_;  // options_.comparator == &internal_comparator_
   const bool owns_info_log_;
   const bool owns_cache_;
@@ -205,6 +241,7 @@ class DBImpl : public DB {
 Options SanitizeOptions(const std::string& db,
                         const InternalKeyComparator* icmp,
                         const InternalFilterPolicy* ipolicy,
+                        const InternalKeySliceTransform* iprefix,
                         const Options& src);
 
 }  // namespace leveldb
@@ -49,13 +49,21 @@ class DBIter: public Iterator {//DHQ: 上面提到了 “multiple entries for th
   };
   //DHQ: DBIter，封装了内部的iter_，是个 MergingIterator，MergingIterator不了解seqence，userkey，只有DBIter关注这个
   DBIter(DBImpl* db, const Comparator* cmp, Iterator* iter, SequenceNumber s,
-         uint32_t seed)
+         uint32_t seed, const SliceTransform* prefix_extractor,
+         const Slice* lower_bound, const Slice* upper_bound, bool pin_data,
+         bool tailing)
       : db_(db),
         user_comparator_(cmp),
         iter_(iter),
         sequence_(s),
+        prefix_extractor_(prefix_extractor),
+        lower_bound_(lower_bound),
+        upper_bound_(upper_bound),
+        pin_data_(pin_data),
+        tailing_(tailing),
         direction_(kForward),
         valid_(false),
+        prefix_bounded_(false),
         rnd_(seed),
         bytes_counter_(RandomPeriod()) {
   }
@@ -69,7 +77,10 @@ class DBIter: public Iterator {//DHQ: 上面提到了 “multiple entries for th
   }
   virtual Slice value() const {
     assert(valid_);//saved_value，与上面saved_key_ 使用类似。仅仅在 kReverse 才有效
-    return (direction_ == kForward) ? iter_->value() : saved_value_;
+    if (direction_ == kForward) {
+      return iter_->value();
+    }
+    return pin_data_ ? pinned_value_ : Slice(saved_value_);
   }
   virtual Status status() const {
     if (status_.ok()) {
@@ -84,17 +95,38 @@ class DBIter: public Iterator {//DHQ: 上面提到了 “multiple entries for th
   virtual void Seek(const Slice& target);
   virtual void SeekToFirst();
   virtual void SeekToLast();
+  virtual Status Refresh();
 
  private:
   void FindNextUserEntry(bool skipping, std::string* skip);
   void FindPrevUserEntry();
   bool ParseKey(ParsedInternalKey* key);
 
+  // True iff "user_key" has the prefix of the last Seek() target
+  bool HasSeekPrefix(const Slice& user_key) const {
+    return prefix_extractor_->InDomain(user_key) &&
+           prefix_extractor_->Transform(user_key) == Slice(prefix_);
+  }
+
+  // True iff forward iteration must stop before "user_key"
+  bool PastForwardLimit(const Slice& user_key) const {
+    return (upper_bound_ != nullptr &&
+            user_comparator_->Compare(user_key, *upper_bound_) >= 0) ||
+           (prefix_bounded_ && !HasSeekPrefix(user_key));
+  }
+
+  // True iff reverse iteration must stop before "user_key"
+  bool PastReverseLimit(const Slice& user_key) const {
+    return lower_bound_ != nullptr &&
+           user_comparator_->Compare(user_key, *lower_bound_) < 0;
+  }
+
   inline void SaveKey(const Slice& k, std::string* dst) {
     dst->assign(k.data(), k.size());
   }
 
   inline void ClearSavedValue() {
+    pinned_value_.clear();
     if (saved_value_.capacity() > 1048576) {
       std::string empty;
       swap(empty, saved_value_);//DHQ: free string's space.
@@ -111,13 +143,21 @@ class DBIter: public Iterator {//DHQ: 上面提到了 “multiple entries for th
   DBImpl* db_;
   const Comparator* const user_comparator_;
   Iterator* const iter_; //DHQ: 这个是个 internal iter
-  SequenceNumber const sequence_;
+  SequenceNumber sequence_;  // Advanced by Refresh() and tailing seeks
+  const SliceTransform* const prefix_extractor_;  // May be nullptr
+  const Slice* const lower_bound_;  // Inclusive; may be nullptr
+  const Slice* const upper_bound_;  // Exclusive; may be nullptr
+  const bool pin_data_;  // iter_ keeps the values it returned alive
+  const bool tailing_;
 
   Status status_;
   std::string saved_key_;     // == current key when direction_==kReverse  仅在 kReverse 时有效
   std::string saved_value_;   // == current raw value when direction_==kReverse
+  Slice pinned_value_;        // Used instead of saved_value_ if pin_data_
   Direction direction_;
   bool valid_;
+  bool prefix_bounded_;       // Stop at keys without prefix_?
+  std::string prefix_;        // Prefix of the last Seek() target
 
   Random rnd_;
   ssize_t bytes_counter_;
@@ -176,7 +216,13 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
   assert(direction_ == kForward);
   do {//如果有k1, k2, k3，当前时k1, k2 被del了(<sequence_的最大的，是Del)，那么应返回k3。k2的多个sequnce，都需要被skip掉。
     ParsedInternalKey ikey;
-    if (ParseKey(&ikey) && ikey.sequence <= sequence_) {//DHQ:如果Del的seqno > sequence_，那么不应该造成skip。快照含义如此
+    const bool parsed = ParseKey(&ikey);
+    if (parsed && PastForwardLimit(ikey.user_key)) {
+      // Tables that only hold keys past the limit may have been skipped,
+      // so later keys may be missing.
+      break;
+    }
+    if (parsed && ikey.sequence <= sequence_) {//DHQ:如果Del的seqno > sequence_，那么不应该造成skip。快照含义如此
       switch (ikey.type) {
         case kTypeDeletion://DHQ: 遇到一个 delete，在kForward模式下，seqno 大的先遇到
           // Arrange to skip all upcoming entries for this key since
@@ -250,7 +296,11 @@ void DBIter::FindPrevUserEntry() {
   if (iter_->Valid()) {//因为要保证发生了user key变化(不是之前那个)，所以比较复杂
     do {
       ParsedInternalKey ikey;//下面的Compare，如果一个user key连续出现两次，那么不会break，因为不满足 Compare(ikey.user_key, saved_key_) < 0
-      if (ParseKey(&ikey) && ikey.sequence <= sequence_) {//只考虑 <= sequence_的, 大的过滤掉
+      const bool parsed = ParseKey(&ikey);
+      if (parsed && PastReverseLimit(ikey.user_key)) {
+        break;  // Entries before the lower bound are not returned
+      }
+      if (parsed && ikey.sequence <= sequence_) {//只考虑 <= sequence_的, 大的过滤掉
         if ((value_type != kTypeDeletion) && //上一个key，不是 kTypeDeletion(即saved_key_有值)，并且本次的user_key比上次saved_key_小(即换了key)
             user_comparator_->Compare(ikey.user_key, saved_key_) < 0) {//DHQ: 找到了一个小于save_key的且不是delete的，成功
           // We encountered a non-deleted value in entries for previous keys,
@@ -260,15 +310,18 @@ void DBIter::FindPrevUserEntry() {
         if (value_type == kTypeDeletion) {
           saved_key_.clear(); //clear过后，下次循环到上面语句，user_comparator_->Compare 总失败？
           ClearSavedValue();  //TODO: 如果进入函数时，当前key是C，并且没有seq更大的了，(B, 103, v3), (B, 102, V2), (B, 100, Del)，先找到 (B, 100, Del)
-        if ((value_type != kTypeDeletion) && //上一个key，不是 kTypeDeletion(即saved_key_有值)，并且本次的user_key比上次saved_key_小
         } else { //这里判断的是ikey.type，value_type 已经变了
           Slice raw_value = iter_->value();
-          if (saved_value_.capacity() > raw_value.size() + 1048576) {
-            std::string empty;
-            swap(empty, saved_value_); //DHQ: 跟临时变量交换，让临时变量释放空间
-          }//保留这个可以作为saved_key_，然后接着往前找，直到：user_key变了，说明当前user_key的最大seqno已经被找到，然后key()返回的是saved_key_
           SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
-          saved_value_.assign(raw_value.data(), raw_value.size());
+          if (pin_data_) {  // iter_ keeps the block alive (ReadOptions::pin_data)
+            pinned_value_ = raw_value;
+          } else {
+            if (saved_value_.capacity() > raw_value.size() + 1048576) {
+              std::string empty;
+              swap(empty, saved_value_); //DHQ: 跟临时变量交换，让临时变量释放空间
+            }//保留这个可以作为saved_key_，然后接着往前找，直到：user_key变了，说明当前user_key的最大seqno已经被找到，然后key()返回的是saved_key_
+            saved_value_.assign(raw_value.data(), raw_value.size());
+          }
         }
       }
       iter_->Prev();
@@ -287,11 +340,25 @@ void DBIter::FindPrevUserEntry() {
 }
 //DHQ: 因为要找的是 <= 给定seq的有效的key(非DEL)，所以FindNextUserEntry去除无效的
 void DBIter::Seek(const Slice& target) {
+  if (tailing_) {
+    db_->RenewInternalIterator(iter_, &sequence_);
+  }
   direction_ = kForward;
   ClearSavedValue();
+  prefix_bounded_ = (prefix_extractor_ != nullptr &&
+                     prefix_extractor_->InDomain(target));
+  if (prefix_bounded_) {
+    Slice prefix = prefix_extractor_->Transform(target);
+    prefix_.assign(prefix.data(), prefix.size());
+  }
+  Slice start = target;
+  if (lower_bound_ != nullptr &&
+      user_comparator_->Compare(target, *lower_bound_) < 0) {
+    start = *lower_bound_;
+  }
   saved_key_.clear();
   AppendInternalKey(
-      &saved_key_, ParsedInternalKey(target, sequence_, kValueTypeForSeek));
+      &saved_key_, ParsedInternalKey(start, sequence_, kValueTypeForSeek));
   iter_->Seek(saved_key_);
   if (iter_->Valid()) {//DHQ: 刚刚做了seek，不需要skip saved_key_，只是为了找到有效的而已
     FindNextUserEntry(false, &saved_key_ /* temporary storage */);
@@ -301,9 +368,20 @@ void DBIter::Seek(const Slice& target) {
 }
 
 void DBIter::SeekToFirst() {
+  if (tailing_) {
+    db_->RenewInternalIterator(iter_, &sequence_);
+  }
   direction_ = kForward;
   ClearSavedValue();
-  iter_->SeekToFirst();
+  prefix_bounded_ = false;
+  if (lower_bound_ != nullptr) {
+    saved_key_.clear();
+    AppendInternalKey(&saved_key_, ParsedInternalKey(
+        *lower_bound_, sequence_, kValueTypeForSeek));
+    iter_->Seek(saved_key_);
+  } else {
+    iter_->SeekToFirst();
+  }
   if (iter_->Valid()) {
     FindNextUserEntry(false, &saved_key_ /* temporary storage */);
   } else {
@@ -312,12 +390,40 @@ void DBIter::SeekToFirst() {
 }
 
 void DBIter::SeekToLast() {
+  if (tailing_) {
+    db_->RenewInternalIterator(iter_, &sequence_);
+  }
   direction_ = kReverse;
   ClearSavedValue();
-  iter_->SeekToLast();
+  prefix_bounded_ = false;
+  if (upper_bound_ != nullptr) {
+    // Position at the last entry before the bound
+    std::string limit;
+    AppendInternalKey(&limit, ParsedInternalKey(
+        *upper_bound_, kMaxSequenceNumber, kValueTypeForSeek));
+    iter_->Seek(limit);
+    if (iter_->Valid()) {
+      iter_->Prev();
+    } else {
+      iter_->SeekToLast();
+    }
+  } else {
+    iter_->SeekToLast();
+  }
   FindPrevUserEntry();
 }
 
+Status DBIter::Refresh() {
+  db_->RenewInternalIterator(iter_, &sequence_);
+  direction_ = kForward;
+  valid_ = false;
+  status_ = Status::OK();
+  ClearSavedValue();
+  saved_key_.clear();
+  prefix_bounded_ = false;
+  return Status::OK();
+}
+
 }  // anonymous namespace
 
 Iterator* NewDBIterator(
@@ -325,8 +431,15 @@ Iterator* NewDBIterator(
     const Comparator* user_key_comparator,
     Iterator* internal_iter,
     SequenceNumber sequence,
-    uint32_t seed) {
-  return new DBIter(db, user_key_comparator, internal_iter, sequence, seed);
+    uint32_t seed,
+    const SliceTransform* prefix_extractor,
+    const Slice* lower_bound,
+    const Slice* upper_bound,
+    bool pin_data,
+    bool tailing) {
+  return new DBIter(db, user_key_comparator, internal_iter, sequence, seed,
+                    prefix_extractor, lower_bound, upper_bound, pin_data,
+                    tailing);
 }
 
 }  // namespace leveldb
@@ -15,12 +15,28 @@ class DBImpl;
 
 // Return a new iterator that converts internal keys (yielded by
 // "*internal_iter") that were live at the specified "sequence" number
-// into appropriate user keys.
+// into appropriate user keys.  "*internal_iter" must come from "db",
+// which renews it and advances "sequence" on Refresh().
+//
+// If "prefix_extractor" is non-null, an iterator positioned by Seek(target)
+// becomes invalid at the first key whose prefix differs from that of
+// target (see ReadOptions::prefix_same_as_start).  Non-null "lower_bound"
+// and "upper_bound" restrict the iterator to user keys in
+// [*lower_bound, *upper_bound) (see ReadOptions::iterate_lower_bound).
+// If "pin_data" is true, "*internal_iter" must keep every value it
+// returned alive until it is deleted (see ReadOptions::pin_data).
+// If "tailing" is true, every seek renews "*internal_iter" and advances
+// "sequence" like Refresh() (see ReadOptions::tailing).
 Iterator* NewDBIterator(DBImpl* db,
                         const Comparator* user_key_comparator,
                         Iterator* internal_iter,
                         SequenceNumber sequence,
-                        uint32_t seed);
+                        uint32_t seed,
+                        const SliceTransform* prefix_extractor = nullptr,
+                        const Slice* lower_bound = nullptr,
+                        const Slice* upper_bound = nullptr,
+                        bool pin_data = false,
+                        bool tailing = false);
 
 }  // namespace leveldb
 
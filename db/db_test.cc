@@ -10,6 +10,8 @@
 #include "db/write_batch_internal.h"
 #include "leveldb/cache.h"
 #include "leveldb/env.h"
+#include "leveldb/persistent_cache.h"
+#include "leveldb/slice_transform.h"
 #include "leveldb/table.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
@@ -201,6 +203,16 @@ class SpecialEnv : public EnvWrapper {
   }
 
   Status NewRandomAccessFile(const std::string& f, RandomAccessFile** r) {
+    return CountReads(target()->NewRandomAccessFile(f, r), r);
+  }
+
+  Status NewUnmappedRandomAccessFile(const std::string& f,
+                                     RandomAccessFile** r) {
+    return CountReads(target()->NewUnmappedRandomAccessFile(f, r), r);
+  }
+
+ private:
+  Status CountReads(const Status& s, RandomAccessFile** r) {
     class CountingFile : public RandomAccessFile {
      private:
       RandomAccessFile* target_;
@@ -217,7 +229,6 @@ class SpecialEnv : public EnvWrapper {
       }
     };
 
-    Status s = target()->NewRandomAccessFile(f, r);
     if (s.ok() && count_random_reads_) {
       *r = new CountingFile(*r, &random_read_counter_);
     }
@@ -235,6 +246,7 @@ class DBTest {
     kReuse,
     kFilter,
     kUncompressed,
+    kDirectIO,
     kEnd
   };
   int option_config_;
@@ -288,6 +300,10 @@ class DBTest {
       case kUncompressed:
         options.compression = kNoCompression;
         break;
+      case kDirectIO:
+        options.use_direct_reads = true;
+        options.use_direct_io_for_flush_and_compaction = true;
+        break;
       default:
         break;
     }
@@ -722,6 +738,70 @@ TEST(DBTest, GetPicksCorrectFile) {
   } while (ChangeOptions());
 }
 
+TEST(DBTest, PinnedGet) {
+  do {
+    ASSERT_OK(Put("foo", "v1"));
+    PinnableSlice mem_value;
+    ASSERT_OK(db_->Get(ReadOptions(), "foo", &mem_value));
+    ASSERT_EQ("v1", mem_value.ToString());
+    ASSERT_TRUE(mem_value.IsPinned());
+
+    dbfull()->TEST_CompactMemTable();
+    PinnableSlice table_value;
+    ASSERT_OK(db_->Get(ReadOptions(), "foo", &table_value));
+    ASSERT_EQ("v1", table_value.ToString());
+    ASSERT_TRUE(table_value.IsPinned());
+
+    // Pinned values outlive their memtable and table file
+    ASSERT_OK(Put("foo", "v2"));
+    dbfull()->TEST_CompactMemTable();
+    Compact("a", "z");
+    ASSERT_EQ(1, TotalTableFiles());
+    ASSERT_EQ("v1", mem_value.ToString());
+    ASSERT_EQ("v1", table_value.ToString());
+    ASSERT_EQ("v2", Get("foo"));
+
+    PinnableSlice value;
+    ASSERT_TRUE(db_->Get(ReadOptions(), "bar", &value).IsNotFound());
+    ASSERT_TRUE(value.empty());
+    ASSERT_OK(Delete("foo"));
+    ASSERT_TRUE(db_->Get(ReadOptions(), "foo", &value).IsNotFound());
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_TRUE(db_->Get(ReadOptions(), "foo", &value).IsNotFound());
+    ASSERT_TRUE(!value.IsPinned());
+  } while (ChangeOptions());
+}
+
+TEST(DBTest, PinnedGetRowCache) {
+  Options options = CurrentOptions();
+  options.row_cache = NewLRUCache(1 << 20);
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+
+  ASSERT_OK(Put("foo", "v1"));
+  dbfull()->TEST_CompactMemTable();
+  {
+    // Served by a table lookup, then by the row cache
+    PinnableSlice first, second;
+    ASSERT_OK(db_->Get(ReadOptions(), "foo", &first));
+    ASSERT_OK(db_->Get(ReadOptions(), "foo", &second));
+    options.row_cache->Prune();
+    ASSERT_EQ("v1", first.ToString());
+    ASSERT_EQ("v1", second.ToString());
+
+    // Not added to the row cache
+    ReadOptions no_fill;
+    no_fill.fill_cache = false;
+    options.row_cache->Prune();
+    PinnableSlice third;
+    ASSERT_OK(db_->Get(no_fill, "foo", &third));
+    ASSERT_EQ("v1", third.ToString());
+  }
+
+  Close();
+  delete options.row_cache;
+}
+
 TEST(DBTest, GetEncountersEmptyLevel) {
   do {
     // Arrange for the following to happen:
@@ -1261,6 +1341,49 @@ TEST(DBTest, ApproximateSizes_MixOfSmallAndLarge) {
   } while (ChangeOptions());
 }
 
+TEST(DBTest, GetPropertiesOfAllTables) {
+  TablePropertiesCollection props;
+  ASSERT_OK(db_->GetPropertiesOfAllTables(&props));
+  ASSERT_TRUE(props.empty());
+
+  ASSERT_OK(Put("a", "va"));                // Sequence 1
+  ASSERT_OK(Put("b", "vb"));                // Sequence 2
+  ASSERT_OK(Put("c", "vc"));                // Sequence 3
+  ASSERT_OK(Delete("b"));                   // Sequence 4
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_OK(Put("a", "va2"));               // Sequence 5
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+
+  ASSERT_OK(db_->GetPropertiesOfAllTables(&props));
+  ASSERT_EQ(2, props.size());
+  TablePropertiesCollection::const_iterator it = props.begin();
+  const TableProperties& first = it->second;
+  ASSERT_EQ(0, it->first.find(dbname_));
+  ASSERT_EQ(4, first.num_entries);
+  ASSERT_EQ(1, first.num_deletions);
+  ASSERT_EQ(1, first.smallest_seqno);
+  ASSERT_EQ(4, first.largest_seqno);
+  ASSERT_EQ(4 * (1 + 8), first.raw_key_size);  // User key plus tag
+  ASSERT_EQ(6, first.raw_value_size);          // The deletion has no value
+  ASSERT_EQ(1, first.num_data_blocks);
+  ++it;
+  const TableProperties& second = it->second;
+  ASSERT_EQ(1, second.num_entries);
+  ASSERT_EQ(0, second.num_deletions);
+  ASSERT_EQ(5, second.smallest_seqno);
+  ASSERT_EQ(5, second.largest_seqno);
+
+  // Compacting everything drops the deletion and the values it and the
+  // newer "a" hide.
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_OK(db_->GetPropertiesOfAllTables(&props));
+  ASSERT_EQ(1, props.size());
+  ASSERT_EQ(2, props.begin()->second.num_entries);
+  ASSERT_EQ(0, props.begin()->second.num_deletions);
+  ASSERT_EQ(3, props.begin()->second.smallest_seqno);
+  ASSERT_EQ(5, props.begin()->second.largest_seqno);
+}
+
 TEST(DBTest, IteratorPinsRef) {
   Put("foo", "hello");
 
@@ -1283,6 +1406,197 @@ TEST(DBTest, IteratorPinsRef) {
   delete iter;
 }
 
+TEST(DBTest, PinData) {
+  Cache* tiny_cache = NewLRUCache(1000);  // Evicts blocks right away
+  do {
+    Options options = CurrentOptions();
+    options.block_cache = tiny_cache;
+    Reopen(&options);
+
+    // Several versions of each key, spread over two tables and the
+    // memtable, with some keys deleted.
+    Random rnd(301);
+    for (int i = 0; i < 500; i++) {
+      ASSERT_OK(Put(Key(i), RandomString(&rnd, 100)));
+    }
+    dbfull()->TEST_CompactMemTable();
+    for (int i = 0; i < 500; i += 3) {
+      ASSERT_OK(Put(Key(i), RandomString(&rnd, 200)));
+    }
+    dbfull()->TEST_CompactMemTable();
+    for (int i = 0; i < 500; i += 7) {
+      if (i % 2 == 0) {
+        ASSERT_OK(Delete(Key(i)));
+      } else {
+        ASSERT_OK(Put(Key(i), RandomString(&rnd, 50)));
+      }
+    }
+
+    ReadOptions pinned;
+    pinned.pin_data = true;
+    Iterator* iter = db_->NewIterator(pinned);
+    std::vector<std::string> keys;
+    std::vector<Slice> values;
+    for (iter->SeekToLast(); iter->Valid(); iter->Prev()) {
+      keys.push_back(iter->key().ToString());
+      values.push_back(iter->value());
+    }
+    ASSERT_OK(iter->status());
+    ASSERT_EQ(500 - 36, keys.size());
+
+    // The values refer to blocks that were pinned by the iterator
+    for (size_t i = 0; i < keys.size(); i++) {
+      ASSERT_EQ(Get(keys[i]), values[i].ToString());
+    }
+
+    // Same entries as without pinning, in both directions
+    Iterator* plain = db_->NewIterator(ReadOptions());
+    size_t n = keys.size();
+    for (plain->SeekToFirst(); plain->Valid(); plain->Next()) {
+      ASSERT_TRUE(n > 0);
+      n--;
+      ASSERT_EQ(keys[n], plain->key().ToString());
+      ASSERT_EQ(values[n].ToString(), plain->value().ToString());
+    }
+    ASSERT_EQ(0, n);
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      ASSERT_EQ(keys[keys.size() - 1 - n], iter->key().ToString());
+      n++;
+    }
+    ASSERT_EQ(keys.size(), n);
+    delete plain;
+    delete iter;
+  } while (ChangeOptions());
+  Close();
+  delete tiny_cache;
+}
+
+TEST(DBTest, TailingIterator) {
+  do {
+    ReadOptions tailing;
+    tailing.tailing = true;
+    Iterator* iter = db_->NewIterator(tailing);
+    Iterator* plain = db_->NewIterator(ReadOptions());
+    iter->SeekToFirst();
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+
+    // Writes to the memtable become visible on the next seek
+    ASSERT_OK(Put("b", "v1"));
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+    iter->SeekToFirst();
+    ASSERT_EQ(IterStatus(iter), "b->v1");
+    ASSERT_OK(Put("a", "v1"));
+    ASSERT_OK(Put("b", "v2"));
+    iter->Seek("b");
+    ASSERT_EQ(IterStatus(iter), "b->v2");
+    iter->Prev();
+    ASSERT_EQ(IterStatus(iter), "a->v1");
+
+    // And so do flushed and compacted files
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_OK(Put("c", "v1"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_OK(Delete("a"));
+    iter->SeekToFirst();
+    ASSERT_EQ(IterStatus(iter), "b->v2");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "c->v1");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+    dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+    ASSERT_OK(Put("d", "v1"));
+    iter->SeekToLast();
+    ASSERT_EQ(IterStatus(iter), "d->v1");
+    iter->Prev();
+    ASSERT_EQ(IterStatus(iter), "c->v1");
+    ASSERT_OK(iter->status());
+
+    // A snapshot does not hold the iterator back
+    const Snapshot* snapshot = db_->GetSnapshot();
+    tailing.snapshot = snapshot;
+    Iterator* iter2 = db_->NewIterator(tailing);
+    ASSERT_OK(Put("e", "v1"));
+    iter2->SeekToLast();
+    ASSERT_EQ(IterStatus(iter2), "e->v1");
+    db_->ReleaseSnapshot(snapshot);
+    delete iter2;
+
+    // The plain iterator still reads the state it was created with
+    plain->SeekToFirst();
+    ASSERT_EQ(IterStatus(plain), "(invalid)");
+    delete plain;
+    delete iter;
+  } while (ChangeOptions());
+}
+
+TEST(DBTest, IteratorRefresh) {
+  do {
+    ASSERT_OK(Put("a", "v1"));
+    ASSERT_OK(Put("c", "v1"));
+    const Snapshot* snapshot = db_->GetSnapshot();
+    ReadOptions options;
+    options.snapshot = snapshot;
+    options.pin_data = true;
+    Iterator* iter = db_->NewIterator(options);
+    ASSERT_OK(Put("b", "v1"));
+    iter->SeekToLast();
+    ASSERT_EQ(IterStatus(iter), "c->v1");
+    Slice pinned = iter->value();
+
+    // Refresh moves past the snapshot to the latest state
+    ASSERT_OK(iter->Refresh());
+    ASSERT_TRUE(!iter->Valid());
+    iter->Seek("b");
+    ASSERT_EQ(IterStatus(iter), "b->v1");
+
+    // Memtables and files replaced by flushes and compactions are
+    // dropped; values read before stay pinned.
+    ASSERT_OK(Put("c", "v2"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_OK(Delete("a"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_OK(Put("d", "v1"));
+    ASSERT_OK(iter->Refresh());
+    iter->SeekToFirst();
+    ASSERT_EQ(IterStatus(iter), "b->v1");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "c->v2");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "d->v1");
+    dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+    ASSERT_OK(Put("e", "v1"));
+    ASSERT_OK(iter->Refresh());
+    iter->SeekToLast();
+    ASSERT_EQ(IterStatus(iter), "e->v1");
+    iter->Prev();
+    ASSERT_EQ(IterStatus(iter), "d->v1");
+    ASSERT_EQ("v1", pinned.ToString());
+    ASSERT_OK(iter->status());
+    delete iter;
+    db_->ReleaseSnapshot(snapshot);
+
+    // Bounds are kept
+    Slice lower("b"), upper("d");
+    ReadOptions bounded;
+    bounded.iterate_lower_bound = &lower;
+    bounded.iterate_upper_bound = &upper;
+    iter = db_->NewIterator(bounded);
+    ASSERT_OK(Put("bb", "v1"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_OK(iter->Refresh());
+    std::string keys;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      keys += iter->key().ToString() + " ";
+    }
+    ASSERT_EQ("b bb c ", keys);
+    delete iter;
+  } while (ChangeOptions());
+
+  Iterator* empty = NewEmptyIterator();
+  ASSERT_TRUE(empty->Refresh().IsNotSupportedError());
+  delete empty;
+}
+
 TEST(DBTest, Snapshot) {
   do {
     Put("foo", "v1");
@@ -1316,6 +1630,15 @@ TEST(DBTest, HiddenValuesAreRemoved) {
   do {
     Random rnd(301);
     FillLevels("a", "z");
+    // Wait for the compaction of the level-0 files made by FillLevels(),
+    // which may be slow with direct I/O, so that it does not run while
+    // the snapshot below keeps the hidden value alive.
+    // Give up after a while rather than hang if compactions have stopped.
+    const uint64_t deadline = env_->NowMicros() + 30 * 1000000;
+    while (NumTableFilesAtLevel(0) >= config::kL0_CompactionTrigger) {
+      ASSERT_LT(env_->NowMicros(), deadline);
+      env_->SleepForMicroseconds(1000);
+    }
 
     std::string big = RandomString(&rnd, 50000);
     Put("foo", big);
@@ -1904,6 +2227,997 @@ TEST(DBTest, BloomFilter) {
   delete options.filter_policy;
 }
 
+TEST(DBTest, FullFilter) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.full_filter = true;
+  Reopen(&options);
+
+  const int N = 10000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), Key(i)));
+  }
+  Compact("a", "z");
+  for (int i = 0; i < N; i += 100) {
+    ASSERT_OK(Put(Key(i), Key(i)));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.Release_Store(env_);
+
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+  int reads = env_->random_read_counter_.Read();
+  fprintf(stderr, "%d present => %d reads\n", N, reads);
+  ASSERT_GE(reads, N);
+  ASSERT_LE(reads, N + 2*N/100);
+
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+  }
+  reads = env_->random_read_counter_.Read();
+  fprintf(stderr, "%d missing => %d reads\n", N, reads);
+  ASSERT_LE(reads, 3*N/100);
+
+  // Tables written with per-block filters remain readable.
+  env_->delay_data_sync_.Release_Store(nullptr);
+  options.full_filter = false;
+  Reopen(&options);
+  ASSERT_OK(Put(Key(N), Key(N)));
+  dbfull()->TEST_CompactMemTable();
+  options.full_filter = true;
+  Reopen(&options);
+  for (int i = 0; i <= N; i += 100) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+  ASSERT_EQ("NOT_FOUND", Get(Key(N) + ".missing"));
+
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+}
+
+static std::string UserKey(int user, int item) {
+  char buf[100];
+  snprintf(buf, sizeof(buf), "user%04d/%03d", user, item);
+  return std::string(buf);
+}
+
+TEST(DBTest, PrefixSameAsStart) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.prefix_extractor = NewFixedPrefixTransform(8);  // "userNNNN"
+  options.create_if_missing = true;
+
+  for (int full = 0; full < 2; full++) {
+    options.full_filter = (full != 0);
+    DestroyAndReopen(&options);
+
+    // Users with even numbers, spread over two levels
+    const int kUsers = 200;
+    for (int u = 0; u < kUsers; u += 2) {
+      for (int i = 0; i < 5; i++) {
+        ASSERT_OK(Put(UserKey(u, i), std::string(100, 'v')));
+      }
+    }
+    Compact("a", "z");
+    for (int u = 0; u < kUsers; u += 20) {
+      ASSERT_OK(Put(UserKey(u, 5), "new"));
+    }
+    dbfull()->TEST_CompactMemTable();
+
+    // Prevent auto compactions triggered by seeks
+    env_->delay_data_sync_.Release_Store(env_);
+
+    ReadOptions ropts;
+    ropts.prefix_same_as_start = true;
+    Iterator* iter = db_->NewIterator(ropts);
+
+    // A seek only yields keys with the prefix of its target
+    iter->Seek("user0020");
+    for (int i = 0; i < 6; i++) {
+      ASSERT_TRUE(iter->Valid());
+      ASSERT_EQ(UserKey(20, i), iter->key().ToString());
+      iter->Next();
+    }
+    ASSERT_TRUE(!iter->Valid());
+    iter->Seek(UserKey(22, 3));
+    ASSERT_EQ(UserKey(22, 3), IterStatus(iter).substr(0, 12));
+    iter->Next();
+    iter->Next();
+    ASSERT_EQ("(invalid)", IterStatus(iter));
+
+    // Seeks to missing prefixes are mostly answered by the filters
+    env_->random_read_counter_.Reset();
+    for (int u = 1; u < kUsers; u += 2) {
+      iter->Seek(UserKey(u, 0));
+      ASSERT_TRUE(!iter->Valid());
+    }
+    int reads = env_->random_read_counter_.Read();
+    fprintf(stderr, "%d missing prefixes => %d reads\n", kUsers / 2, reads);
+    ASSERT_LE(reads, kUsers / 8);
+
+    // Targets outside of the domain are not bounded
+    iter->Seek("user");
+    ASSERT_EQ(UserKey(0, 0), IterStatus(iter).substr(0, 12));
+    iter->Next();
+    ASSERT_EQ(UserKey(0, 1), IterStatus(iter).substr(0, 12));
+    delete iter;
+
+    // Without the option, a seek moves on to the next prefix
+    iter = db_->NewIterator(ReadOptions());
+    iter->Seek(UserKey(21, 0));
+    ASSERT_EQ(UserKey(22, 0), IterStatus(iter).substr(0, 12));
+    delete iter;
+    env_->delay_data_sync_.Release_Store(nullptr);
+  }
+
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+  delete options.prefix_extractor;
+}
+
+TEST(DBTest, IterateBounds) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+
+  // Even keys with one block each, spread over several files and levels
+  for (int i = 0; i < 1000; i += 2) {
+    ASSERT_OK(Put(Key(i), std::string(5000, 'v')));
+  }
+  Compact("a", "z");
+  ASSERT_OK(Delete(Key(150)));
+  ASSERT_OK(Put(Key(900), "l0"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(Put(Key(151), "mem"));
+
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.Release_Store(env_);
+
+  const std::string lower_key = Key(100);
+  const std::string upper_key = Key(161);
+  Slice lower(lower_key);
+  Slice upper(upper_key);
+  ReadOptions ropts;
+  ropts.iterate_lower_bound = &lower;
+  ropts.iterate_upper_bound = &upper;
+  Iterator* iter = db_->NewIterator(ropts);
+
+  std::string forward;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    forward += iter->key().ToString() + ",";
+  }
+  ASSERT_OK(iter->status());
+  std::string expected;
+  for (int i = 100; i <= 160; i++) {
+    if ((i % 2 == 0 && i != 150) || i == 151) {
+      expected += Key(i) + ",";
+    }
+  }
+  ASSERT_EQ(expected, forward);
+
+  std::string backward;
+  for (iter->SeekToLast(); iter->Valid(); iter->Prev()) {
+    backward = iter->key().ToString() + "," + backward;
+  }
+  ASSERT_OK(iter->status());
+  ASSERT_EQ(forward, backward);
+
+  // Seeks are confined to the bounds as well
+  iter->Seek(Key(10));
+  ASSERT_EQ(Key(100), iter->key().ToString());
+  iter->Seek(Key(159));
+  ASSERT_EQ(Key(160), iter->key().ToString());
+  iter->Next();
+  ASSERT_TRUE(!iter->Valid());
+  iter->Seek(Key(900));
+  ASSERT_TRUE(!iter->Valid());
+
+  // Scanning up to the bound does not read the block after it: 21 blocks
+  // of the range in the last level plus one of the level-0 file.
+  env_->random_read_counter_.Reset();
+  int count = 0;
+  for (iter->Seek(Key(120)); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_EQ(21, count);
+  ASSERT_EQ(22, env_->random_read_counter_.Read());
+  delete iter;
+
+  // Without a bound, the caller only stops after the next block is read
+  iter = db_->NewIterator(ReadOptions());
+  env_->random_read_counter_.Reset();
+  for (iter->Seek(Key(120)); iter->Valid(); iter->Next()) {
+    if (iter->key().compare(upper) >= 0) break;
+  }
+  ASSERT_EQ(23, env_->random_read_counter_.Read());
+  delete iter;
+
+  env_->delay_data_sync_.Release_Store(nullptr);
+  Close();
+  delete options.block_cache;
+}
+
+// Collects the entries passed to the ScanFunction of ParallelScan()
+struct ScanResult {
+  DB* db;
+  std::vector<std::vector<std::string> > shards;  // "key=value" per shard
+  int limit;  // Most entries to take from each shard
+};
+
+static bool CollectShard(void* arg, int shard, const Slice& key,
+                         const Slice& value) {
+  ScanResult* result = reinterpret_cast<ScanResult*>(arg);
+  std::vector<std::string>* entries = &result->shards[shard];
+  if (entries->empty()) {
+    // Not seen by the scan, which uses a snapshot taken before
+    ASSERT_OK(result->db->Put(WriteOptions(), key.ToString() + "new", "v"));
+  }
+  entries->push_back(key.ToString() + "=" + value.ToString());
+  return static_cast<int>(entries->size()) < result->limit;
+}
+
+TEST(DBTest, ParallelScan) {
+  // One table per 100 keys
+  Random rnd(301);
+  for (int i = 0; i < 2000; i++) {
+    ASSERT_OK(Put(Key(i), RandomString(&rnd, 100)));
+    if (i % 100 == 99) {
+      dbfull()->TEST_CompactMemTable();
+    }
+  }
+  for (int i = 0; i < 2000; i += 10) {
+    ASSERT_OK(Put(Key(i), "mem"));  // Left in the memtable
+  }
+  ASSERT_GT(TotalTableFiles(), 10);
+
+  const int kShards = 8;
+  const std::string begin_key = Key(100);
+  const std::string end_key = Key(1900);
+  const Slice begin(begin_key), end(end_key);
+  const Slice* bounds[][2] = { { nullptr, nullptr }, { &begin, &end } };
+  for (int b = 0; b < 2; b++) {
+    const Slice* lower = bounds[b][0];
+    const Slice* upper = bounds[b][1];
+    std::vector<std::string> expected;
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      const Slice key = iter->key();
+      if ((lower == nullptr || key.compare(*lower) >= 0) &&
+          (upper == nullptr || key.compare(*upper) < 0)) {
+        expected.push_back(key.ToString() + "=" + iter->value().ToString());
+      }
+    }
+    delete iter;
+
+    ScanResult result;
+    result.db = db_;
+    result.shards.resize(kShards);
+    result.limit = 1 << 30;
+    ASSERT_OK(db_->ParallelScan(ReadOptions(), lower, upper, kShards,
+                                &CollectShard, &result));
+
+    // The shards are in key order and cover the range exactly once
+    std::vector<std::string> scanned;
+    int used = 0;
+    for (int i = 0; i < kShards; i++) {
+      scanned.insert(scanned.end(), result.shards[i].begin(),
+                     result.shards[i].end());
+      if (!result.shards[i].empty()) {
+        used++;
+        ASSERT_LT(result.shards[i].size(), expected.size() / 2);
+      }
+    }
+    ASSERT_GT(used, kShards / 2);
+    ASSERT_EQ(expected.size(), scanned.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+      ASSERT_EQ(expected[i], scanned[i]);
+    }
+
+    // Keys written during the scan were not seen
+    ASSERT_EQ("v", Get(result.shards[0][0].substr(0, 9) + "new"));
+  }
+
+  // Stopping a shard early
+  ScanResult result;
+  result.db = db_;
+  result.shards.resize(kShards);
+  result.limit = 3;
+  ASSERT_OK(db_->ParallelScan(ReadOptions(), nullptr, nullptr, kShards,
+                              &CollectShard, &result));
+  for (int i = 0; i < kShards; i++) {
+    ASSERT_LE(result.shards[i].size(), 3);
+  }
+
+  ASSERT_TRUE(db_->ParallelScan(ReadOptions(), nullptr, nullptr, 0,
+                                &CollectShard, &result).IsInvalidArgument());
+}
+
+TEST(DBTest, ReadaheadScan) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+
+  // One block per key in the last level
+  Random rnd(301);
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_OK(Put(Key(i), RandomString(&rnd, 5000)));
+  }
+  Compact("a", "z");
+  env_->delay_data_sync_.Release_Store(env_);
+
+  ReadOptions ropts;
+  ropts.fill_cache = false;
+  std::string plain;
+  env_->random_read_counter_.Reset();
+  Iterator* iter = db_->NewIterator(ropts);
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    plain += iter->key().ToString() + iter->value().ToString();
+  }
+  ASSERT_OK(iter->status());
+  delete iter;
+  const int plain_reads = env_->random_read_counter_.Read();
+  ASSERT_GE(plain_reads, 1000);
+
+  // The same scan with readahead returns the same data in far fewer reads
+  ropts.readahead_size = 256 * 1024;
+  std::string readahead;
+  env_->random_read_counter_.Reset();
+  iter = db_->NewIterator(ropts);
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    readahead += iter->key().ToString() + iter->value().ToString();
+  }
+  ASSERT_OK(iter->status());
+  delete iter;
+  ASSERT_EQ(plain, readahead);
+  ASSERT_LT(env_->random_read_counter_.Read(), plain_reads / 10);
+
+  env_->delay_data_sync_.Release_Store(nullptr);
+  Close();
+  delete options.block_cache;
+}
+
+// Env whose random access files always return data copied into the
+// caller's scratch buffer (like pread), so blocks are eligible for caching.
+class CopyingReadEnv : public EnvWrapper {
+ public:
+  explicit CopyingReadEnv(Env* base) : EnvWrapper(base) { }
+
+  Status NewRandomAccessFile(const std::string& f, RandomAccessFile** r) {
+    class CopyingFile : public RandomAccessFile {
+     private:
+      RandomAccessFile* target_;
+     public:
+      explicit CopyingFile(RandomAccessFile* target) : target_(target) { }
+      virtual ~CopyingFile() { delete target_; }
+      virtual Status Read(uint64_t offset, size_t n, Slice* result,
+                          char* scratch) const {
+        Status s = target_->Read(offset, n, result, scratch);
+        if (s.ok() && result->data() != scratch) {
+          memmove(scratch, result->data(), result->size());
+          *result = Slice(scratch, result->size());
+        }
+        return s;
+      }
+    };
+
+    Status s = target()->NewRandomAccessFile(f, r);
+    if (s.ok()) {
+      *r = new CopyingFile(*r);
+    }
+    return s;
+  }
+};
+
+// Env that records the last access hint given to any of its random
+// access files.
+class HintRecordingEnv : public EnvWrapper {
+ public:
+  port::Mutex mu_;
+  RandomAccessFile::AccessPattern last_hint_;
+  int hints_;
+
+  explicit HintRecordingEnv(Env* base)
+      : EnvWrapper(base), last_hint_(RandomAccessFile::kNormal), hints_(0) { }
+
+  RandomAccessFile::AccessPattern LastHint() {
+    MutexLock l(&mu_);
+    return last_hint_;
+  }
+
+  int Hints() {
+    MutexLock l(&mu_);
+    return hints_;
+  }
+
+  Status NewRandomAccessFile(const std::string& f, RandomAccessFile** r) {
+    class HintRecordingFile : public RandomAccessFile {
+     private:
+      HintRecordingEnv* env_;
+      RandomAccessFile* target_;
+     public:
+      HintRecordingFile(HintRecordingEnv* env, RandomAccessFile* target)
+          : env_(env), target_(target) { }
+      virtual ~HintRecordingFile() { delete target_; }
+      virtual Status Read(uint64_t offset, size_t n, Slice* result,
+                          char* scratch) const {
+        return target_->Read(offset, n, result, scratch);
+      }
+      virtual void Hint(AccessPattern pattern) {
+        MutexLock l(&env_->mu_);
+        env_->last_hint_ = pattern;
+        env_->hints_++;
+        target_->Hint(pattern);
+      }
+    };
+
+    Status s = target()->NewRandomAccessFile(f, r);
+    if (s.ok()) {
+      *r = new HintRecordingFile(this, *r);
+    }
+    return s;
+  }
+};
+
+TEST(DBTest, ReadaheadRestoresOpenHint) {
+  HintRecordingEnv env(env_);
+  Options options = CurrentOptions();
+  options.env = &env;
+  options.create_if_missing = true;
+  options.advise_random_on_open = true;
+  DestroyAndReopen(&options);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_OK(Put(Key(i), "v"));
+  }
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("v", Get(Key(1)));
+  ASSERT_EQ(RandomAccessFile::kRandom, env.LastHint());
+
+  // Sequential while any readahead iterator is alive
+  ReadOptions readahead;
+  readahead.readahead_size = 1 << 20;
+  Iterator* first = db_->NewIterator(readahead);
+  first->SeekToFirst();
+  ASSERT_TRUE(first->Valid());
+  ASSERT_EQ(RandomAccessFile::kSequential, env.LastHint());
+  Iterator* second = db_->NewIterator(readahead);
+  second->SeekToFirst();
+  ASSERT_TRUE(second->Valid());
+  delete first;
+  ASSERT_EQ(RandomAccessFile::kSequential, env.LastHint());
+  ASSERT_EQ("v", Get(Key(2)));
+  delete second;
+  ASSERT_EQ(RandomAccessFile::kRandom, env.LastHint());
+
+  // Other iterators leave the hint alone
+  const int hints = env.Hints();
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  iter->SeekToFirst();
+  ASSERT_TRUE(iter->Valid());
+  delete iter;
+  ASSERT_EQ(hints, env.Hints());
+  Close();
+}
+
+TEST(DBTest, CacheIndexAndFilterBlocks) {
+  CopyingReadEnv env(env_);
+  Options options = CurrentOptions();
+  options.env = &env;
+  options.create_if_missing = true;
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.cache_index_and_filter_blocks = true;
+
+  for (int pin = 0; pin < 2; pin++) {
+    options.pin_l0_filter_and_index_blocks_in_cache = (pin == 1);
+    options.block_cache = NewLRUCache(1 << 20);
+    DestroyAndReopen(&options);
+
+    ASSERT_OK(Put("foo", "v1"));
+    ASSERT_OK(Put("bar", "v2"));
+    Reopen(&options);  // Recovery writes the table to level 0
+    ASSERT_EQ(1, NumTableFilesAtLevel(0));
+    ASSERT_GT(options.block_cache->TotalCharge(), 0);
+
+    // Unpinned index and filter blocks can be dropped from the cache and
+    // are transparently reloaded.
+    options.block_cache->Prune();
+    if (pin) {
+      ASSERT_GT(options.block_cache->TotalCharge(), 0);
+    } else {
+      ASSERT_EQ(0, options.block_cache->TotalCharge());
+    }
+    ASSERT_EQ("v1", Get("foo"));
+    ASSERT_EQ("v2", Get("bar"));
+    ASSERT_EQ("NOT_FOUND", Get("baz"));
+    ASSERT_EQ("(bar->v2)(foo->v1)", Contents());
+
+    Close();
+    delete options.block_cache;
+  }
+  delete options.filter_policy;
+}
+
+TEST(DBTest, RowCache) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent block cache hits
+  options.row_cache = NewLRUCache(1 << 20);
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+
+  ASSERT_OK(Put("a", "va"));
+  ASSERT_OK(Put("b", "vb1"));
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_OK(Put("b", "vb2"));
+  ASSERT_OK(Put("c", "vc"));
+  ASSERT_OK(Delete("c"));
+  dbfull()->TEST_CompactMemTable();
+
+  for (int i = 0; i < 2; i++) {
+    ASSERT_EQ("va", Get("a"));
+    ASSERT_EQ("vb2", Get("b"));
+    ASSERT_EQ("NOT_FOUND", Get("c"));
+    ASSERT_EQ("NOT_FOUND", Get("d"));
+    // Entries newer than the snapshot are skipped
+    ASSERT_EQ("va", Get("a", snapshot));
+    ASSERT_EQ("vb1", Get("b", snapshot));
+    ASSERT_EQ("NOT_FOUND", Get("c", snapshot));
+  }
+  ASSERT_GT(options.row_cache->TotalCharge(), 0);
+
+  // Once cached, lookups of the newest values do not touch the table
+  env_->random_read_counter_.Reset();
+  ASSERT_EQ("va", Get("a"));
+  ASSERT_EQ("vb2", Get("b"));
+  ASSERT_EQ("NOT_FOUND", Get("c"));
+  ASSERT_EQ(0, env_->random_read_counter_.Read());
+
+  // Entries of newer tables take precedence
+  ASSERT_OK(Put("a", "va2"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("va2", Get("a"));
+  ASSERT_EQ("va", Get("a", snapshot));
+
+  db_->ReleaseSnapshot(snapshot);
+  Close();
+  delete options.block_cache;
+  delete options.row_cache;
+}
+
+TEST(DBTest, PersistentCache) {
+  const std::string dir = test::TmpDir() + "/db_test_persistent_cache";
+  Env* const env = Env::Default();
+  PersistentCache* cache = nullptr;
+  ASSERT_OK(NewPersistentCache(env, dir, 1 << 20, &cache));
+
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent block cache hits
+  options.persistent_cache = cache;
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+
+  Random rnd(301);
+  std::vector<std::string> values;
+  for (int i = 0; i < 100; i++) {
+    values.push_back(RandomString(&rnd, 1000));
+    ASSERT_OK(Put(Key(i), values[i]));
+  }
+  dbfull()->TEST_CompactMemTable();
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+  ASSERT_GT(cache->TotalSize(), 100 * 1000);
+
+  // The cached blocks survive a restart of both the cache and the DB.
+  Close();
+  delete cache;
+  ASSERT_OK(NewPersistentCache(env, dir, 1 << 20, &cache));
+  options.persistent_cache = cache;
+  env_->count_random_reads_ = true;
+  Reopen(&options);
+  ASSERT_EQ(values[0], Get(Key(0)));  // Opens the table
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+  ASSERT_EQ(0, env_->random_read_counter_.Read());
+
+  // A new database of the same name, whose table has the same number and
+  // layout, does not find the blocks of the old one.
+  DestroyAndReopen(&options);
+  for (int i = 0; i < 100; i++) {
+    values[i] = RandomString(&rnd, 1000);
+    ASSERT_OK(Put(Key(i), values[i]));
+  }
+  dbfull()->TEST_CompactMemTable();
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+
+  Close();
+  delete options.block_cache;
+  delete cache;
+  std::vector<std::string> files;
+  env->GetChildren(dir, &files);
+  for (size_t i = 0; i < files.size(); i++) {
+    env->DeleteFile(dir + "/" + files[i]);
+  }
+  env->DeleteDir(dir);
+}
+
+// Persistent cache that keeps its entries in memory and, once told to,
+// returns them with their first byte flipped.
+class CorruptingPersistentCache : public PersistentCache {
+ public:
+  CorruptingPersistentCache() : corrupt_(false) { }
+
+  void SetCorrupt(bool corrupt) {
+    MutexLock l(&mu_);
+    corrupt_ = corrupt;
+  }
+
+  Status Insert(const Slice& key, const Slice& data) override {
+    MutexLock l(&mu_);
+    entries_[key.ToString()] = data.ToString();
+    return Status::OK();
+  }
+
+  Status Lookup(const Slice& key, std::string* data) override {
+    MutexLock l(&mu_);
+    std::map<std::string, std::string>::const_iterator iter =
+        entries_.find(key.ToString());
+    if (iter == entries_.end()) {
+      return Status::NotFound(Slice());
+    }
+    *data = iter->second;
+    if (corrupt_ && !data->empty()) {
+      (*data)[0] ^= 1;
+    }
+    return Status::OK();
+  }
+
+  uint64_t TotalSize() override {
+    MutexLock l(&mu_);
+    uint64_t total = 0;
+    std::map<std::string, std::string>::const_iterator iter;
+    for (iter = entries_.begin(); iter != entries_.end(); ++iter) {
+      total += iter->first.size() + iter->second.size();
+    }
+    return total;
+  }
+
+ private:
+  port::Mutex mu_;
+  bool corrupt_ GUARDED_BY(mu_);
+  std::map<std::string, std::string> entries_ GUARDED_BY(mu_);
+};
+
+TEST(DBTest, PersistentCacheVerifiesChecksums) {
+  CorruptingPersistentCache cache;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent block cache hits
+  options.persistent_cache = &cache;
+  options.create_if_missing = true;
+  env_->count_random_reads_ = true;
+  DestroyAndReopen(&options);
+
+  Random rnd(301);
+  std::vector<std::string> values;
+  for (int i = 0; i < 100; i++) {
+    values.push_back(RandomString(&rnd, 1000));
+    ASSERT_OK(Put(Key(i), values[i]));
+  }
+  dbfull()->TEST_CompactMemTable();
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+  ASSERT_GT(cache.TotalSize(), 100 * 1000);
+
+  // Corrupted entries fail their checksums and are read from the table
+  // file instead.
+  cache.SetCorrupt(true);
+  ReadOptions ropts;
+  ropts.verify_checksums = true;
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < 100; i++) {
+    std::string value;
+    ASSERT_OK(db_->Get(ropts, Key(i), &value));
+    ASSERT_EQ(values[i], value);
+  }
+  ASSERT_GT(env_->random_read_counter_.Read(), 0);
+
+  Close();
+  delete options.block_cache;
+}
+
+TEST(DBTest, PreloadTablesOnOpen) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+  for (int t = 0; t < 5; t++) {
+    for (int i = 0; i < 10; i++) {
+      ASSERT_OK(Put(Key(t * 10 + i), "v"));
+    }
+    dbfull()->TEST_CompactMemTable();
+  }
+  ASSERT_EQ(5, TotalTableFiles());
+
+  // Without preloading, the first read of each table opens it.
+  Reopen(&options);
+  env_->count_random_reads_ = true;
+  env_->random_read_counter_.Reset();
+  for (int t = 0; t < 5; t++) {
+    ASSERT_EQ("v", Get(Key(t * 10)));
+  }
+  ASSERT_GT(env_->random_read_counter_.Read(), 5);
+
+  // With preloading, only the data blocks are left to read.
+  options.preload_tables_on_open = true;
+  options.max_file_opening_threads = 3;
+  Reopen(&options);
+  env_->random_read_counter_.Reset();
+  for (int t = 0; t < 5; t++) {
+    ASSERT_EQ("v", Get(Key(t * 10)));
+  }
+  ASSERT_EQ(5, env_->random_read_counter_.Read());
+}
+
+TEST(DBTest, MmapPolicy) {
+  for (int mapped = 0; mapped < 2; mapped++) {
+    Options options = CurrentOptions();
+    options.env = env_;
+    options.create_if_missing = true;
+    options.compression = kNoCompression;
+    options.advise_random_on_open = true;
+    if (!mapped) {
+      options.mmap_max_level = -1;
+    }
+    DestroyAndReopen(&options);
+    for (int i = 0; i < 100; i++) {
+      ASSERT_OK(Put(Key(i), std::string(1000, 'a' + i % 26)));
+    }
+    dbfull()->TEST_CompactMemTable();
+    for (int i = 0; i < 100; i++) {
+      ASSERT_EQ(std::string(1000, 'a' + i % 26), Get(Key(i)));
+    }
+
+    // Blocks of mapped files are not copied into the block cache, so
+    // they are read from the file every time.
+    env_->count_random_reads_ = true;
+    env_->random_read_counter_.Reset();
+    Reopen(&options);
+    for (int r = 0; r < 2; r++) {
+      for (int i = 0; i < 100; i++) {
+        ASSERT_EQ(std::string(1000, 'a' + i % 26), Get(Key(i)));
+      }
+      if (r == 0) {
+        env_->random_read_counter_.Reset();
+      }
+    }
+    if (mapped) {
+      ASSERT_GE(env_->random_read_counter_.Read(), 100);
+    } else {
+      ASSERT_EQ(0, env_->random_read_counter_.Read());
+    }
+    env_->count_random_reads_ = false;
+  }
+}
+
+TEST(DBTest, MmapPolicyAboveLevelZero) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.create_if_missing = true;
+  options.compression = kNoCompression;
+  options.mmap_max_level = 0;
+  DestroyAndReopen(&options);
+  env_->count_random_reads_ = true;  // Must be set before files are opened
+  for (int i = 0; i < 100; i++) {
+    ASSERT_OK(Put(Key(i), std::string(1000, 'a' + i % 26)));
+  }
+  dbfull()->TEST_CompactMemTable();
+  for (int i = 0; i < 100; i += 2) {
+    ASSERT_OK(Put(Key(i), std::string(1000, 'A' + i % 26)));
+  }
+  dbfull()->TEST_CompactMemTable();
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_EQ(0, NumTableFilesAtLevel(0));
+  ASSERT_EQ(0, NumTableFilesAtLevel(1));
+  ASSERT_GT(NumTableFilesAtLevel(2), 0);
+
+  // The compaction output is still open from its verification.  It must
+  // not be mapped, so after a first pass the reads of Get() and of
+  // iterators are served by the block cache.
+  for (int r = 0; r < 2; r++) {
+    env_->random_read_counter_.Reset();
+    for (int i = 0; i < 100; i++) {
+      ASSERT_EQ(std::string(1000, (i % 2 ? 'a' : 'A') + i % 26), Get(Key(i)));
+    }
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      count++;
+    }
+    ASSERT_EQ(100, count);
+    delete iter;
+  }
+  ASSERT_EQ(0, env_->random_read_counter_.Read());
+  env_->count_random_reads_ = false;
+}
+
+TEST(DBTest, CompactionReadahead) {
+  env_->count_random_reads_ = true;
+  int reads[2];
+  for (int readahead = 0; readahead < 2; readahead++) {
+    Options options = CurrentOptions();
+    options.env = env_;
+    options.create_if_missing = true;
+    options.compaction_readahead_size = readahead ? 1 << 20 : 0;
+    DestroyAndReopen(&options);
+
+    Random rnd(301);
+    for (int i = 0; i < 300; i++) {
+      ASSERT_OK(Put(Key(i), RandomString(&rnd, 5000)));
+    }
+    dbfull()->TEST_CompactMemTable();
+    for (int i = 0; i < 300; i += 2) {
+      ASSERT_OK(Put(Key(i), RandomString(&rnd, 5000)));
+    }
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ(2, TotalTableFiles());
+
+    env_->random_read_counter_.Reset();
+    Compact("a", "z");
+    reads[readahead] = env_->random_read_counter_.Read();
+    ASSERT_EQ(1, TotalTableFiles());
+    ASSERT_EQ(5000, Get(Key(299)).size());
+  }
+
+  // Without readahead every data block is a read of its own
+  ASSERT_GE(reads[0], 450);
+  ASSERT_LT(reads[1], reads[0] / 10);
+}
+
+TEST(DBTest, AsyncPrefetch) {
+  CopyingReadEnv env(env_);
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = &env;
+  options.block_cache = NewLRUCache(100 << 20);
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+
+  Random rnd(301);
+  for (int i = 0; i < 500; i++) {
+    ASSERT_OK(Put(Key(i), RandomString(&rnd, 5000)));
+  }
+  Compact("a", "z");
+  for (int i = 0; i < 500; i += 7) {
+    ASSERT_OK(Put(Key(i), "new"));
+  }
+  dbfull()->TEST_CompactMemTable();
+  env_->delay_data_sync_.Release_Store(env_);
+
+  ReadOptions ropts;
+  ropts.fill_cache = false;
+  std::string plain;
+  env_->random_read_counter_.Reset();
+  Iterator* iter = db_->NewIterator(ropts);
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    plain += iter->key().ToString() + iter->value().ToString();
+  }
+  ASSERT_OK(iter->status());
+  delete iter;
+  const int plain_reads = env_->random_read_counter_.Read();
+  ASSERT_EQ(0, options.block_cache->TotalCharge());
+
+  // Prefetching does not change the results, and no block is read twice
+  ropts.async_prefetch = true;
+  for (int readahead = 0; readahead < 2; readahead++) {
+    ropts.readahead_size = readahead ? 64 * 1024 : 0;
+    options.block_cache->Prune();
+    std::string prefetched;
+    env_->random_read_counter_.Reset();
+    iter = db_->NewIterator(ropts);
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      prefetched += iter->key().ToString() + iter->value().ToString();
+    }
+    ASSERT_OK(iter->status());
+    delete iter;
+    ASSERT_EQ(plain, prefetched);
+    ASSERT_LE(env_->random_read_counter_.Read(), plain_reads);
+  }
+
+  // The block after the one the iterator is positioned in is loaded into
+  // the cache in the background
+  options.block_cache->Prune();
+  iter = db_->NewIterator(ropts);
+  iter->Seek(Key(100));
+  for (int i = 0; i < 10000 && options.block_cache->TotalCharge() == 0; i++) {
+    env_->SleepForMicroseconds(1000);
+  }
+  ASSERT_GT(options.block_cache->TotalCharge(), 0);
+  delete iter;
+
+  // Iterators abandoned with a prefetch outstanding clean up after it
+  for (int i = 0; i < 100; i++) {
+    iter = db_->NewIterator(ropts);
+    iter->Seek(Key(i * 5));
+    ASSERT_TRUE(iter->Valid());
+    delete iter;
+  }
+
+  env_->delay_data_sync_.Release_Store(nullptr);
+  Close();
+  delete options.block_cache;
+}
+
+TEST(DBTest, AsyncPrefetchKeepsHotBlocks) {
+  CopyingReadEnv env(env_);
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = &env;
+  options.block_cache = NewLRUCache(1 << 20, 0.5);
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+
+  Random rnd(301);
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_OK(Put(Key(i), RandomString(&rnd, 5000)));
+  }
+  Compact("a", "z");
+
+  // Blocks read twice are promoted to the high-priority pool
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i < 1000; i += 100) {
+      Get(Key(i));
+    }
+  }
+
+  // A prefetching scan of five times the cache does not evict them
+  ReadOptions ropts;
+  ropts.async_prefetch = true;
+  Iterator* iter = db_->NewIterator(ropts);
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_OK(iter->status());
+  ASSERT_EQ(1000, count);
+  delete iter;
+
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < 1000; i += 100) {
+    Get(Key(i));
+  }
+  ASSERT_EQ(0, env_->random_read_counter_.Read());
+
+  Close();
+  delete options.block_cache;
+}
+
 // Multi-threaded test:
 namespace {
 
@@ -10,6 +10,7 @@
 #include "leveldb/db.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/slice.h"
+#include "leveldb/slice_transform.h"
 #include "leveldb/table_builder.h"
 #include "util/coding.h"
 #include "util/logging.h"
@@ -128,6 +129,24 @@ class InternalFilterPolicy : public FilterPolicy {
   virtual bool KeyMayMatch(const Slice& key, const Slice& filter) const;
 };
 
+// Prefix extractor wrapper that applies a user prefix extractor to the
+// user key portion of an internal key.  The prefix it returns keeps the
+// 8 bytes that follow the user prefix, so that InternalFilterPolicy,
+// which strips the last 8 bytes of whatever it is given, sees exactly
+// the user prefix.
+class InternalKeySliceTransform : public SliceTransform {
+ private:
+  const SliceTransform* const user_transform_;
+ public:
+  explicit InternalKeySliceTransform(const SliceTransform* t)
+      : user_transform_(t) { }
+  virtual const char* Name() const;
+  virtual Slice Transform(const Slice& key) const;
+  virtual bool InDomain(const Slice& key) const;
+
+  const SliceTransform* user_transform() const { return user_transform_; }
+};
+
 // Modules in this directory should keep internal keys wrapped inside
 // the following class instead of plain strings so that we do not
 // incorrectly use string comparisons instead of an InternalKeyComparator.
@@ -4,6 +4,7 @@
 
 #include <ctype.h>
 #include <stdio.h>
+#include <random>
 #include "db/filename.h"
 #include "db/dbformat.h"
 #include "leveldb/env.h"
@@ -69,9 +70,14 @@ std::string OldInfoLogFileName(const std::string& dbname) {
   return dbname + "/LOG.old";
 }
 
+std::string IdentityFileName(const std::string& dbname) {
+  return dbname + "/IDENTITY";
+}
+
 
 // Owned filenames have the form:
 //    dbname/CURRENT
+//    dbname/IDENTITY
 //    dbname/LOCK
 //    dbname/LOG
 //    dbname/LOG.old
@@ -84,6 +90,9 @@ bool ParseFileName(const std::string& filename,
   if (rest == "CURRENT") {
     *number = 0;
     *type = kCurrentFile;
+  } else if (rest == "IDENTITY") {
+    *number = 0;
+    *type = kIdentityFile;
   } else if (rest == "LOCK") {
     *number = 0;
     *type = kDBLockFile;
@@ -141,4 +150,47 @@ Status SetCurrentFile(Env* env, const std::string& dbname,
   return s;
 }
 
+// The identity is kIdentityLength hex digits followed by a newline.
+static const size_t kIdentityLength = 32;
+
+static bool IsIdentity(const std::string& contents) {
+  if (contents.size() != kIdentityLength + 1 ||
+      contents[kIdentityLength] != '\n') {
+    return false;
+  }
+  for (size_t i = 0; i < kIdentityLength; i++) {
+    if (!isxdigit(static_cast<unsigned char>(contents[i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Status GetOrCreateIdentity(Env* env, const std::string& dbname,
+                           std::string* identity) {
+  const std::string fname = IdentityFileName(dbname);
+  std::string contents;
+  if (ReadFileToString(env, fname, &contents).ok() && IsIdentity(contents)) {
+    identity->assign(contents.data(), kIdentityLength);
+    return Status::OK();
+  }
+
+  // Mix the time into the random bits in case random_device is a
+  // deterministic generator.
+  std::random_device rd;
+  const uint64_t now = env->NowMicros();
+  char buf[kIdentityLength + 2];
+  snprintf(buf, sizeof(buf), "%08x%08x%08x%08x\n",
+           static_cast<unsigned int>(rd() ^ (now >> 32)),
+           static_cast<unsigned int>(rd() ^ now),
+           static_cast<unsigned int>(rd()),
+           static_cast<unsigned int>(rd()));
+  Status s = WriteStringToFileSync(env, Slice(buf, kIdentityLength + 1),
+                                   fname);
+  if (s.ok()) {
+    identity->assign(buf, kIdentityLength);
+  }
+  return s;
+}
+
 }  // namespace leveldb
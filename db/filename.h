@@ -24,7 +24,8 @@ enum FileType {
   kDescriptorFile,
   kCurrentFile,
   kTempFile,
-  kInfoLogFile  // Either the current one, or an old one
+  kInfoLogFile,  // Either the current one, or an old one
+  kIdentityFile
 };
 
 // Return the name of the log file with the specified number
@@ -66,6 +67,9 @@ std::string InfoLogFileName(const std::string& dbname);
 // Return the name of the old info log file for "dbname".
 std::string OldInfoLogFileName(const std::string& dbname);
 
+// Return the name of the identity file for "dbname".
+std::string IdentityFileName(const std::string& dbname);
+
 // If filename is a leveldb file, store the type of the file in *type.
 // The number encoded in the filename is stored in *number.  If the
 // filename was successfully parsed, returns true.  Else return false.
@@ -78,6 +82,13 @@ bool ParseFileName(const std::string& filename,
 Status SetCurrentFile(Env* env, const std::string& dbname,
                       uint64_t descriptor_number);
 
+// Store in *identity the identity of the db named "dbname", which tells
+// it apart from any other db, including earlier ones of the same name.
+// It is kept in the identity file, which is created with a new random
+// identity if it is missing or unreadable.
+Status GetOrCreateIdentity(Env* env, const std::string& dbname,
+                           std::string* identity);
+
 }  // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_DB_FILENAME_H_
@@ -29,6 +29,7 @@ TEST(FileNameTest, Parse) {
     { "0.sst",              0,     kTableFile },
     { "0.ldb",              0,     kTableFile },
     { "CURRENT",            0,     kCurrentFile },
+    { "IDENTITY",           0,     kIdentityFile },
     { "LOCK",               0,     kDBLockFile },
     { "MANIFEST-2",         2,     kDescriptorFile },
     { "MANIFEST-7",         7,     kDescriptorFile },
@@ -126,6 +127,12 @@ TEST(FileNameTest, Construction) {
   ASSERT_TRUE(ParseFileName(fname.c_str() + 4, &number, &type));
   ASSERT_EQ(0, number);
   ASSERT_EQ(kInfoLogFile, type);
+
+  fname = IdentityFileName("foo");
+  ASSERT_EQ("foo/", std::string(fname.data(), 4));
+  ASSERT_TRUE(ParseFileName(fname.c_str() + 4, &number, &type));
+  ASSERT_EQ(0, number);
+  ASSERT_EQ(kIdentityFile, type);
 }
 
 }  // namespace leveldb
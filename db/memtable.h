@@ -59,6 +59,10 @@ class MemTable {
   // Else, return false.
   bool Get(const LookupKey& key, std::string* value, Status* s);
 
+  // Like Get() above, but sets *value to refer to the value held in the
+  // memtable, which stays valid for as long as the memtable is referenced.
+  bool Get(const LookupKey& key, Slice* value, Status* s);
+
  private:
   ~MemTable();  // Private since only Unref() should be used to delete it
 
@@ -7,13 +7,21 @@
 #include "db/filename.h"
 #include "leveldb/env.h"
 #include "leveldb/table.h"
+#include "leveldb/table_properties.h"
 #include "util/coding.h"
+#include "util/mutexlock.h"
 
 namespace leveldb {
 
 struct TableAndFile {
   RandomAccessFile* file;
   Table* table;
+
+  // The file is hinted for sequential access while readahead iterators
+  // over it exist, and then gets back the hint it was opened with.
+  RandomAccessFile::AccessPattern open_hint;
+  port::Mutex mu;
+  int sequential_readers;  // Guarded by mu
 };
 //DHQ: 这个是给 cache 的callback，cache 删除 entry时，执行上层提供的语义
 static void DeleteEntry(const Slice& key, void* value) {
@@ -29,21 +37,129 @@ static void UnrefEntry(void* arg1, void* arg2) {
   cache->Release(h);
 }
 
+// Hints the file of "tf" for sequential access for a new readahead
+// iterator.
+static void StartSequentialRead(TableAndFile* tf) {
+  MutexLock l(&tf->mu);
+  if (tf->sequential_readers++ == 0) {
+    tf->file->Hint(RandomAccessFile::kSequential);
+  }
+}
+
+// Like UnrefEntry(), for the cleanup of a readahead iterator: restores
+// the open-time hint of the file once no readahead iterator is left.
+static void UnrefSequentialEntry(void* arg1, void* arg2) {
+  Cache* cache = reinterpret_cast<Cache*>(arg1);
+  Cache::Handle* h = reinterpret_cast<Cache::Handle*>(arg2);
+  TableAndFile* tf = reinterpret_cast<TableAndFile*>(cache->Value(h));
+  {
+    MutexLock l(&tf->mu);
+    if (--tf->sequential_readers == 0) {
+      tf->file->Hint(tf->open_hint);
+    }
+  }
+  cache->Release(h);
+}
+
+// An options.row_cache entry holds the newest entry of a user key in a
+// table: the fixed64 tag (sequence and type) of its internal key followed
+// by its value, or an empty string if the table has no entry for the key.
+static void DeleteRow(const Slice& key, void* value) {
+  delete reinterpret_cast<std::string*>(value);
+}
+
+static void DeleteUncachedRow(void* arg1, void* arg2) {
+  delete reinterpret_cast<std::string*>(arg1);
+}
+
+// Returns an iterator that calls (*function)(arg1, arg2) when deleted.
+static Iterator* NewPin(Iterator::CleanupFunction function,
+                        void* arg1, void* arg2) {
+  Iterator* pin = NewEmptyIterator();
+  pin->RegisterCleanup(function, arg1, arg2);
+  return pin;
+}
+
+namespace {
+// Captures the entry found by a lookup of the newest entry of user_key
+struct RowSaver {
+  const Comparator* ucmp;
+  Slice user_key;
+  bool found;    // An entry for user_key was found
+  bool corrupt;  // The entry found has a malformed key
+  std::string row;
+};
+}
+
+static void SaveRow(void* arg, const Slice& ikey, const Slice& v) {
+  RowSaver* s = reinterpret_cast<RowSaver*>(arg);
+  if (ikey.size() < 8) {
+    s->corrupt = true;
+  } else if (s->ucmp->Compare(ExtractUserKey(ikey), s->user_key) == 0) {
+    s->found = true;
+    s->row.assign(ikey.data() + ikey.size() - 8, 8);
+    s->row.append(v.data(), v.size());
+  }
+}
+
+// Reports the entry in "row" to (*handle_result)(arg, ...) if there is one
+// and it is visible to a read at "snapshot".  Returns false if the read
+// has to look at older entries in the table instead.
+static bool ReplayRow(const Slice& row, const Slice& user_key,
+                      SequenceNumber snapshot, void* arg,
+                      void (*handle_result)(void*, const Slice&, const Slice&)) {
+  if (row.empty()) {
+    return true;  // The table has no entry for the key
+  }
+  const uint64_t tag = DecodeFixed64(row.data());
+  if ((tag >> 8) > snapshot) {
+    return false;
+  }
+  std::string ikey(user_key.data(), user_key.size());
+  ikey.append(row.data(), 8);
+  (*handle_result)(arg, ikey, Slice(row.data() + 8, row.size() - 8));
+  return true;
+}
+
 TableCache::TableCache(const std::string& dbname,
                        const Options& options,
                        int entries)
     : env_(options.env),
       dbname_(dbname),
       options_(options),
-      cache_(NewLRUCache(entries)) {//DHQ: 创建时，大小是 TableCacheSize(options_)
+      cache_(NewLRUCache(entries)),//DHQ: 创建时，大小是 TableCacheSize(options_)
+      row_cache_id_(options.row_cache ? options.row_cache->NewId() : 0) {
 }
 
 TableCache::~TableCache() {
   delete cache_;
 }
 
+Status TableCache::OpenTableFile(const std::string& fname,
+                                 uint64_t file_size, int level,
+                                 RandomAccessFile** file) {
+  // A file of unknown level may only be mapped if all levels may be.
+  const bool mmap_level = (level < 0)
+      ? options_.mmap_max_level >= config::kNumLevels - 1
+      : level <= options_.mmap_max_level;
+  Status s;
+  if (options_.use_direct_reads) {
+    s = env_->NewDirectRandomAccessFile(fname, file);
+  } else if (!mmap_level ||
+             (options_.mmap_max_file_size > 0 &&
+              file_size > options_.mmap_max_file_size)) {
+    s = env_->NewUnmappedRandomAccessFile(fname, file);
+  } else {
+    s = env_->NewRandomAccessFile(fname, file);
+  }
+  if (s.ok() && options_.advise_random_on_open) {
+    (*file)->Hint(RandomAccessFile::kRandom);
+  }
+  return s;
+}
+
 Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
-                             Cache::Handle** handle) {
+                             int level, Cache::Handle** handle) {
   Status s;
   char buf[sizeof(file_number)];
   EncodeFixed64(buf, file_number); //DHQ: file number，作为table cache的key
@@ -53,10 +169,10 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
     std::string fname = TableFileName(dbname_, file_number); //先尝试这种，应该是plantable格式？
     RandomAccessFile* file = nullptr;
     Table* table = nullptr;
-    s = env_->NewRandomAccessFile(fname, &file); //DHQ: 获取 file 的名字
+    s = OpenTableFile(fname, file_size, level, &file); //DHQ: 获取 file 的名字
     if (!s.ok()) {
       std::string old_fname = SSTTableFileName(dbname_, file_number);
-      if (env_->NewRandomAccessFile(old_fname, &file).ok()) {
+      if (OpenTableFile(old_fname, file_size, level, &file).ok()) {
         s = Status::OK();
       }
     }
@@ -70,32 +186,61 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
       // We do not cache error results so that if the error is transient,
       // or somebody repairs the file, we recover automatically.
     } else {
+      if (options_.persistent_cache != nullptr &&
+          !persistent_cache_identity_.empty()) {
+        std::string prefix = persistent_cache_identity_;
+        PutFixed64(&prefix, file_number);
+        table->SetPersistentCacheKeyPrefix(prefix);
+      }
+      if (level == 0 && options_.pin_l0_filter_and_index_blocks_in_cache) {
+        table->PinIndexAndFilterBlocks();
+      }
       TableAndFile* tf = new TableAndFile;
       tf->file = file; //DHQ: file名字，数字 + TableFileName 或者 SSTTableFileName
       tf->table = table;
+      tf->open_hint = options_.advise_random_on_open
+                      ? RandomAccessFile::kRandom : RandomAccessFile::kNormal;
+      tf->sequential_readers = 0;
       *handle = cache_->Insert(key, tf, 1, &DeleteEntry);
     }
   }
   return s;
 }
+Status TableCache::Preload(uint64_t file_number, uint64_t file_size,
+                           int level) {
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, level, &handle);
+  if (s.ok()) {
+    cache_->Release(handle);
+  }
+  return s;
+}
+
 //DHQ: 返回Table 的  iter，都包含了对 table的 Ref。
 Iterator* TableCache::NewIterator(const ReadOptions& options,
                                   uint64_t file_number,
                                   uint64_t file_size,
-                                  Table** tableptr) {
+                                  Table** tableptr,
+                                  int level) {
   if (tableptr != nullptr) {
     *tableptr = nullptr;
   }
 
   Cache::Handle* handle = nullptr;
-  Status s = FindTable(file_number, file_size, &handle);
+  Status s = FindTable(file_number, file_size, level, &handle);
   if (!s.ok()) {
     return NewErrorIterator(s);
   }
 
-  Table* table = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+  TableAndFile* tf = reinterpret_cast<TableAndFile*>(cache_->Value(handle));
+  Table* table = tf->table;
   Iterator* result = table->NewIterator(options);
-  result->RegisterCleanup(&UnrefEntry, cache_, handle); //DHQ: UnrefEntry 需要cache和handle两个参数，Iterator删除时，调用
+  if (options.readahead_size > 0) {
+    StartSequentialRead(tf);
+    result->RegisterCleanup(&UnrefSequentialEntry, cache_, handle);
+  } else {
+    result->RegisterCleanup(&UnrefEntry, cache_, handle); //DHQ: UnrefEntry 需要cache和handle两个参数，Iterator删除时，调用
+  }
   if (tableptr != nullptr) {
     *tableptr = table;
   }
@@ -105,14 +250,127 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
 Status TableCache::Get(const ReadOptions& options,
                        uint64_t file_number,
                        uint64_t file_size,
+                       int level,
                        const Slice& k,
                        void* arg,
-                       void (*saver)(void*, const Slice&, const Slice&)) {
+                       void (*saver)(void*, const Slice&, const Slice&),
+                       Iterator** pinned) {
+  *pinned = nullptr;
+  Cache* row_cache = options_.row_cache;
+  if (row_cache == nullptr) {
+    return GetFromTable(options, file_number, file_size, level, k,
+                        arg, saver, pinned);
+  }
+
+  const Slice user_key = ExtractUserKey(k);
+  const SequenceNumber snapshot = DecodeFixed64(k.data() + k.size() - 8) >> 8;
+  std::string row_key;
+  PutFixed64(&row_key, row_cache_id_);
+  PutFixed64(&row_key, file_number);
+  row_key.append(user_key.data(), user_key.size());
+
+  Cache::Handle* handle = row_cache->Lookup(row_key);
+  if (handle != nullptr) {
+    const std::string* row =
+        reinterpret_cast<std::string*>(row_cache->Value(handle));
+    if (ReplayRow(*row, user_key, snapshot, arg, saver)) {
+      *pinned = NewPin(&UnrefEntry, row_cache, handle);
+      return Status::OK();
+    }
+    row_cache->Release(handle);
+    // Only older entries are visible to the snapshot
+    return GetFromTable(options, file_number, file_size, level, k,
+                        arg, saver, pinned);
+  }
+
+  // Look up the newest entry of the key, which is valid for every read
+  // whose snapshot can see it.  options_ are sanitized, so the comparator
+  // of the table is the internal key comparator.
+  RowSaver row_saver;
+  row_saver.ucmp = reinterpret_cast<const InternalKeyComparator*>(
+      options_.comparator)->user_comparator();
+  row_saver.user_key = user_key;
+  row_saver.found = false;
+  row_saver.corrupt = false;
+  InternalKey newest(user_key, kMaxSequenceNumber, kValueTypeForSeek);
+  Status s = GetFromTable(options, file_number, file_size, level,
+                          newest.Encode(), &row_saver, &SaveRow, nullptr);
+  if (!s.ok() || row_saver.corrupt) {
+    // Let the ordinary lookup report the problem
+    return GetFromTable(options, file_number, file_size, level, k,
+                        arg, saver, pinned);
+  }
+  std::string* row = new std::string;
+  row->swap(row_saver.row);
+  handle = nullptr;
+  if (options.fill_cache) {
+    const size_t charge = row_key.size() + row->size();
+    handle = row_cache->Insert(row_key, row, charge, &DeleteRow);
+  }
+  if (ReplayRow(*row, user_key, snapshot, arg, saver)) {
+    *pinned = (handle != nullptr ? NewPin(&UnrefEntry, row_cache, handle)
+                                 : NewPin(&DeleteUncachedRow, row, nullptr));
+    return Status::OK();
+  }
+  if (handle != nullptr) {
+    row_cache->Release(handle);
+  } else {
+    delete row;
+  }
+  return GetFromTable(options, file_number, file_size, level, k,
+                      arg, saver, pinned);
+}
+
+Status TableCache::GetFromTable(const ReadOptions& options,
+                                uint64_t file_number,
+                                uint64_t file_size,
+                                int level,
+                                const Slice& k,
+                                void* arg,
+                                void (*saver)(void*, const Slice&,
+                                              const Slice&),
+                                Iterator** pinned) {
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, level, &handle);
+  if (s.ok()) {
+    Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+    s = t->InternalGet(options, k, arg, saver, pinned);//DHQ: InternalGet不保证一定match，外面会在 SaveValue 里面判断。
+    if (pinned != nullptr && *pinned != nullptr) {
+      // The value may live in the file's memory-mapped contents
+      (*pinned)->RegisterCleanup(&UnrefEntry, cache_, handle);
+    } else {
+      cache_->Release(handle);
+    }
+  }
+  return s;
+}
+
+bool TableCache::PrefixMayMatch(uint64_t file_number,
+                                uint64_t file_size,
+                                int level,
+                                const Slice& k) {
   Cache::Handle* handle = nullptr;
-  Status s = FindTable(file_number, file_size, &handle);
+  if (!FindTable(file_number, file_size, level, &handle).ok()) {
+    return true;  // Let the iterator over the file report the error
+  }
+  Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+  bool result = t->PrefixMayMatch(k, nullptr);
+  cache_->Release(handle);
+  return result;
+}
+
+Status TableCache::GetProperties(uint64_t file_number, uint64_t file_size,
+                                 int level, TableProperties* props) {
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, level, &handle);
   if (s.ok()) {
     Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
-    s = t->InternalGet(options, k, arg, saver);//DHQ: InternalGet不保证一定match，外面会在 SaveValue 里面判断。
+    const TableProperties* p = t->properties();
+    if (p != nullptr) {
+      *props = *p;
+    } else {
+      s = Status::NotFound("table has no properties");
+    }
     cache_->Release(handle);
   }
   return s;
@@ -121,7 +379,21 @@ Status TableCache::Get(const ReadOptions& options,
 void TableCache::Evict(uint64_t file_number) {
   char buf[sizeof(file_number)];
   EncodeFixed64(buf, file_number);
-  cache_->Erase(Slice(buf, sizeof(buf)));
+  Slice key(buf, sizeof(buf));
+  Cache::Handle* handle = cache_->Lookup(key);
+  if (handle != nullptr) {
+    // The file is being deleted: release its pages in the OS page cache
+    // now instead of letting them compete with live tables until it is
+    // finally closed.
+    TableAndFile* tf = reinterpret_cast<TableAndFile*>(cache_->Value(handle));
+    tf->file->Hint(RandomAccessFile::kDontNeed);
+    cache_->Release(handle);
+  }
+  cache_->Erase(key);
+}
+
+void TableCache::SetPersistentCacheIdentity(const std::string& identity) {
+  persistent_cache_identity_ = identity;
 }
 
 }  // namespace leveldb
@@ -30,30 +30,78 @@ class TableCache {
   // underlies the returned iterator.  The returned "*tableptr" object is owned
   // by the cache and should not be deleted, and is valid for as long as the
   // returned iterator is live.
+  //
+  // "level" is the level the file belongs to, or -1 if unknown.  It is
+  // only used as a hint when the table has to be opened.
   Iterator* NewIterator(const ReadOptions& options,
                         uint64_t file_number,
                         uint64_t file_size,
-                        Table** tableptr = nullptr);
+                        Table** tableptr = nullptr,
+                        int level = -1);
 
   // If a seek to internal key "k" in specified file finds an entry,
-  // call (*handle_result)(arg, found_key, found_value).
+  // call (*handle_result)(arg, found_key, found_value).  The entry may be
+  // served from options.row_cache, in which case it is only reported if
+  // it has the user key of "k".  If an entry is reported, *pinned is set
+  // to an iterator that keeps the memory of found_value alive until it
+  // is deleted, and otherwise to nullptr.
   Status Get(const ReadOptions& options,
              uint64_t file_number,
              uint64_t file_size,
+             int level,
              const Slice& k,
              void* arg,
-             void (*handle_result)(void*, const Slice&, const Slice&));
+             void (*handle_result)(void*, const Slice&, const Slice&),
+             Iterator** pinned);
 
-  // Evict any entry for the specified file number
+  // Returns false if the filters of the specified file show that it holds
+  // no key with the prefix of internal key "k" (see
+  // Options::prefix_extractor).  "level" is the same hint as for
+  // NewIterator().
+  bool PrefixMayMatch(uint64_t file_number,
+                      uint64_t file_size,
+                      int level,
+                      const Slice& k);
+
+  // Set *props to the properties stored in the specified file.  Returns
+  // NotFound if it has none.  "level" is the same hint as for NewIterator().
+  Status GetProperties(uint64_t file_number, uint64_t file_size, int level,
+                       TableProperties* props);
+
+  // Open the specified file, unless it is already open, and keep it in
+  // the cache.  "level" is the same hint as for NewIterator().
+  Status Preload(uint64_t file_number, uint64_t file_size, int level);
+
+  // Evict any entry for the specified file number, which is about to be
+  // deleted.  Its data is also dropped from the OS page cache.
   void Evict(uint64_t file_number);
 
+  // Let the tables use options.persistent_cache, under keys that start
+  // with "identity" (see GetOrCreateIdentity()).  Tables do not use it
+  // until this is called.
+  // REQUIRES: no table has been opened yet.
+  void SetPersistentCacheIdentity(const std::string& identity);
+
  private:
   Env* const env_;
   const std::string dbname_;
   const Options& options_;
   Cache* cache_;
+  const uint64_t row_cache_id_;  // Prefix of our keys in options_.row_cache
+  std::string persistent_cache_identity_;  // Empty if not set
 
-  Status FindTable(uint64_t file_number, uint64_t file_size, Cache::Handle**);
+  Status OpenTableFile(const std::string& fname, uint64_t file_size,
+                       int level, RandomAccessFile** file);
+  Status FindTable(uint64_t file_number, uint64_t file_size, int level,
+                   Cache::Handle**);
+  Status GetFromTable(const ReadOptions& options,
+                      uint64_t file_number,
+                      uint64_t file_size,
+                      int level,
+                      const Slice& k,
+                      void* arg,
+                      void (*handle_result)(void*, const Slice&, const Slice&),
+                      Iterator** pinned);
 };
 
 }  // namespace leveldb
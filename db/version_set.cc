@@ -104,6 +104,86 @@ int FindFile(const InternalKeyComparator& icmp,
   return right;
 }
 
+// Return the eight bytes of "user_key" that follow its first "skip"
+// bytes, zero padded, as a big-endian number.
+static uint64_t Fence(const Slice& user_key, size_t skip) {
+  uint64_t result = 0;
+  for (size_t i = skip; i < skip + 8; i++) {
+    result <<= 8;
+    if (i < user_key.size()) {
+      result |= static_cast<uint8_t>(user_key[i]);
+    }
+  }
+  return result;
+}
+
+void BuildFences(const std::vector<FileMetaData*>& files,
+                 LevelFences* result) {
+  result->shared_prefix.clear();
+  result->fences.resize(files.size());
+  if (files.empty()) {
+    return;
+  }
+
+  // The files are sorted, so the prefix shared by the first and last
+  // largest keys is shared by all of them.
+  const Slice first = files.front()->largest.user_key();
+  const Slice last = files.back()->largest.user_key();
+  size_t shared = 0;
+  while (shared < first.size() && shared < last.size() &&
+         first[shared] == last[shared]) {
+    shared++;
+  }
+  result->shared_prefix.assign(first.data(), shared);
+  for (size_t i = 0; i < files.size(); i++) {
+    result->fences[i] = Fence(files[i]->largest.user_key(), shared);
+  }
+}
+
+int FindFileWithFences(const InternalKeyComparator& icmp,
+                       const std::vector<FileMetaData*>& files,
+                       const LevelFences& fences,
+                       const Slice& key) {
+  assert(fences.fences.size() == files.size());
+  const Slice user_key = ExtractUserKey(key);
+  const Slice& shared = fences.shared_prefix;
+  const size_t n = std::min(user_key.size(), shared.size());
+  const int r = memcmp(user_key.data(), shared.data(), n);
+  if (r < 0 || (r == 0 && user_key.size() < shared.size())) {
+    return 0;  // Before the largest key of every file
+  } else if (r > 0) {
+    return files.size();  // After the largest key of every file
+  }
+
+  // Files whose fence is below that of "key" end before its user key,
+  // and files whose fence is above it end after it.  Only files with an
+  // equal fence need their largest key compared.
+  const uint64_t fence = Fence(user_key, shared.size());
+  std::pair<std::vector<uint64_t>::const_iterator,
+            std::vector<uint64_t>::const_iterator> range =
+      std::equal_range(fences.fences.begin(), fences.fences.end(), fence);
+  uint32_t left = range.first - fences.fences.begin();
+  uint32_t right = range.second - fences.fences.begin();
+  while (left < right) {
+    uint32_t mid = (left + right) / 2;
+    if (icmp.InternalKeyComparator::Compare(files[mid]->largest.Encode(),
+                                            key) < 0) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  return right;
+}
+
+int Version::FindFileInLevel(int level, const Slice& key) const {
+  if (!fences_[level].fences.empty()) {
+    return FindFileWithFences(vset_->icmp_, files_[level], fences_[level],
+                              key);
+  }
+  return FindFile(vset_->icmp_, files_[level], key);
+}
+
 static bool AfterFile(const Comparator* ucmp,
                       const Slice* user_key, const FileMetaData* f) {
   // null user_key occurs before all keys and is therefore never after *f
@@ -160,23 +240,47 @@ bool SomeFileOverlapsRange(
 // is the largest key that occurs in the file, and value() is an
 // 16-byte value containing the file number and file size, both
 // encoded using EncodeFixed64.
+//
+// Non-null "lower_bound" and "upper_bound" (internal keys) hide the files
+// that lie entirely before *lower_bound or at or after *upper_bound.
 class Version::LevelFileNumIterator : public Iterator {
  public:
   LevelFileNumIterator(const InternalKeyComparator& icmp,
-                       const std::vector<FileMetaData*>* flist)
+                       const std::vector<FileMetaData*>* flist,
+                       const Slice* lower_bound = nullptr,
+                       const Slice* upper_bound = nullptr)
       : icmp_(icmp),
         flist_(flist),
-        index_(flist->size()) {        // Marks as invalid
+        begin_(0),
+        end_(flist->size()) {
+    if (lower_bound != nullptr) {
+      begin_ = FindFile(icmp_, *flist_, *lower_bound);
+    }
+    if (upper_bound != nullptr) {
+      end_ = FindFile(icmp_, *flist_, *upper_bound);
+      if (end_ < flist_->size() &&
+          icmp_.Compare((*flist_)[end_]->smallest.Encode(),
+                        *upper_bound) < 0) {
+        end_++;  // The file straddles the bound
+      }
+    }
+    if (end_ < begin_) end_ = begin_;
+    index_ = end_;                  // Marks as invalid
   }
   virtual bool Valid() const {
-    return index_ < flist_->size();
+    return index_ < end_;
   }
   virtual void Seek(const Slice& target) {
     index_ = FindFile(icmp_, *flist_, target);
+    if (index_ < begin_) {
+      index_ = begin_;
+    } else if (index_ > end_) {
+      index_ = end_;
+    }
   }
-  virtual void SeekToFirst() { index_ = 0; }
+  virtual void SeekToFirst() { index_ = begin_; }
   virtual void SeekToLast() {
-    index_ = flist_->empty() ? 0 : flist_->size() - 1;
+    index_ = (begin_ == end_) ? end_ : end_ - 1;
   }
   virtual void Next() {
     assert(Valid());
@@ -184,8 +288,8 @@ class Version::LevelFileNumIterator : public Iterator {
   }
   virtual void Prev() {
     assert(Valid());
-    if (index_ == 0) {
-      index_ = flist_->size();  // Marks as invalid
+    if (index_ == begin_) {
+      index_ = end_;  // Marks as invalid
     } else {
       index_--;
     }
@@ -204,50 +308,91 @@ class Version::LevelFileNumIterator : public Iterator {
  private:
   const InternalKeyComparator icmp_;
   const std::vector<FileMetaData*>* const flist_;
+  uint32_t begin_;  // Index of the first visible file
+  uint32_t end_;    // One past the index of the last visible file
   uint32_t index_;
 
   // Backing store for value().  Holds the file number and size.
   mutable char value_buf_[16];
 };
 
+namespace {
+
+// Argument of GetFileIterator() and FilePrefixMayMatch(): the table cache
+// and the level of the files, which decides how they are opened.
+struct FileIteratorArg {
+  TableCache* cache;
+  int level;
+};
+
+}  // namespace
+
+static void DeleteFileIteratorArg(void* arg, void* ignored) {
+  delete reinterpret_cast<FileIteratorArg*>(arg);
+}
+
 static Iterator* GetFileIterator(void* arg,
                                  const ReadOptions& options,
                                  const Slice& file_value) {
-  TableCache* cache = reinterpret_cast<TableCache*>(arg);
+  FileIteratorArg* file_arg = reinterpret_cast<FileIteratorArg*>(arg);
   if (file_value.size() != 16) {
     return NewErrorIterator(
         Status::Corruption("FileReader invoked with unexpected value"));
   } else {
-    return cache->NewIterator(options,
-                              DecodeFixed64(file_value.data()),
-                              DecodeFixed64(file_value.data() + 8));
+    return file_arg->cache->NewIterator(options,
+                                        DecodeFixed64(file_value.data()),
+                                        DecodeFixed64(file_value.data() + 8),
+                                        nullptr, file_arg->level);
   }
 }
 
-Iterator* Version::NewConcatenatingIterator(const ReadOptions& options,
-                                            int level) const {
-  return NewTwoLevelIterator(
-      new LevelFileNumIterator(vset_->icmp_, &files_[level]),
-      &GetFileIterator, vset_->table_cache_, options);
+static bool FilePrefixMayMatch(void* arg,
+                               const Slice& target,
+                               const Slice& file_value) {
+  FileIteratorArg* file_arg = reinterpret_cast<FileIteratorArg*>(arg);
+  if (file_value.size() != 16) {
+    return true;  // GetFileIterator() reports the corruption
+  }
+  return file_arg->cache->PrefixMayMatch(DecodeFixed64(file_value.data()),
+                                         DecodeFixed64(file_value.data() + 8),
+                                         file_arg->level, target);
 }
 
-void Version::AddIterators(const ReadOptions& options,
-                           std::vector<Iterator*>* iters) {
-  // Merge all level zero files together since they may overlap
-  for (size_t i = 0; i < files_[0].size(); i++) {
-    iters->push_back(
-        vset_->table_cache_->NewIterator(
-            options, files_[0][i]->number, files_[0][i]->file_size));
-  }
+// Returns an iterator over the files of "level" listed by "file_iter".
+static Iterator* NewFileIterator(Iterator* file_iter, TableCache* cache,
+                                 int level, const ReadOptions& options,
+                                 bool prefix_filtered) {
+  FileIteratorArg* arg = new FileIteratorArg;
+  arg->cache = cache;
+  arg->level = level;
+  Iterator* result = NewTwoLevelIterator(
+      file_iter, &GetFileIterator, arg, options,
+      prefix_filtered ? &FilePrefixMayMatch : nullptr);
+  result->RegisterCleanup(&DeleteFileIteratorArg, arg, nullptr);
+  return result;
+}
 
-  // For levels > 0, we can use a concatenating iterator that sequentially
-  // walks through the non-overlapping files in the level, opening them
-  // lazily.
-  for (int level = 1; level < config::kNumLevels; level++) {
-    if (!files_[level].empty()) {
-      iters->push_back(NewConcatenatingIterator(options, level));
-    }
-  }
+Iterator* Version::NewLevel0Iterator(const ReadOptions& options,
+                                     const FileMetaData* f) const {
+  const InternalKeyComparator& icmp = vset_->icmp_;
+  if ((options.iterate_lower_bound != nullptr &&
+       icmp.Compare(f->largest.Encode(), *options.iterate_lower_bound) < 0) ||
+      (options.iterate_upper_bound != nullptr &&
+       icmp.Compare(f->smallest.Encode(), *options.iterate_upper_bound) >= 0)) {
+    return nullptr;  // No key of the file is within the bounds
+  }
+  return vset_->table_cache_->NewIterator(options, f->number, f->file_size,
+                                          nullptr, 0);
+}
+
+Iterator* Version::NewConcatenatingIterator(const ReadOptions& options,
+                                            int level) const {
+  return NewFileIterator(
+      new LevelFileNumIterator(vset_->icmp_, &files_[level],
+                               options.iterate_lower_bound,
+                               options.iterate_upper_bound),
+      vset_->table_cache_, level, options,
+      vset_->options_->prefix_extractor != nullptr);
 }
 
 // Callback from TableCache::Get()
@@ -262,7 +407,7 @@ struct Saver {
   SaverState state;
   const Comparator* ucmp;
   Slice user_key;
-  std::string* value;
+  Slice value;  // Refers to memory pinned by TableCache::Get()
 };
 }
 static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
@@ -274,12 +419,16 @@ static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
     if (s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0) {
       s->state = (parsed_key.type == kTypeValue) ? kFound : kDeleted;
       if (s->state == kFound) {
-        s->value->assign(v.data(), v.size());
+        s->value = v;
       }
     }
   }
 }
 
+static void DeletePinnedIterator(void* arg1, void* arg2) {
+  delete reinterpret_cast<Iterator*>(arg1);
+}
+
 static bool NewestFirst(FileMetaData* a, FileMetaData* b) {
   return a->number > b->number;
 }
@@ -315,7 +464,7 @@ void Version::ForEachOverlapping(Slice user_key, Slice internal_key,
     if (num_files == 0) continue;
 
     // Binary search to find earliest index whose largest key >= internal_key.
-    uint32_t index = FindFile(vset_->icmp_, files_[level], internal_key);
+    uint32_t index = FindFileInLevel(level, internal_key);
     if (index < num_files) {
       FileMetaData* f = files_[level][index];
       if (ucmp->Compare(user_key, f->smallest.user_key()) < 0) {
@@ -331,7 +480,7 @@ void Version::ForEachOverlapping(Slice user_key, Slice internal_key,
 
 Status Version::Get(const ReadOptions& options,
                     const LookupKey& k,
-                    std::string* value,
+                    PinnableSlice* value,
                     GetStats* stats) {
   Slice ikey = k.internal_key();
   Slice user_key = k.user_key();
@@ -372,7 +521,7 @@ Status Version::Get(const ReadOptions& options,
       num_files = tmp.size();
     } else {
       // Binary search to find earliest index whose largest key >= ikey.
-      uint32_t index = FindFile(vset_->icmp_, files_[level], ikey);
+      uint32_t index = FindFileInLevel(level, ikey);
       if (index >= num_files) {
         files = nullptr;
         num_files = 0;
@@ -404,9 +553,15 @@ Status Version::Get(const ReadOptions& options,
       saver.state = kNotFound;
       saver.ucmp = ucmp;
       saver.user_key = user_key;
-      saver.value = value; //TableCache::Get，利用seek，返回的可能是 >= key的。不一定正好match
-      s = vset_->table_cache_->Get(options, f->number, f->file_size,
-                                   ikey, &saver, SaveValue);
+      //TableCache::Get，利用seek，返回的可能是 >= key的。不一定正好match
+      Iterator* pin = nullptr;
+      s = vset_->table_cache_->Get(options, f->number, f->file_size, level,
+                                   ikey, &saver, SaveValue, &pin);
+      if (s.ok() && saver.state == kFound) {
+        value->PinSlice(saver.value, &DeletePinnedIterator, pin, nullptr);
+      } else {
+        delete pin;
+      }
       if (!s.ok()) {
         return s;
       }
@@ -739,6 +894,12 @@ class VersionSet::Builder {
         MaybeAddFile(v, level, *base_iter);
       }
 
+      if (added->empty() && levels_[level].deleted_files.empty()) {
+        v->level_tags_[level] = base_->level_tags_[level];
+      } else {
+        v->level_tags_[level] = ++vset_->last_level_tag_;
+      }
+
 #ifndef NDEBUG
       // Make sure there is no overlap in levels > 0
       if (level > 0) {
@@ -787,6 +948,7 @@ VersionSet::VersionSet(const std::string& dbname,
       last_sequence_(0),
       log_number_(0),
       prev_log_number_(0),
+      last_level_tag_(0),
       descriptor_file_(nullptr),
       descriptor_log_(nullptr),
       dummy_versions_(this),
@@ -1067,6 +1229,12 @@ void VersionSet::MarkFileNumberUsed(uint64_t number) {
 }
 //DHQ: 计算 version的 compaction_score_ 和 compaction_level_
 void VersionSet::Finalize(Version* v) {
+  if (icmp_.user_comparator() == BytewiseComparator()) {
+    for (int level = 1; level < config::kNumLevels; level++) {
+      BuildFences(v->files_[level], &v->fences_[level]);
+    }
+  }
+
   // Precomputed best level for next compaction
   int best_level = -1;
   double best_score = -1;
@@ -1176,7 +1344,8 @@ uint64_t VersionSet::ApproximateOffsetOf(Version* v, const InternalKey& ikey) {
         // approximate offset of "ikey" within the table.
         Table* tableptr;
         Iterator* iter = table_cache_->NewIterator(
-            ReadOptions(), files[i]->number, files[i]->file_size, &tableptr);
+            ReadOptions(), files[i]->number, files[i]->file_size, &tableptr,
+            level);
         if (tableptr != nullptr) {
           result += tableptr->ApproximateOffsetOf(ikey.Encode());
         }
@@ -1264,6 +1433,7 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
   ReadOptions options;
   options.verify_checksums = options_->paranoid_checks;
   options.fill_cache = false;
+  options.readahead_size = options_->compaction_readahead_size;
 
   // Level-0 files have to be merged together.  For other levels,
   // we will make a concatenating iterator per level.
@@ -1277,13 +1447,13 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
         const std::vector<FileMetaData*>& files = c->inputs_[which];
         for (size_t i = 0; i < files.size(); i++) {
           list[num++] = table_cache_->NewIterator(//DHQ: level-0, 每个file，一个Iterator
-              options, files[i]->number, files[i]->file_size);
+              options, files[i]->number, files[i]->file_size, nullptr, 0);
         }
       } else {
         // Create concatenating iterator for the files from this level
-        list[num++] = NewTwoLevelIterator(  //DHQ: 非 level-0，一个level一个iter即可，因为file间不重合
+        list[num++] = NewFileIterator(  //DHQ: 非 level-0，一个level一个iter即可，因为file间不重合
             new Version::LevelFileNumIterator(icmp_, &c->inputs_[which]), //DHQ: Two level是因为 file内部有 index和data
-            &GetFileIterator, table_cache_, options);
+            table_cache_, c->level() + which, options, false);
       }
     }
   }
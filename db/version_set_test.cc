@@ -32,10 +32,16 @@ class FindFileTest {
     files_.push_back(f);
   }
 
-  int Find(const char* key) {
-    InternalKey target(key, 100, kTypeValue);
+  int Find(const char* key, SequenceNumber seq = 100) {
+    InternalKey target(key, seq, kTypeValue);
     InternalKeyComparator cmp(BytewiseComparator());
-    return FindFile(cmp, files_, target.Encode());
+    const int index = FindFile(cmp, files_, target.Encode());
+
+    // Searching the fences gives the same file.
+    LevelFences fences;
+    BuildFences(files_, &fences);
+    ASSERT_EQ(index, FindFileWithFences(cmp, files_, fences, target.Encode()));
+    return index;
   }
 
   bool Overlaps(const char* smallest, const char* largest) {
@@ -125,6 +131,29 @@ TEST(FindFileTest, Multiple) {
   ASSERT_TRUE(Overlaps("450", "500"));
 }
 
+TEST(FindFileTest, SharedPrefixes) {
+  // Largest keys that only differ after the fence prefix, or that are
+  // shorter than it, need their full keys compared.
+  Add("a", "abcdefgh");
+  Add("abcdefgh\x01", "abcdefgh1");
+  Add("abcdefgh2", "abcdefgh2", 200, 100);
+  Add("abcdefgh3", "abcdefghij");
+  Add("abcdefghk", "abd");
+  ASSERT_EQ(0, Find("a"));
+  ASSERT_EQ(0, Find("abcdefg"));
+  ASSERT_EQ(0, Find("abcdefgh"));
+  ASSERT_EQ(1, Find("abcdefgh\x01"));
+  ASSERT_EQ(1, Find("abcdefgh1"));
+  ASSERT_EQ(2, Find("abcdefgh10"));
+  ASSERT_EQ(2, Find("abcdefgh2", 150));
+  ASSERT_EQ(3, Find("abcdefgh2", 50));
+  ASSERT_EQ(3, Find("abcdefghi"));
+  ASSERT_EQ(4, Find("abcdefghj"));
+  ASSERT_EQ(4, Find("abd"));
+  ASSERT_EQ(5, Find("abda"));
+  ASSERT_EQ(5, Find("b"));
+}
+
 TEST(FindFileTest, MultipleNullBoundaries) {
   Add("150", "200");
   Add("200", "250");
@@ -60,6 +60,7 @@ typedef struct leveldb_filterpolicy_t  leveldb_filterpolicy_t;
 typedef struct leveldb_iterator_t      leveldb_iterator_t;
 typedef struct leveldb_logger_t        leveldb_logger_t;
 typedef struct leveldb_options_t       leveldb_options_t;
+typedef struct leveldb_pinnableslice_t leveldb_pinnableslice_t;
 typedef struct leveldb_randomfile_t    leveldb_randomfile_t;
 typedef struct leveldb_readoptions_t   leveldb_readoptions_t;
 typedef struct leveldb_seqfile_t       leveldb_seqfile_t;
@@ -96,6 +97,15 @@ LEVELDB_EXPORT char* leveldb_get(leveldb_t* db,
                                  const char* key, size_t keylen, size_t* vallen,
                                  char** errptr);
 
+/* Like leveldb_get(), but the value is not copied.  Returns NULL if not
+   found.  Otherwise the value is available through
+   leveldb_pinnableslice_value() until the result is passed to
+   leveldb_pinnableslice_destroy(), which must be done before the db is
+   closed. */
+LEVELDB_EXPORT leveldb_pinnableslice_t* leveldb_get_pinned(
+    leveldb_t* db, const leveldb_readoptions_t* options, const char* key,
+    size_t keylen, char** errptr);
+
 LEVELDB_EXPORT leveldb_iterator_t* leveldb_create_iterator(
     leveldb_t* db, const leveldb_readoptions_t* options);
 
@@ -119,6 +129,14 @@ LEVELDB_EXPORT void leveldb_compact_range(leveldb_t* db, const char* start_key,
                                           const char* limit_key,
                                           size_t limit_key_len);
 
+/* Pinned values */
+
+LEVELDB_EXPORT const char* leveldb_pinnableslice_value(
+    const leveldb_pinnableslice_t* slice, size_t* vallen);
+
+LEVELDB_EXPORT void leveldb_pinnableslice_destroy(
+    leveldb_pinnableslice_t* slice);
+
 /* Management operations */
 
 LEVELDB_EXPORT void leveldb_destroy_db(const leveldb_options_t* options,
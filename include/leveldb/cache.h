@@ -27,9 +27,28 @@ namespace leveldb {
 class LEVELDB_EXPORT Cache;
 
 // Create a new cache with a fixed size capacity.  This implementation
-// of Cache uses a least-recently-used eviction policy.
+// of Cache uses a least-recently-used eviction policy.  Same as
+// NewLRUCache(capacity, 0.5).
 LEVELDB_EXPORT Cache* NewLRUCache(size_t capacity);
 
+// Create a new least-recently-used cache that reserves up to
+// "high_pri_pool_ratio" of "capacity" for a high-priority pool.  Entries
+// enter that pool when inserted with kHighPriority or when looked up
+// again while cached; all other entries are inserted in the middle of the
+// LRU order, after the pool, and are evicted first.  A scan that touches
+// each block once therefore cannot evict the blocks that were used more
+// than once.  A ratio of 0 gives a plain LRU cache.
+// REQUIRES: 0 <= high_pri_pool_ratio <= 1
+LEVELDB_EXPORT Cache* NewLRUCache(size_t capacity, double high_pri_pool_ratio);
+
+// Create a new cache with a fixed size capacity.  This implementation
+// of Cache uses the CLOCK eviction policy, an approximation of LRU in
+// which Lookup() and Release() of cached entries do not take locks.  It
+// scales better than NewLRUCache() when many threads hit the same
+// entries.  Entries inserted with kHighPriority survive one more sweep
+// of the clock than other entries.
+LEVELDB_EXPORT Cache* NewClockCache(size_t capacity);
+
 class LEVELDB_EXPORT Cache {
  public:
   Cache() = default;
@@ -44,6 +63,17 @@ class LEVELDB_EXPORT Cache {
   // Opaque handle to an entry stored in the cache.
   struct Handle { };
 
+  // Eviction priority of an entry.  Entries inserted with kHighPriority
+  // are evicted after kLowPriority ones, as long as they fit in the
+  // cache's high-priority pool (see NewLRUCache).  kPrefetched is
+  // kLowPriority for an entry inserted ahead of its first use, e.g. a
+  // prefetched block: its first Lookup() is that use, not a reuse.
+  enum Priority {
+    kLowPriority,
+    kHighPriority,
+    kPrefetched
+  };
+
   // Insert a mapping from key->value into the cache and assign it
   // the specified charge against the total cache capacity.
   //
@@ -56,6 +86,13 @@ class LEVELDB_EXPORT Cache {
   virtual Handle* Insert(const Slice& key, void* value, size_t charge,
                          void (*deleter)(const Slice& key, void* value)) = 0;
 
+  // Like Insert() above, but with an eviction priority hint.  Caches
+  // that do not support priorities may ignore the hint; the default
+  // implementation does exactly that.
+  virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+                         void (*deleter)(const Slice& key, void* value),
+                         Priority priority);
+
   // If the cache has no mapping for "key", returns nullptr.
   //
   // Else return a handle that corresponds to the mapping.  The caller
@@ -10,6 +10,8 @@
 #include "leveldb/export.h"
 #include "leveldb/iterator.h"
 #include "leveldb/options.h"
+#include "leveldb/pinnable_slice.h"
+#include "leveldb/table_properties.h"
 
 namespace leveldb {
 
@@ -88,6 +90,17 @@ class LEVELDB_EXPORT DB {
   virtual Status Get(const ReadOptions& options,
                      const Slice& key, std::string* value) = 0;
 
+  // Like Get() above, but if the database contains an entry for "key",
+  // *value may refer to the value where it is held in the memtable or
+  // the block cache instead of to a copy of it.  That memory stays
+  // pinned until *value is reset or destroyed, which must happen before
+  // this db is deleted.  If there is no entry for "key", *value is left
+  // empty.
+  //
+  // The default implementation copies the value.
+  virtual Status Get(const ReadOptions& options,
+                     const Slice& key, PinnableSlice* value);
+
   // Return a heap-allocated iterator over the contents of the database.
   // The result of NewIterator() is initially invalid (caller must
   // call one of the Seek methods on the iterator before using it).
@@ -96,6 +109,31 @@ class LEVELDB_EXPORT DB {
   // The returned iterator should be deleted before this db is deleted.
   virtual Iterator* NewIterator(const ReadOptions& options) = 0;
 
+  // Called by ParallelScan() with each entry of shard "shard".  Returning
+  // false stops the scan of that shard.
+  using ScanFunction = bool (*)(void* arg, int shard, const Slice& key,
+                                const Slice& value);
+
+  // Call (*function)(arg, shard, key, value) for every entry with a key
+  // in [*begin,*end), as of a single snapshot.  The range is split at
+  // table file boundaries into at most "n_shards" shards of about the same
+  // size (see GetApproximateSizes()), which are scanned in parallel.  Shard
+  // numbers are in [0,n_shards-1] and every key of a shard is less than
+  // the keys of the shards after it.  The calls for one shard are made in
+  // key order from a single thread, but calls for different shards are
+  // made concurrently.  Returns the first error hit by any shard.
+  //
+  // begin==nullptr is treated as a key before all keys in the database,
+  // and end==nullptr as a key after all keys in the database.  If
+  // options.snapshot is null, a snapshot of the current state is used.
+  // options.iterate_lower_bound and iterate_upper_bound are ignored.
+  //
+  // The default implementation scans the range as a single shard on the
+  // calling thread.
+  virtual Status ParallelScan(const ReadOptions& options,
+                              const Slice* begin, const Slice* end,
+                              int n_shards, ScanFunction function, void* arg);
+
   // Return a handle to the current DB state.  Iterators created with
   // this handle will all observe a stable snapshot of the current DB
   // state.  The caller must call ReleaseSnapshot(result) when the
@@ -135,6 +173,13 @@ class LEVELDB_EXPORT DB {
   virtual void GetApproximateSizes(const Range* range, int n,
                                    uint64_t* sizes) = 0;
 
+  // Set *props to the properties (see TableProperties) of every table
+  // file of the current DB state that stores them, keyed by file name.
+  // Tables written by older versions are left out.
+  //
+  // The default implementation returns NotSupported.
+  virtual Status GetPropertiesOfAllTables(TablePropertiesCollection* props);
+
   // Compact the underlying storage for the key range [*begin,*end].
   // In particular, deleted and overwritten versions are discarded,
   // and the data is rearranged to reduce the cost of operations
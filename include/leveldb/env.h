@@ -66,6 +66,21 @@ class LEVELDB_EXPORT Env {
   virtual Status NewRandomAccessFile(const std::string& fname,
                                      RandomAccessFile** result) = 0;
 
+  // Like NewRandomAccessFile(), but the returned file is never
+  // memory-mapped: reads copy the data into the caller's buffer.
+  //
+  // The default implementation calls NewRandomAccessFile().
+  virtual Status NewUnmappedRandomAccessFile(const std::string& fname,
+                                             RandomAccessFile** result);
+
+  // Set the maximum number of files that NewRandomAccessFile() may keep
+  // memory-mapped at the same time.  Files opened once that many are
+  // mapped are read with ordinary reads instead.  Lowering the limit does
+  // not unmap files that are already mapped.
+  //
+  // The default implementation does nothing.
+  virtual void SetMaxMappedFiles(int n);
+
   // Create an object that writes to a new file with the specified
   // name.  Deletes any existing file with the same name and creates a
   // new file.  On success, stores a pointer to the new file in
@@ -91,6 +106,23 @@ class LEVELDB_EXPORT Env {
   virtual Status NewAppendableFile(const std::string& fname,
                                    WritableFile** result);
 
+  // Like NewRandomAccessFile(), but reads of the returned file bypass the
+  // operating system's page cache (e.g. with O_DIRECT) where the Env and
+  // the file system support it.
+  //
+  // The default implementation calls NewRandomAccessFile().
+  virtual Status NewDirectRandomAccessFile(const std::string& fname,
+                                           RandomAccessFile** result);
+
+  // Like NewWritableFile(), but writes to the returned file bypass the
+  // operating system's page cache where the Env and the file system
+  // support it.  Appended data may be held back until Sync() or Close(),
+  // so the file should not be read before either is called.
+  //
+  // The default implementation calls NewWritableFile().
+  virtual Status NewDirectWritableFile(const std::string& fname,
+                                       WritableFile** result);
+
   // Returns true iff the named file exists.
   virtual bool FileExists(const std::string& fname) = 0;
 
@@ -219,6 +251,22 @@ class LEVELDB_EXPORT RandomAccessFile {
   // Safe for concurrent use by multiple threads.
   virtual Status Read(uint64_t offset, size_t n, Slice* result,
                       char* scratch) const = 0;
+
+  enum AccessPattern {
+    kNormal,      // No particular pattern
+    kSequential,  // The file will be read from start to end
+    kRandom,      // The file will be read in small pieces at random
+    kDontNeed     // The file will not be read again soon
+  };
+
+  // Tell the Env how the file will be read, e.g. so that it can adapt
+  // the readahead of the operating system or drop cached pages.  The
+  // hint applies to the whole file, including reads through other
+  // RandomAccessFile objects for the same file.  The default
+  // implementation does nothing.
+  //
+  // Safe for concurrent use by multiple threads.
+  virtual void Hint(AccessPattern pattern);
 };
 
 // A file abstraction for sequential writing.  The implementation
@@ -299,12 +347,27 @@ class LEVELDB_EXPORT EnvWrapper : public Env {
                              RandomAccessFile** r) override {
     return target_->NewRandomAccessFile(f, r);
   }
+  Status NewUnmappedRandomAccessFile(const std::string& f,
+                                     RandomAccessFile** r) override {
+    return target_->NewUnmappedRandomAccessFile(f, r);
+  }
+  void SetMaxMappedFiles(int n) override {
+    target_->SetMaxMappedFiles(n);
+  }
   Status NewWritableFile(const std::string& f, WritableFile** r) override {
     return target_->NewWritableFile(f, r);
   }
   Status NewAppendableFile(const std::string& f, WritableFile** r) override {
     return target_->NewAppendableFile(f, r);
   }
+  Status NewDirectRandomAccessFile(const std::string& f,
+                                   RandomAccessFile** r) override {
+    return target_->NewDirectRandomAccessFile(f, r);
+  }
+  Status NewDirectWritableFile(const std::string& f,
+                               WritableFile** r) override {
+    return target_->NewDirectWritableFile(f, r);
+  }
   bool FileExists(const std::string& f) override {
     return target_->FileExists(f);
   }
@@ -66,6 +66,34 @@ class LEVELDB_EXPORT FilterPolicy {
 // trailing spaces in keys.
 LEVELDB_EXPORT const FilterPolicy* NewBloomFilterPolicy(int bits_per_key);
 
+// Return a new filter policy that uses a cache-line-blocked bloom filter
+// with approximately the specified number of bits per key.  All bits
+// probed for a key lie in the same 64-byte line of the filter, so a
+// lookup touches a single cache line, at the price of a slightly higher
+// false positive rate than NewBloomFilterPolicy() for the same size
+// (about 1% instead of 0.8% at 10 bits per key).
+//
+// The filters are not compatible with those of NewBloomFilterPolicy():
+// switching policies makes existing filters unused until the tables are
+// rewritten by compaction.  The same caveats about custom comparators
+// apply.  Callers must delete the result after any database that is
+// using the result has been closed.
+LEVELDB_EXPORT const FilterPolicy* NewBlockedBloomFilterPolicy(
+    int bits_per_key);
+
+// Return a new filter policy that uses a Ribbon filter with the false
+// positive rate of NewBloomFilterPolicy(bloom_equivalent_bits_per_key)
+// or better, using about 25-30% less space for large filters.  Building
+// a filter costs more CPU than a bloom filter; probing costs about the
+// same.  The size of a Ribbon filter is rounded up to a multiple of 64
+// keys, so it is best combined with Options::full_filter.
+//
+// The same caveats as for NewBloomFilterPolicy() apply.  Callers must
+// delete the result after any database that is using the result has
+// been closed.
+LEVELDB_EXPORT const FilterPolicy* NewRibbonFilterPolicy(
+    int bloom_equivalent_bits_per_key);
+
 }  // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_INCLUDE_FILTER_POLICY_H_
@@ -74,6 +74,15 @@ class LEVELDB_EXPORT Iterator {
   // If an error has occurred, return it.  Else return an ok status.
   virtual Status status() const = 0;
 
+  // Make the iterator read the current state of its source instead of the
+  // state it was created with, reusing as much of its internal state as
+  // possible.  For an iterator from DB::NewIterator(), this moves it to
+  // the latest sequence number and the current files, ignoring
+  // ReadOptions::snapshot, which is cheaper than creating a new iterator.
+  // The iterator is not Valid() afterwards.  Returns NotSupported if the
+  // iterator cannot be refreshed.
+  virtual Status Refresh();
+
   // Clients are allowed to register function/arg1/arg2 triples that
   // will be invoked when this iterator is destroyed.
   //
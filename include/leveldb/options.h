@@ -15,6 +15,9 @@ class Comparator;
 class Env;
 class FilterPolicy;
 class Logger;
+class PersistentCache;
+class Slice;
+class SliceTransform;
 class Snapshot;
 
 // DB contents are stored in a set of blocks, each of which holds a
@@ -90,6 +93,23 @@ struct LEVELDB_EXPORT Options {
   // Default: 1000
   int max_open_files;
 
+  // If true, DB::Open opens the table files of the database and loads
+  // their index and filter blocks, so that the first reads of each file
+  // do not pay for it.  Files are opened from level 0 up to as many as the
+  // table cache holds (see max_open_files).  With paranoid_checks, the
+  // footers and index blocks are verified against their checksums and any
+  // error makes DB::Open fail; otherwise files that fail to open are left
+  // to be opened on first use.
+  //
+  // Default: false
+  bool preload_tables_on_open;
+
+  // Number of threads used to open table files in parallel when
+  // preload_tables_on_open is true.
+  //
+  // Default: 16
+  int max_file_opening_threads;
+
   // Control over blocks (user data is stored in a set of blocks, and
   // a block is the unit of reading from disk).
 
@@ -98,6 +118,57 @@ struct LEVELDB_EXPORT Options {
   // Default: nullptr
   Cache* block_cache;
 
+  // If true, the index and filter blocks of each table are loaded through
+  // block_cache (with Cache::kHighPriority) instead of being held by the
+  // table for as long as it is open.  Their memory is then bounded by, and
+  // accounted against, the block cache capacity rather than max_open_files.
+  //
+  // Default: false
+  bool cache_index_and_filter_blocks;
+
+  // If true and cache_index_and_filter_blocks is also true, the index and
+  // filter blocks of level-0 tables (which are consulted by every Get) are
+  // kept referenced in block_cache for as long as the table is open, so
+  // they are never evicted.
+  //
+  // Default: false
+  bool pin_l0_filter_and_index_blocks_in_cache;
+
+  // If non-null, use the specified cache for the results of point
+  // lookups in individual tables: the newest entry of a key in a table,
+  // or the fact that the table holds none.  Repeated Get() calls for hot
+  // keys then skip the index, block cache and block search entirely.
+  // Each entry is charged the size of its key and value.  Entries are
+  // only added by reads with ReadOptions::fill_cache set.  The cache may
+  // be shared between databases.
+  // Default: nullptr
+  Cache* row_cache;
+
+  // If non-null, use the specified cache as a second tier behind
+  // block_cache that holds compressed data blocks as they are stored in
+  // the table files.  A block missing from block_cache is then
+  // decompressed from this cache instead of being read from the file, so
+  // the same memory holds several times more of the working set.  Each
+  // entry is charged its compressed size.  Blocks that are stored
+  // uncompressed are not added.
+  // Default: nullptr
+  Cache* compressed_block_cache;
+
+  // If non-null, data blocks read from table files are also stored in
+  // the specified persistent cache (see NewPersistentCache()), as they
+  // are stored in the files, and blocks missing from the in-memory caches
+  // are read from it instead of from the table file.  Useful when the
+  // cache lives on a device that is much faster than the one holding
+  // the database.  Blocks are only added by reads with
+  // ReadOptions::fill_cache set.  Entries keep the block checksums, which
+  // are verified on hits by reads with ReadOptions::verify_checksums set;
+  // blocks that fail are read from the file.  Entries are keyed by the
+  // identity of the database, kept in its IDENTITY file, and the table
+  // file number, so one persistent cache may serve several databases and
+  // outlive them.
+  // Default: nullptr
+  PersistentCache* persistent_cache;
+
   // Approximate size of user data packed per block.  Note that the
   // block size specified here corresponds to uncompressed data.  The
   // actual size of the unit read from disk may be smaller if
@@ -125,6 +196,51 @@ struct LEVELDB_EXPORT Options {
   // Default: 2MB
   size_t max_file_size;
 
+  // Compactions read their input tables with this much readahead (see
+  // ReadOptions::readahead_size), turning many block-sized reads into a
+  // few large ones.  Each input table being read at a time has a buffer
+  // of this size.  Zero disables compaction readahead.
+  //
+  // Default: 2MB
+  size_t compaction_readahead_size;
+
+  // Table files are memory-mapped for reading where the Env supports it
+  // and its budget of mapped files allows (see Env::SetMaxMappedFiles).
+  // Uncompressed blocks are then parsed in place from the mapping rather
+  // than copied.  Only files at levels up to mmap_max_level and, if
+  // mmap_max_file_size is non-zero, of at most mmap_max_file_size bytes
+  // are mapped; others are read with ordinary reads (see
+  // Env::NewUnmappedRandomAccessFile), so their blocks can be kept in
+  // block_cache.
+  //
+  // Default: 6 (all levels) and 0 (no size limit)
+  int mmap_max_level;
+  size_t mmap_max_file_size;
+
+  // If true, table files are hinted for random access when opened (see
+  // RandomAccessFile::kRandom), which stops the operating system from
+  // reading ahead around the blocks read by point lookups.  While
+  // iterators with ReadOptions::readahead_size read a file, it is hinted
+  // for sequential access instead; the random hint is restored when the
+  // last of them is deleted.
+  //
+  // Default: false
+  bool advise_random_on_open;
+
+  // If true, table files are read with direct I/O (see
+  // Env::NewDirectRandomAccessFile), bypassing the operating system's
+  // page cache, so that blocks are only cached once, in block_cache.
+  //
+  // Default: false
+  bool use_direct_reads;
+
+  // If true, the table files written by memtable flushes and compactions
+  // are written with direct I/O (see Env::NewDirectWritableFile), so that
+  // compactions do not evict the page cache.
+  //
+  // Default: false
+  bool use_direct_io_for_flush_and_compaction;
+
   // Compress blocks using the specified compression algorithm.  This
   // parameter can be changed dynamically.
   //
@@ -154,6 +270,23 @@ struct LEVELDB_EXPORT Options {
   // Default: nullptr
   const FilterPolicy* filter_policy;
 
+  // If true (and filter_policy is set), new tables get a single filter
+  // covering all of their keys instead of one filter per 2KB of data.
+  // A lookup can then reject a table with one filter probe, before the
+  // index block is consulted.  Tables in either format remain readable.
+  //
+  // Default: false
+  bool full_filter;
+
+  // If non-null (and filter_policy is set), the prefix of every key in
+  // the domain of the transform is added to the filters of new tables
+  // along with the key itself.  Iterators that set
+  // ReadOptions::prefix_same_as_start can then skip tables and blocks
+  // that hold no key with the prefix of their seek target.
+  //
+  // Default: nullptr
+  const SliceTransform* prefix_extractor;
+
   // Create an Options object with default values for all fields.
   Options();
 };
@@ -177,10 +310,80 @@ struct LEVELDB_EXPORT ReadOptions {
   // Default: nullptr
   const Snapshot* snapshot;
 
+  // If true (and Options::prefix_extractor is set), an iterator only
+  // returns keys with the same prefix as the target of the last Seek(),
+  // and becomes invalid at the first key with another prefix.  This lets
+  // the seek skip tables and blocks whose filters rule the prefix out.
+  // Only Seek() followed by Next() is supported: Prev() or a change of
+  // direction after such a Seek() may miss keys.  SeekToFirst() and
+  // SeekToLast() iterate without a prefix bound.
+  // Default: false
+  bool prefix_same_as_start;
+
+  // If non-null, iterators only return keys less than *iterate_upper_bound
+  // (an exclusive bound), and SeekToLast() positions at the last such key.
+  // Tables and blocks that lie entirely at or past the bound are not
+  // read.  The pointed-to slice must remain live while the iterator is.
+  // Default: nullptr
+  const Slice* iterate_upper_bound;
+
+  // If non-null, iterators only return keys greater than or equal to
+  // *iterate_lower_bound (an inclusive bound), and SeekToFirst() as well
+  // as seeks to smaller keys position at the first such key.  Tables and
+  // blocks that lie entirely before the bound are not read.  The
+  // pointed-to slice must remain live while the iterator is.
+  // Default: nullptr
+  const Slice* iterate_lower_bound;
+
+  // If non-zero, an iterator that reads the data blocks of a table in
+  // order reads ahead of the block it needs, starting with a few
+  // kilobytes and doubling the amount on every sequential block read up
+  // to readahead_size bytes.  Useful for long scans of files that are
+  // not memory-mapped, especially on devices with a high per-read cost.
+  // The files are also hinted to the Env as being read sequentially
+  // until the iterator is deleted (see RandomAccessFile::Hint).  The hint
+  // applies to the whole file, so it also affects other readers of the
+  // file meanwhile.
+  // Default: 0 (no readahead)
+  size_t readahead_size;
+
+  // If true, an iterator moving forward through a table reads the next
+  // data block into the block cache on a background thread while the
+  // caller is still consuming the current one, so that I/O overlaps
+  // with the caller's work.  Prefetched blocks are cached even if
+  // fill_cache is false.  Has no effect on blocks that are not cacheable,
+  // e.g. uncompressed blocks of memory-mapped files.
+  // Default: false
+  bool async_prefetch;
+
+  // If true, an iterator keeps every block and table it reads in memory
+  // until it is deleted, instead of releasing each one as it moves on.
+  // Reverse iteration then returns values without copying them, at the
+  // cost of memory proportional to the data the iterator has visited.
+  // Default: false
+  bool pin_data;
+
+  // If true, the iterator is not bound to a snapshot: every Seek(),
+  // SeekToFirst() and SeekToLast() reads the latest state of the DB,
+  // including writes and flushed or compacted files that appeared after
+  // the iterator was created, so that a consumer polling for new keys
+  // can keep one iterator and re-seek it instead of creating a new one.
+  // Next() and Prev() stay at the state of the last seek.  "snapshot"
+  // is ignored.
+  // Default: false
+  bool tailing;
+
   ReadOptions()
       : verify_checksums(false),
         fill_cache(true),
-        snapshot(nullptr) {
+        snapshot(nullptr),
+        prefix_same_as_start(false),
+        iterate_upper_bound(nullptr),
+        iterate_lower_bound(nullptr),
+        readahead_size(0),
+        async_prefetch(false),
+        pin_data(false),
+        tailing(false) {
   }
 };
 
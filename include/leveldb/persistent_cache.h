@@ -0,0 +1,61 @@
+// Copyright (c) 2012 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A PersistentCache keeps blocks of table files on a local device that is
+// faster than the one holding the database, as a tier behind the
+// in-memory block caches (see Options::persistent_cache).  Unlike a
+// Cache, its contents survive restarts of the process.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_PERSISTENT_CACHE_H_
+#define STORAGE_LEVELDB_INCLUDE_PERSISTENT_CACHE_H_
+
+#include <stdint.h>
+#include <string>
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class Env;
+
+class LEVELDB_EXPORT PersistentCache {
+ public:
+  PersistentCache() = default;
+
+  PersistentCache(const PersistentCache&) = delete;
+  PersistentCache& operator=(const PersistentCache&) = delete;
+
+  // Writes out any buffered entries so that they are found again when
+  // the cache is next opened.
+  virtual ~PersistentCache();
+
+  // Store a copy of "data" under "key", replacing any previous entry for
+  // "key".  Older entries may be dropped to stay within the capacity.
+  virtual Status Insert(const Slice& key, const Slice& data) = 0;
+
+  // If the cache holds an entry for "key", store its data in *data and
+  // return OK.  Otherwise return a NotFound status.
+  virtual Status Lookup(const Slice& key, std::string* data) = 0;
+
+  // Return the number of bytes currently used by the cache.
+  virtual uint64_t TotalSize() = 0;
+};
+
+// Open the persistent cache stored in directory "dir", creating it if
+// necessary, and store it in *result.  Entries are appended to a log of
+// files in "dir" and the oldest files are deleted once they take up more
+// than "capacity" bytes.  The index of the entries is held in memory and
+// rebuilt from the files when the cache is opened.  Only one cache may
+// use "dir" at a time.
+//
+// On failure stores nullptr in *result and returns a non-OK status.
+// The caller should delete *result when it is no longer needed.
+LEVELDB_EXPORT Status NewPersistentCache(Env* env, const std::string& dir,
+                                         uint64_t capacity,
+                                         PersistentCache** result);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_PERSISTENT_CACHE_H_
@@ -0,0 +1,78 @@
+// Copyright (c) 2012 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A PinnableSlice is a Slice that may refer to memory owned by someone
+// else, which is kept alive ("pinned") until the slice is reset or
+// destroyed.  DB::Get() uses it to return values without copying them
+// out of the memtable or the block cache.
+//
+// Multiple threads can invoke const methods on a PinnableSlice without
+// external synchronization, but if any of the threads may call a
+// non-const method, all threads accessing the same PinnableSlice must use
+// external synchronization.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_PINNABLE_SLICE_H_
+#define STORAGE_LEVELDB_INCLUDE_PINNABLE_SLICE_H_
+
+#include <assert.h>
+#include <string>
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+class LEVELDB_EXPORT PinnableSlice : public Slice {
+ public:
+  using CleanupFunction = void (*)(void* arg1, void* arg2);
+
+  PinnableSlice() : cleanup_(nullptr), arg1_(nullptr), arg2_(nullptr) { }
+
+  PinnableSlice(const PinnableSlice&) = delete;
+  PinnableSlice& operator=(const PinnableSlice&) = delete;
+
+  ~PinnableSlice() { Reset(); }
+
+  // Make the slice refer to "s", whose storage remains valid until
+  // (*function)(arg1, arg2) is invoked when the slice is next reset or
+  // destroyed.
+  void PinSlice(const Slice& s, CleanupFunction function,
+                void* arg1, void* arg2) {
+    assert(function != nullptr);
+    Reset();
+    Slice::operator=(s);
+    cleanup_ = function;
+    arg1_ = arg1;
+    arg2_ = arg2;
+  }
+
+  // Make the slice refer to a copy of "s" held by the slice itself.
+  void PinSelf(const Slice& s) {
+    Reset();
+    self_.assign(s.data(), s.size());
+    Slice::operator=(self_);
+  }
+
+  // Release the pinned memory, if any, and make the slice empty.
+  void Reset() {
+    if (cleanup_ != nullptr) {
+      CleanupFunction function = cleanup_;
+      cleanup_ = nullptr;
+      (*function)(arg1_, arg2_);
+    }
+    clear();
+  }
+
+  // Return true iff the slice refers to memory it does not own.
+  bool IsPinned() const { return cleanup_ != nullptr; }
+
+ private:
+  CleanupFunction cleanup_;
+  void* arg1_;
+  void* arg2_;
+  std::string self_;  // Backing store of PinSelf()
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_PINNABLE_SLICE_H_
@@ -0,0 +1,52 @@
+// Copyright (c) 2012 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A database can be configured with a SliceTransform that extracts a
+// prefix from every key (see Options::prefix_extractor).  The prefixes
+// are added to the filters of new tables, so that an iterator that only
+// wants keys sharing the prefix of its seek target can skip files and
+// blocks without such keys (see ReadOptions::prefix_same_as_start).
+
+#ifndef STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
+#define STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
+
+#include <stddef.h>
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+class LEVELDB_EXPORT SliceTransform {
+ public:
+  virtual ~SliceTransform();
+
+  // Return the name of this transform.  The name is recorded in every
+  // table whose filter contains prefixes, and prefix filtering is only
+  // applied to tables written with a transform of the same name.  The
+  // name must therefore change whenever Transform() changes.
+  virtual const char* Name() const = 0;
+
+  // Return the prefix of "key".  The result must be a prefix of "key"
+  // (i.e. refer to key.data() and be no longer than key), and all keys
+  // with the same prefix must be adjacent in the order of the comparator.
+  // REQUIRES: InDomain(key)
+  virtual Slice Transform(const Slice& key) const = 0;
+
+  // Return true iff "key" has a prefix.  Keys outside of the domain are
+  // not added to filters as prefixes and never cause anything to be
+  // skipped.
+  virtual bool InDomain(const Slice& key) const = 0;
+};
+
+// Return a new transform whose prefix is the first "prefix_len" bytes of
+// a key.  Keys shorter than "prefix_len" are outside of its domain.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const SliceTransform* NewFixedPrefixTransform(
+    size_t prefix_len);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
@@ -6,6 +6,7 @@
 #define STORAGE_LEVELDB_INCLUDE_TABLE_H_
 
 #include <stdint.h>
+#include "leveldb/cache.h"
 #include "leveldb/export.h"
 #include "leveldb/iterator.h"
 
@@ -13,11 +14,13 @@ namespace leveldb {
 
 class Block;
 class BlockHandle;
+struct BlockContents;
 class Footer;
 struct Options;
 class RandomAccessFile;
 struct ReadOptions;
 class TableCache;
+struct TableProperties;
 
 // A Table is a sorted map from strings to strings.  Tables are
 // immutable and persistent.  A Table may be safely accessed from
@@ -49,6 +52,9 @@ class LEVELDB_EXPORT Table {
   // Returns a new iterator over the table contents.
   // The result of NewIterator() is initially invalid (caller must
   // call one of the Seek methods on the iterator before using it).
+  // ReadOptions::iterate_upper_bound and iterate_lower_bound only keep the
+  // iterator from reading blocks that lie entirely outside the bounds;
+  // the caller must still check keys of the blocks it does read.
   Iterator* NewIterator(const ReadOptions&) const;
 
   // Given a key, return an approximate byte offset in the file where
@@ -59,25 +65,64 @@ class LEVELDB_EXPORT Table {
   // be close to the file length.
   uint64_t ApproximateOffsetOf(const Slice& key) const;
 
+  // Returns the statistics the TableBuilder stored in the table, or
+  // nullptr if the table has none (e.g. it was written by an older
+  // version) or they could not be read.
+  const TableProperties* properties() const;
+
  private:
   struct Rep;
   Rep* rep_;
 
   explicit Table(Rep* rep) { rep_ = rep; }
   static Iterator* BlockReader(void*, const ReadOptions&, const Slice&);
+  static Iterator* ReadaheadBlockReader(void*, const ReadOptions&,
+                                        const Slice&);
+  static bool ReadaheadPrefixMayMatchBlock(void*, const Slice& key,
+                                           const Slice& index_value);
+  static void PrefetchBlock(void*, const ReadOptions&, const Slice&);
+  static void ReadaheadPrefetchBlock(void*, const ReadOptions&, const Slice&);
+  Iterator* DataBlockIterator(RandomAccessFile* file, const ReadOptions&,
+                              const Slice& index_value,
+                              Cache::Priority priority) const;
+  Status ReadDataBlock(RandomAccessFile* file, const ReadOptions&,
+                       const BlockHandle& handle,
+                       BlockContents* contents) const;
+  Iterator* NewIndexIterator() const;
 
   // Calls (*handle_result)(arg, ...) with the entry found after a call
   // to Seek(key).  May not make such a call if filter policy says
-  // that key is not present.
+  // that key is not present.  If such a call is made and "pinned" is
+  // non-null, sets *pinned to an iterator that keeps the memory of the
+  // entry alive until it is deleted (but not the table itself).
   friend class TableCache;
   Status InternalGet(
       const ReadOptions&, const Slice& key,
       void* arg,
-      void (*handle_result)(void* arg, const Slice& k, const Slice& v));
-
+      void (*handle_result)(void* arg, const Slice& k, const Slice& v),
+      Iterator** pinned = nullptr);
+
+  // Returns false if the filters show that no key with the prefix of
+  // "key" (see Options::prefix_extractor) is in the table or, if
+  // "index_value" is non-null, in the data block it refers to.
+  bool PrefixMayMatch(const Slice& key, const Slice* index_value) const;
+  static bool PrefixMayMatchBlock(void*, const Slice& key,
+                                  const Slice& index_value);
+
+  // If the index and filter blocks live in the block cache, keep them
+  // referenced until this table is deleted so that they cannot be evicted.
+  // REQUIRES: the table has not been shared with other threads yet.
+  void PinIndexAndFilterBlocks();
+
+  // Let the data blocks of this table be kept in options.persistent_cache
+  // under keys that start with "prefix", which must identify the table
+  // among all tables that the persistent cache is ever used with.
+  // REQUIRES: the table has not been shared with other threads yet.
+  void SetPersistentCacheKeyPrefix(const Slice& prefix);
 
   void ReadMeta(const Footer& footer);
-  void ReadFilter(const Slice& filter_handle_value);
+  void ReadFilter(const Slice& filter_handle_value, bool full_filter);
+  void ReadProperties(const Slice& properties_handle_value);
 };
 
 }  // namespace leveldb
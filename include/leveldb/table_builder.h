@@ -50,6 +50,12 @@ class LEVELDB_EXPORT TableBuilder {
   // REQUIRES: Finish(), Abandon() have not been called
   void Add(const Slice& key, const Slice& value);
 
+  // Like Add(), but also records in the table properties (see
+  // Table::properties()) the sequence number of the entry and whether it
+  // deletes its key.  Used by the DB, whose keys encode both.
+  void Add(const Slice& key, const Slice& value, uint64_t sequence,
+           bool deletion);
+
   // Advanced operation: flush any buffered key/value pairs to file.
   // Can be used to ensure that two adjacent entries never live in
   // the same data block.  Most clients should not need to use this method.
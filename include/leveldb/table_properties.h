@@ -0,0 +1,58 @@
+// Copyright (c) 2012 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// TableProperties are statistics about the contents of a table file,
+// gathered by the TableBuilder that wrote it and stored in the file, so
+// that they can be read back without scanning the table (see
+// Table::properties() and DB::GetPropertiesOfAllTables()).
+
+#ifndef STORAGE_LEVELDB_INCLUDE_TABLE_PROPERTIES_H_
+#define STORAGE_LEVELDB_INCLUDE_TABLE_PROPERTIES_H_
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+struct LEVELDB_EXPORT TableProperties {
+  uint64_t num_entries;      // Number of key/value pairs
+  uint64_t num_deletions;    // Entries of a DB table that delete their key
+  uint64_t raw_key_size;     // Total size of the keys as added
+  uint64_t raw_value_size;   // Total size of the values as added
+  uint64_t data_size;        // Total size of the data blocks as stored
+  uint64_t num_data_blocks;
+
+  // Range of the sequence numbers of the entries of a DB table; both are
+  // zero for other tables.
+  uint64_t smallest_seqno;
+  uint64_t largest_seqno;
+
+  TableProperties()
+      : num_entries(0),
+        num_deletions(0),
+        raw_key_size(0),
+        raw_value_size(0),
+        data_size(0),
+        num_data_blocks(0),
+        smallest_seqno(0),
+        largest_seqno(0) {
+  }
+
+  // Size of the keys and values relative to the data blocks that store
+  // them, e.g. 2.0 if compression and key prefix sharing halved them.
+  // Returns 0 for a table without data.
+  double CompressionRatio() const {
+    return data_size == 0 ? 0.0 :
+        static_cast<double>(raw_key_size + raw_value_size) / data_size;
+  }
+};
+
+// Properties of tables by file name
+typedef std::map<std::string, TableProperties> TablePropertiesCollection;
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_TABLE_PROPERTIES_H_
@@ -87,6 +87,20 @@ class Block::Iter : public Iterator {
   Slice value_;
   Status status_;
 
+  // Entries of the restart interval decoded by the last scan of Prev(),
+  // so that further calls of Prev() within the interval need not decode
+  // it again.  The interval ends at the entry at prev_entries_[prev_index_]
+  // if current_ is that entry's offset; otherwise the cache is unused.
+  struct CachedPrevEntry {
+    uint32_t offset;       // Offset of the entry in data_
+    size_t key_offset;     // Offset of the key in prev_keys_
+    size_t key_size;
+    Slice value;
+  };
+  std::vector<CachedPrevEntry> prev_entries_;
+  std::string prev_keys_;  // Keys of prev_entries_, concatenated
+  size_t prev_index_;
+
   inline int Compare(const Slice& a, const Slice& b) const {
     return comparator_->Compare(a, b);
   }
@@ -121,7 +135,8 @@ class Block::Iter : public Iterator {
         restarts_(restarts),
         num_restarts_(num_restarts),
         current_(restarts_),
-        restart_index_(num_restarts_) {
+        restart_index_(num_restarts_),
+        prev_index_(0) {
     assert(num_restarts_ > 0);
   }
 
@@ -144,6 +159,18 @@ class Block::Iter : public Iterator {
   virtual void Prev() {
     assert(Valid());
 
+    if (prev_index_ > 0 && prev_index_ < prev_entries_.size() &&
+        prev_entries_[prev_index_].offset == current_) {
+      // The previous entry was decoded by an earlier scan.  It lies in the
+      // same restart interval, so restart_index_ stays the same.
+      prev_index_--;
+      const CachedPrevEntry& entry = prev_entries_[prev_index_];
+      current_ = entry.offset;
+      key_.assign(prev_keys_.data() + entry.key_offset, entry.key_size);
+      value_ = entry.value;
+      return;
+    }
+
     // Scan backwards to a restart point before current_
     const uint32_t original = current_;
     while (GetRestartPoint(restart_index_) >= original) {
@@ -157,9 +184,23 @@ class Block::Iter : public Iterator {
     }
 
     SeekToRestartPoint(restart_index_);
-    do {
-      // Loop until end of current entry hits the start of original entry
-    } while (ParseNextKey() && NextEntryOffset() < original);
+    prev_entries_.clear();
+    prev_keys_.clear();
+    // Loop until end of current entry hits the start of original entry,
+    // remembering the entries on the way.
+    while (ParseNextKey()) {
+      CachedPrevEntry entry;
+      entry.offset = current_;
+      entry.key_offset = prev_keys_.size();
+      entry.key_size = key_.size();
+      entry.value = value_;
+      prev_keys_.append(key_);
+      prev_entries_.push_back(entry);
+      if (NextEntryOffset() >= original) {
+        break;
+      }
+    }
+    prev_index_ = prev_entries_.empty() ? 0 : prev_entries_.size() - 1;
   }
 
   virtual void Seek(const Slice& target) {
@@ -5,6 +5,7 @@
 #include "table/filter_block.h"
 
 #include "leveldb/filter_policy.h"
+#include "leveldb/slice_transform.h"
 #include "util/coding.h"
 
 namespace leveldb {
@@ -15,11 +16,18 @@ namespace leveldb {
 static const size_t kFilterBaseLg = 11;
 static const size_t kFilterBase = 1 << kFilterBaseLg;
 
-FilterBlockBuilder::FilterBlockBuilder(const FilterPolicy* policy)
-    : policy_(policy) {
+FilterBlockBuilder::FilterBlockBuilder(const FilterPolicy* policy,
+                                       bool full_filter,
+                                       const SliceTransform* prefix_extractor)
+    : policy_(policy),
+      full_filter_(full_filter),
+      prefix_extractor_(prefix_extractor) {
 }
 
 void FilterBlockBuilder::StartBlock(uint64_t block_offset) {
+  if (full_filter_) {
+    return;  // Keys of all blocks go into the same filter
+  }
   uint64_t filter_index = (block_offset / kFilterBase);
   assert(filter_index >= filter_offsets_.size());
   while (filter_index > filter_offsets_.size()) {
@@ -31,12 +39,25 @@ void FilterBlockBuilder::AddKey(const Slice& key) {
   Slice k = key;
   start_.push_back(keys_.size());
   keys_.append(k.data(), k.size());
+  if (prefix_extractor_ != nullptr && prefix_extractor_->InDomain(k)) {
+    // Keys arrive in order, so copies of a prefix are adjacent
+    Slice prefix = prefix_extractor_->Transform(k);
+    if (prefix_start_.empty() ||
+        prefix != Slice(prefixes_.data() + prefix_start_.back(),
+                        prefixes_.size() - prefix_start_.back())) {
+      prefix_start_.push_back(prefixes_.size());
+      prefixes_.append(prefix.data(), prefix.size());
+    }
+  }
 }
 
 Slice FilterBlockBuilder::Finish() {
   if (!start_.empty()) {
     GenerateFilter();//DHQ: 调用 GenerateFilter
   }
+  if (full_filter_) {
+    return Slice(result_);  // No offset array: the block is the filter
+  }
 
   // Append array of per-filter offsets
   const uint32_t array_offset = result_.size();
@@ -57,31 +78,48 @@ void FilterBlockBuilder::GenerateFilter() {
     return;
   }
 
-  // Make list of keys from flattened key structure
+  // Make list of keys from flattened key structure, followed by the
+  // prefixes of those keys
+  const size_t num_prefixes = prefix_start_.size();
   start_.push_back(keys_.size());  // Simplify length computation
-  tmp_keys_.resize(num_keys);
+  prefix_start_.push_back(prefixes_.size());
+  tmp_keys_.resize(num_keys + num_prefixes);
   for (size_t i = 0; i < num_keys; i++) {
     const char* base = keys_.data() + start_[i];
     size_t length = start_[i+1] - start_[i];
     tmp_keys_[i] = Slice(base, length);
   }
+  for (size_t i = 0; i < num_prefixes; i++) {
+    const char* base = prefixes_.data() + prefix_start_[i];
+    size_t length = prefix_start_[i+1] - prefix_start_[i];
+    tmp_keys_[num_keys + i] = Slice(base, length);
+  }
 
   // Generate filter for current set of keys and append to result_.
   filter_offsets_.push_back(result_.size());
-  policy_->CreateFilter(&tmp_keys_[0], static_cast<int>(num_keys), &result_);
+  policy_->CreateFilter(&tmp_keys_[0],
+                        static_cast<int>(num_keys + num_prefixes), &result_);
   //DHQ: 这里实际上是根据policy产生的。
   tmp_keys_.clear();
   keys_.clear();
   start_.clear();
+  prefixes_.clear();
+  prefix_start_.clear();
 }
 
 FilterBlockReader::FilterBlockReader(const FilterPolicy* policy,
-                                     const Slice& contents)
+                                     const Slice& contents,
+                                     bool full_filter)
     : policy_(policy),
+      full_filter_(full_filter),
       data_(nullptr),
       offset_(nullptr),
       num_(0),
       base_lg_(0) {
+  if (full_filter) {
+    contents_ = contents;
+    return;
+  }
   size_t n = contents.size();
   if (n < 5) return;  // 1 byte for base_lg_ and 4 for start of offset array
   base_lg_ = contents[n-1];
@@ -108,4 +146,13 @@ bool FilterBlockReader::KeyMayMatch(uint64_t block_offset, const Slice& key) {
   return true;  // Errors are treated as potential matches
 }
 
+bool FilterBlockReader::KeyMayMatch(const Slice& key) {
+  assert(full_filter_);
+  if (contents_.empty()) {
+    // Empty filters do not match any keys
+    return false;
+  }
+  return policy_->KeyMayMatch(key, contents_);
+}
+
 }
@@ -19,16 +19,25 @@
 namespace leveldb {
 
 class FilterPolicy;
+class SliceTransform;
 
 // A FilterBlockBuilder is used to construct all of the filters for a
 // particular Table.  It generates a single string which is stored as
 // a special block in the Table.
 //
+// If "full_filter" is true, a single filter is built over every key in
+// the table instead of one filter per kFilterBase bytes of data, and
+// the block consists of nothing but that filter.
+//
+// If "prefix_extractor" is non-null, the prefix of each key in its domain
+// is added to the filter covering the key as well.
+//
 // The sequence of calls to FilterBlockBuilder must match the regexp:
 //      (StartBlock AddKey*)* Finish
 class FilterBlockBuilder {
  public:
-  explicit FilterBlockBuilder(const FilterPolicy*);
+  explicit FilterBlockBuilder(const FilterPolicy*, bool full_filter = false,
+                              const SliceTransform* prefix_extractor = nullptr);
 
   void StartBlock(uint64_t block_offset);
   void AddKey(const Slice& key);
@@ -38,8 +47,12 @@ class FilterBlockBuilder {
   void GenerateFilter();
 
   const FilterPolicy* policy_;
+  const bool full_filter_;
+  const SliceTransform* prefix_extractor_;
   std::string keys_;              // Flattened key contents
   std::vector<size_t> start_;     // Starting index in keys_ of each key
+  std::string prefixes_;          // Flattened distinct prefixes of the keys
+  std::vector<size_t> prefix_start_;  // Starting index in prefixes_
   std::string result_;            // Filter data computed so far
   std::vector<Slice> tmp_keys_;   // policy_->CreateFilter() argument
   std::vector<uint32_t> filter_offsets_;
@@ -52,11 +65,21 @@ class FilterBlockBuilder {
 class FilterBlockReader {
  public:
  // REQUIRES: "contents" and *policy must stay live while *this is live.
-  FilterBlockReader(const FilterPolicy* policy, const Slice& contents);
+  FilterBlockReader(const FilterPolicy* policy, const Slice& contents,
+                    bool full_filter = false);
   bool KeyMayMatch(uint64_t block_offset, const Slice& key);
 
+  // Returns false if "key" is definitely not in the table.
+  // REQUIRES: full_filter()
+  bool KeyMayMatch(const Slice& key);
+
+  // True iff this reader was built over a whole-table filter.
+  bool full_filter() const { return full_filter_; }
+
  private:
   const FilterPolicy* policy_;
+  const bool full_filter_;
+  Slice contents_;      // Entire filter if full_filter_
   const char* data_;    // Pointer to filter data (at block-start)
   const char* offset_;  // Pointer to beginning of offset array (at block-end)
   size_t num_;          // Number of entries in offset array
@@ -5,6 +5,7 @@
 #include "table/filter_block.h"
 
 #include "leveldb/filter_policy.h"
+#include "leveldb/slice_transform.h"
 #include "util/coding.h"
 #include "util/hash.h"
 #include "util/logging.h"
@@ -121,6 +122,70 @@ TEST(FilterBlockTest, MultiChunk) {
   ASSERT_TRUE(! reader.KeyMayMatch(9000, "bar"));
 }
 
+TEST(FilterBlockTest, FullFilterEmpty) {
+  FilterBlockBuilder builder(&policy_, true);
+  Slice block = builder.Finish();
+  ASSERT_EQ("", EscapeString(block));
+  FilterBlockReader reader(&policy_, block, true);
+  ASSERT_TRUE(reader.full_filter());
+  ASSERT_TRUE(! reader.KeyMayMatch("foo"));
+}
+
+TEST(FilterBlockTest, FullFilter) {
+  FilterBlockBuilder builder(&policy_, true);
+  builder.StartBlock(0);
+  builder.AddKey("foo");
+  builder.StartBlock(2000);
+  builder.AddKey("bar");
+  builder.StartBlock(9000);
+  builder.AddKey("box");
+  builder.AddKey("hello");
+  Slice block = builder.Finish();
+
+  // A single filter with one hash per key and no offset array
+  ASSERT_EQ(16, block.size());
+  FilterBlockReader reader(&policy_, block, true);
+  ASSERT_TRUE(reader.KeyMayMatch("foo"));
+  ASSERT_TRUE(reader.KeyMayMatch("bar"));
+  ASSERT_TRUE(reader.KeyMayMatch("box"));
+  ASSERT_TRUE(reader.KeyMayMatch("hello"));
+  ASSERT_TRUE(! reader.KeyMayMatch("missing"));
+  ASSERT_TRUE(! reader.KeyMayMatch("other"));
+}
+
+TEST(FilterBlockTest, Prefixes) {
+  const SliceTransform* prefix = NewFixedPrefixTransform(3);
+  for (int full = 0; full < 2; full++) {
+    FilterBlockBuilder builder(&policy_, full != 0, prefix);
+    builder.StartBlock(0);
+    builder.AddKey("foo1");
+    builder.AddKey("foo2");
+    builder.AddKey("hi");  // Not in the domain of the transform
+    builder.StartBlock(3100);
+    builder.AddKey("box");
+    Slice block = builder.Finish();
+
+    FilterBlockReader reader(&policy_, block, full != 0);
+    if (full) {
+      // Four keys and two distinct prefixes
+      ASSERT_EQ(24, block.size());
+      ASSERT_TRUE(reader.KeyMayMatch("foo1"));
+      ASSERT_TRUE(reader.KeyMayMatch("foo"));
+      ASSERT_TRUE(reader.KeyMayMatch("box"));
+      ASSERT_TRUE(! reader.KeyMayMatch("hi "));
+      ASSERT_TRUE(! reader.KeyMayMatch("bar"));
+    } else {
+      ASSERT_TRUE(reader.KeyMayMatch(0, "foo2"));
+      ASSERT_TRUE(reader.KeyMayMatch(0, "foo"));
+      ASSERT_TRUE(reader.KeyMayMatch(0, "hi"));
+      ASSERT_TRUE(! reader.KeyMayMatch(0, "box"));
+      ASSERT_TRUE(reader.KeyMayMatch(3100, "box"));
+      ASSERT_TRUE(! reader.KeyMayMatch(3100, "foo"));
+    }
+  }
+  delete prefix;
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
@@ -4,9 +4,11 @@
 
 #include "table/format.h"
 
+#include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "port/port.h"
 #include "table/block.h"
+#include "table/block_builder.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
 
@@ -65,7 +67,8 @@ Status Footer::DecodeFrom(Slice* input) {
 Status ReadBlock(RandomAccessFile* file,
                  const ReadOptions& options,
                  const BlockHandle& handle,
-                 BlockContents* result) {
+                 BlockContents* result,
+                 std::string* stored) {
   result->data = Slice();
   result->cachable = false;
   result->heap_allocated = false;
@@ -88,14 +91,15 @@ Status ReadBlock(RandomAccessFile* file,
   // Check the crc of the type and the block contents
   const char* data = contents.data();    // Pointer to where Read put the data
   if (options.verify_checksums) {//DHQ: options里面的snapshot，没有被使用？
-    const uint32_t crc = crc32c::Unmask(DecodeFixed32(data + n + 1));
-    const uint32_t actual = crc32c::Value(data, n + 1);
-    if (actual != crc) {
+    if (!BlockChecksumMatches(contents)) {
       delete[] buf;
       s = Status::Corruption("block checksum mismatch");
       return s;
     }
   }
+  if (stored != nullptr) {
+    stored->assign(data, n + kBlockTrailerSize);
+  }
 
   switch (data[n]) {
     case kNoCompression:
@@ -115,30 +119,130 @@ Status ReadBlock(RandomAccessFile* file,
 
       // Ok
       break;
+    case kSnappyCompression: {
+      s = UncompressBlock(Slice(data, n + 1), result);
+      delete[] buf;
+      return s;
+    }
+    default:
+      delete[] buf;
+      return Status::Corruption("bad block type");
+  }
+
+  return Status::OK();
+}
+
+bool BlockChecksumMatches(const Slice& stored) {
+  assert(stored.size() >= kBlockTrailerSize);
+  const size_t n = stored.size() - kBlockTrailerSize;
+  const uint32_t crc = crc32c::Unmask(DecodeFixed32(stored.data() + n + 1));
+  return crc32c::Value(stored.data(), n + 1) == crc;
+}
+
+Status UncompressBlock(const Slice& stored, BlockContents* result) {
+  result->data = Slice();
+  result->cachable = false;
+  result->heap_allocated = false;
+  if (stored.empty()) {
+    return Status::Corruption("bad block type");
+  }
+  const char* data = stored.data();
+  const size_t n = stored.size() - 1;
+  switch (data[n]) {
+    case kNoCompression: {
+      char* ubuf = new char[n];
+      memcpy(ubuf, data, n);
+      result->data = Slice(ubuf, n);
+      break;
+    }
     case kSnappyCompression: {
       size_t ulength = 0;
       if (!port::Snappy_GetUncompressedLength(data, n, &ulength)) {
-        delete[] buf;
         return Status::Corruption("corrupted compressed block contents");
       }
       char* ubuf = new char[ulength];
       if (!port::Snappy_Uncompress(data, n, ubuf)) {
-        delete[] buf;
         delete[] ubuf;
         return Status::Corruption("corrupted compressed block contents");
       }
-      delete[] buf;
       result->data = Slice(ubuf, ulength);
-      result->heap_allocated = true;
-      result->cachable = true;
       break;
     }
     default:
-      delete[] buf;
       return Status::Corruption("bad block type");
   }
-
+  result->heap_allocated = true;
+  result->cachable = true;
   return Status::OK();
 }
 
+const char kPropertiesBlockName[] = "leveldb.properties";
+
+// Names of the entries of a properties block, in the bytewise order in
+// which they are added to it
+static const char kDataSize[] = "leveldb.data.size";
+static const char kDeletions[] = "leveldb.deletions";
+static const char kEntries[] = "leveldb.entries";
+static const char kLargestSeqno[] = "leveldb.largest.seqno";
+static const char kNumDataBlocks[] = "leveldb.num.data.blocks";
+static const char kRawKeySize[] = "leveldb.raw.key.size";
+static const char kRawValueSize[] = "leveldb.raw.value.size";
+static const char kSmallestSeqno[] = "leveldb.smallest.seqno";
+
+static void AddProperty(BlockBuilder* block, const char* name,
+                        uint64_t value) {
+  std::string encoding;
+  PutVarint64(&encoding, value);
+  block->Add(name, encoding);
+}
+
+void EncodeTableProperties(const TableProperties& props, BlockBuilder* block) {
+  AddProperty(block, kDataSize, props.data_size);
+  AddProperty(block, kDeletions, props.num_deletions);
+  AddProperty(block, kEntries, props.num_entries);
+  AddProperty(block, kLargestSeqno, props.largest_seqno);
+  AddProperty(block, kNumDataBlocks, props.num_data_blocks);
+  AddProperty(block, kRawKeySize, props.raw_key_size);
+  AddProperty(block, kRawValueSize, props.raw_value_size);
+  AddProperty(block, kSmallestSeqno, props.smallest_seqno);
+}
+
+Status DecodeTableProperties(const BlockContents& contents,
+                             TableProperties* props) {
+  struct {
+    const char* name;
+    uint64_t* value;
+  } fields[] = {
+    { kDataSize, &props->data_size },
+    { kDeletions, &props->num_deletions },
+    { kEntries, &props->num_entries },
+    { kLargestSeqno, &props->largest_seqno },
+    { kNumDataBlocks, &props->num_data_blocks },
+    { kRawKeySize, &props->raw_key_size },
+    { kRawValueSize, &props->raw_value_size },
+    { kSmallestSeqno, &props->smallest_seqno },
+  };
+
+  *props = TableProperties();
+  Block block(contents);
+  Iterator* iter = block.NewIterator(BytewiseComparator());
+  Status s;
+  for (iter->SeekToFirst(); s.ok() && iter->Valid(); iter->Next()) {
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+      if (iter->key() == Slice(fields[i].name)) {
+        Slice v = iter->value();
+        if (!GetVarint64(&v, fields[i].value)) {
+          s = Status::Corruption("bad table property", fields[i].name);
+        }
+        break;
+      }
+    }
+  }
+  if (s.ok()) {
+    s = iter->status();
+  }
+  delete iter;
+  return s;
+}
+
 }  // namespace leveldb
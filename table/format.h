@@ -10,10 +10,12 @@
 #include "leveldb/slice.h"
 #include "leveldb/status.h"
 #include "leveldb/table_builder.h"
+#include "leveldb/table_properties.h"
 //DHQ: Table相关的各种 class ，以及操作函数等，不是磁盘结构
 namespace leveldb {
 
 class Block;
+class BlockBuilder;
 class RandomAccessFile;
 struct ReadOptions;
 
@@ -90,11 +92,36 @@ struct BlockContents {
 };
 
 // Read the block identified by "handle" from "file".  On failure
-// return non-OK.  On success fill *result and return OK.
+// return non-OK.  On success fill *result and return OK.  If "stored" is
+// non-null, also sets *stored to the block as it is stored in the file,
+// followed by its trailer.
 Status ReadBlock(RandomAccessFile* file,
                  const ReadOptions& options,
                  const BlockHandle& handle,
-                 BlockContents* result);
+                 BlockContents* result,
+                 std::string* stored = nullptr);
+
+// Return true if the checksum in the trailer of "stored", a block as it is
+// stored in a table followed by its trailer, matches the block.
+bool BlockChecksumMatches(const Slice& stored);
+
+// Set *result to the uncompressed contents of "stored", the contents of
+// a block as stored in a table followed by its compression type byte.
+// The result is heap allocated and cachable.
+Status UncompressBlock(const Slice& stored, BlockContents* result);
+
+// Key of the metaindex entry that locates the properties block
+extern const char kPropertiesBlockName[];
+
+// Add the entries of a properties block holding "props" to *block, which
+// must be empty and compare its keys bytewise.
+void EncodeTableProperties(const TableProperties& props, BlockBuilder* block);
+
+// Set *props to the properties stored in the block "contents".  Entries
+// written by newer versions are ignored.  Takes ownership of the heap
+// allocated data of "contents".
+Status DecodeTableProperties(const BlockContents& contents,
+                             TableProperties* props);
 //DHQ: 读入Block
 // Implementation details follow.  Clients should ignore,
 
@@ -23,6 +23,10 @@ Iterator::~Iterator() {
   }
 }
 
+Status Iterator::Refresh() {
+  return Status::NotSupported("Refresh() is not supported");
+}
+
 void Iterator::RegisterCleanup(CleanupFunction func, void* arg1, void* arg2) {
   assert(func != nullptr);
   CleanupNode* node;
@@ -36,6 +36,13 @@ class IteratorWrapper {
     }
   }
 
+  // Stops owning the iterator and returns it.  The wrapper is left empty.
+  Iterator* Release() {
+    Iterator* iter = iter_;
+    iter_ = nullptr;
+    valid_ = false;
+    return iter;
+  }
 
   // Iterator interface methods
   bool Valid() const        { return valid_; }
@@ -4,6 +4,7 @@
 
 #include "table/merger.h"
 
+#include <vector>
 #include "leveldb/comparator.h"
 #include "leveldb/iterator.h"
 #include "table/iterator_wrapper.h"
@@ -13,18 +14,26 @@ namespace leveldb {
 namespace {
 class MergingIterator : public Iterator {
  public:
-  MergingIterator(const Comparator* comparator, Iterator** children, int n)
+  MergingIterator(const Comparator* comparator, Iterator** children, int n,
+                  bool owns_children)
       : comparator_(comparator),
         children_(new IteratorWrapper[n]),
         n_(n),
+        owns_children_(owns_children),
         current_(nullptr),
         direction_(kForward) {
     for (int i = 0; i < n; i++) {
       children_[i].Set(children[i]);
     }
+    heap_.reserve(n);
   }
 
   virtual ~MergingIterator() {
+    if (!owns_children_) {
+      for (int i = 0; i < n_; i++) {
+        children_[i].Release();
+      }
+    }
     delete[] children_;
   }
 
@@ -36,24 +45,24 @@ class MergingIterator : public Iterator {
     for (int i = 0; i < n_; i++) {//DHQ: 各个iter是独立的，分别SeekToFirst即可
       children_[i].SeekToFirst();
     }
-    FindSmallest();//DHQ: 取最小的一个
     direction_ = kForward;
+    BuildHeap();
   }
 
   virtual void SeekToLast() {
     for (int i = 0; i < n_; i++) {
       children_[i].SeekToLast();
     }
-    FindLargest();//DHQ: 取最大的一个
     direction_ = kReverse;//DHQ: 设置了 kReverse
+    BuildHeap();
   }
 
   virtual void Seek(const Slice& target) {
     for (int i = 0; i < n_; i++) {
       children_[i].Seek(target);
     }
-    FindSmallest();
     direction_ = kForward;
+    BuildHeap();
   }
 
   virtual void Next() {
@@ -78,10 +87,14 @@ class MergingIterator : public Iterator {
         }
       }
       direction_ = kForward;
+      // The heap is ordered for the other direction, so rebuild it.
+      current_->Next();
+      BuildHeap();
+      return;
     }
 
     current_->Next();
-    FindSmallest();
+    ReplaceTop();
   }
 
   virtual void Prev() {
@@ -107,10 +120,14 @@ class MergingIterator : public Iterator {
         }
       }
       direction_ = kReverse;
+      // The heap is ordered for the other direction, so rebuild it.
+      current_->Prev();
+      BuildHeap();
+      return;
     }
 
     current_->Prev();
-    FindLargest();
+    ReplaceTop();
   }
 
   virtual Slice key() const {
@@ -135,17 +152,36 @@ class MergingIterator : public Iterator {
   }
 
  private:
-  void FindSmallest();
-  void FindLargest();
+  // Return true iff "a" should be yielded before "b" in the current
+  // direction.  Children holding equal keys are yielded in index order
+  // going forward and in reverse index order going backward.
+  bool Before(const IteratorWrapper* a, const IteratorWrapper* b) const {
+    int r = comparator_->Compare(a->key(), b->key());
+    if (direction_ == kReverse) {
+      r = -r;
+    }
+    if (r != 0) {
+      return r < 0;
+    }
+    return (direction_ == kForward) ? (a < b) : (a > b);
+  }
+
+  void BuildHeap();
+  void ReplaceTop();
+  void SiftDown(size_t pos);
 
-  // We might want to use a heap in case there are lots of children.
-  // For now we use a simple array since we expect a very small number
-  // of children in leveldb.
   const Comparator* comparator_;
   IteratorWrapper* children_;
   int n_;
+  const bool owns_children_;
   IteratorWrapper* current_;
 
+  // Binary heap of the valid children, ordered by Before() so that the
+  // child to yield next is at heap_[0].  Advancing current_ only needs
+  // O(log n) comparisons to restore the heap, where a linear scan would
+  // compare against every child.
+  std::vector<IteratorWrapper*> heap_;
+
   // Which direction is the iterator moving?
   enum Direction {
     kForward,
@@ -154,34 +190,51 @@ class MergingIterator : public Iterator {
   Direction direction_;
 };
 
-void MergingIterator::FindSmallest() {
-  IteratorWrapper* smallest = nullptr;
+void MergingIterator::BuildHeap() {
+  heap_.clear();
   for (int i = 0; i < n_; i++) {
-    IteratorWrapper* child = &children_[i];
-    if (child->Valid()) {//DHQ: 如果某个child iter->Next()后，变成invalid，那么说明它已经遍历完了，就是结束了。
-      if (smallest == nullptr) {
-        smallest = child;
-      } else if (comparator_->Compare(child->key(), smallest->key()) < 0) {
-        smallest = child;
-      }
+    if (children_[i].Valid()) {
+      heap_.push_back(&children_[i]);
     }
   }
-  current_ = smallest;
+  for (size_t i = heap_.size() / 2; i > 0; i--) {
+    SiftDown(i - 1);
+  }
+  current_ = heap_.empty() ? nullptr : heap_[0];
 }
 
-void MergingIterator::FindLargest() {
-  IteratorWrapper* largest = nullptr;
-  for (int i = n_-1; i >= 0; i--) {
-    IteratorWrapper* child = &children_[i];
-    if (child->Valid()) {
-      if (largest == nullptr) {
-        largest = child;
-      } else if (comparator_->Compare(child->key(), largest->key()) > 0) {
-        largest = child;
-      }
+// Restore the heap after current_ (the top) has been advanced.
+void MergingIterator::ReplaceTop() {
+  assert(!heap_.empty() && heap_[0] == current_);
+  if (!current_->Valid()) {
+    // The child is exhausted: drop it from the heap
+    heap_[0] = heap_.back();
+    heap_.pop_back();
+  }
+  if (!heap_.empty()) {
+    SiftDown(0);
+  }
+  current_ = heap_.empty() ? nullptr : heap_[0];
+}
+
+void MergingIterator::SiftDown(size_t pos) {
+  const size_t size = heap_.size();
+  IteratorWrapper* const item = heap_[pos];
+  while (true) {
+    size_t child = 2 * pos + 1;
+    if (child >= size) {
+      break;
     }
+    if (child + 1 < size && Before(heap_[child + 1], heap_[child])) {
+      child++;
+    }
+    if (!Before(heap_[child], item)) {
+      break;
+    }
+    heap_[pos] = heap_[child];
+    pos = child;
   }
-  current_ = largest;
+  heap_[pos] = item;
 }
 }  // namespace
 
@@ -192,7 +245,17 @@ Iterator* NewMergingIterator(const Comparator* cmp, Iterator** list, int n) {
   } else if (n == 1) {
     return list[0];
   } else {
-    return new MergingIterator(cmp, list, n);
+    return new MergingIterator(cmp, list, n, true);
+  }
+}
+
+Iterator* NewBorrowingMergingIterator(const Comparator* cmp,
+                                      Iterator** list, int n) {
+  assert(n >= 0);
+  if (n == 0) {
+    return NewEmptyIterator();
+  } else {
+    return new MergingIterator(cmp, list, n, false);
   }
 }
 
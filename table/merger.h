@@ -21,6 +21,12 @@ class Iterator;
 Iterator* NewMergingIterator(
     const Comparator* comparator, Iterator** children, int n);
 
+// Like NewMergingIterator(), but the caller keeps ownership of the child
+// iterators, which must outlive the result.  Lets the caller merge the
+// same children again in another combination.
+Iterator* NewBorrowingMergingIterator(
+    const Comparator* comparator, Iterator** children, int n);
+
 }  // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_TABLE_MERGER_H_
@@ -9,32 +9,181 @@
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/persistent_cache.h"
+#include "leveldb/slice_transform.h"
+#include "leveldb/table_properties.h"
 #include "table/block.h"
 #include "table/filter_block.h"
 #include "table/format.h"
 #include "table/two_level_iterator.h"
 #include "util/coding.h"
+#include "util/readahead_file.h"
 
 namespace leveldb {
 
+// Value stored in the block cache for a cached filter block.
+struct CachedFilter {
+  FilterBlockReader* reader;
+  const char* data;  // Backing store for reader if heap allocated, else null
+};
+
+static void DeleteBlock(void* arg, void* ignored) {
+  delete reinterpret_cast<Block*>(arg);
+}
+
+static void DeleteCachedBlock(const Slice& key, void* value) {
+  Block* block = reinterpret_cast<Block*>(value);
+  delete block;
+}
+
+static void DeleteCachedFilter(const Slice& key, void* value) {
+  CachedFilter* filter = reinterpret_cast<CachedFilter*>(value);
+  delete filter->reader;
+  delete[] filter->data;
+  delete filter;
+}
+
+static void ReleaseBlock(void* arg, void* h) {
+  Cache* cache = reinterpret_cast<Cache*>(arg);
+  Cache::Handle* handle = reinterpret_cast<Cache::Handle*>(h);
+  cache->Release(handle);
+}
+
 struct Table::Rep {
   ~Rep() {
+    Cache* block_cache = options.block_cache;
+    char cache_key_buffer[16];
+    if (pinned_index != nullptr) {
+      block_cache->Release(pinned_index);
+    }
+    if (pinned_filter != nullptr) {
+      block_cache->Release(pinned_filter);
+    }
+    // Nobody else can look up our cached index and filter blocks, and
+    // they were inserted with high priority, so drop them right away
+    // instead of waiting for them to age out.
+    if (index_block == nullptr) {
+      block_cache->Erase(CacheKey(index_handle, cache_key_buffer));
+    }
+    if (filter_in_cache) {
+      block_cache->Erase(CacheKey(filter_handle, cache_key_buffer));
+    }
     delete filter;
     delete [] filter_data;
     delete index_block;
   }
 
+  // Returns the key under which the block at "handle" is stored in
+  // options.block_cache.  Uses *buf (16 bytes) as backing store.
+  Slice CacheKey(const BlockHandle& handle, char* buf) const {
+    EncodeFixed64(buf, cache_id);
+    EncodeFixed64(buf+8, handle.offset());
+    return Slice(buf, 16);
+  }
+
+  Status GetIndexBlock(Block** block, Cache::Handle** cache_handle);
+  FilterBlockReader* GetFilter(Cache::Handle** cache_handle);
+
   Options options;
   Status status;
   RandomAccessFile* file;
+  uint64_t file_size;
   uint64_t cache_id;
+  uint64_t compressed_cache_id;  // Key prefix in options.compressed_block_cache
+  std::string persistent_cache_prefix;  // Key prefix in
+                                       // options.persistent_cache, or
+                                       // empty if the table does not use it
   FilterBlockReader* filter;
   const char* filter_data;
 
   BlockHandle metaindex_handle;  // Handle to metaindex_block: saved from footer
-  Block* index_block;
+  Block* index_block;  // nullptr iff the index block lives in block_cache
+
+  // Location of the index and filter blocks, used to (re)load them into
+  // block_cache when options.cache_index_and_filter_blocks is set.
+  BlockHandle index_handle;
+  BlockHandle filter_handle;
+  bool filter_in_cache;  // Filter lives in block_cache rather than "filter"
+  bool full_filter;      // Filter covers the whole table (see FilterBlockReader)
+  bool prefix_filtered;  // Filter holds prefixes from options.prefix_extractor
+  bool has_properties;   // "properties" were read from the table
+  TableProperties properties;
+
+  // Handles held for the lifetime of the table (see PinIndexAndFilterBlocks)
+  Cache::Handle* pinned_index;
+  Cache::Handle* pinned_filter;
 };
 
+// Sets *block to the index block.  If the block is served from the block
+// cache, also sets *cache_handle, which the caller must release once done
+// with *block; otherwise sets *cache_handle to nullptr.
+Status Table::Rep::GetIndexBlock(Block** block, Cache::Handle** cache_handle) {
+  *cache_handle = nullptr;
+  if (index_block != nullptr) {
+    *block = index_block;
+    return Status::OK();
+  }
+  Cache* block_cache = options.block_cache;
+  if (pinned_index != nullptr) {
+    *block = reinterpret_cast<Block*>(block_cache->Value(pinned_index));
+    return Status::OK();
+  }
+
+  char cache_key_buffer[16];
+  Slice key = CacheKey(index_handle, cache_key_buffer);
+  *cache_handle = block_cache->Lookup(key);
+  if (*cache_handle == nullptr) {
+    ReadOptions opt;
+    opt.verify_checksums = options.paranoid_checks;
+    BlockContents contents;
+    Status s = ReadBlock(file, opt, index_handle, &contents);
+    if (!s.ok()) {
+      return s;
+    }
+    Block* b = new Block(contents);
+    *cache_handle = block_cache->Insert(key, b, b->size(), &DeleteCachedBlock,
+                                        Cache::kHighPriority);
+  }
+  *block = reinterpret_cast<Block*>(block_cache->Value(*cache_handle));
+  return Status::OK();
+}
+
+// Returns the filter for this table, or nullptr if there is none or it
+// could not be read.  Sets *cache_handle as for GetIndexBlock().
+FilterBlockReader* Table::Rep::GetFilter(Cache::Handle** cache_handle) {
+  *cache_handle = nullptr;
+  if (!filter_in_cache) {
+    return filter;
+  }
+  Cache* block_cache = options.block_cache;
+  if (pinned_filter != nullptr) {
+    return reinterpret_cast<CachedFilter*>(
+        block_cache->Value(pinned_filter))->reader;
+  }
+
+  char cache_key_buffer[16];
+  Slice key = CacheKey(filter_handle, cache_key_buffer);
+  *cache_handle = block_cache->Lookup(key);
+  if (*cache_handle == nullptr) {
+    ReadOptions opt;
+    opt.verify_checksums = options.paranoid_checks;
+    BlockContents block;
+    if (!ReadBlock(file, opt, filter_handle, &block).ok()) {
+      // Like a missing filter, a filter we cannot read is not an error
+      return nullptr;
+    }
+    CachedFilter* f = new CachedFilter;
+    f->reader = new FilterBlockReader(options.filter_policy, block.data,
+                                      full_filter);
+    f->data = block.heap_allocated ? block.data.data() : nullptr;
+    *cache_handle = block_cache->Insert(key, f, block.data.size(),
+                                        &DeleteCachedFilter,
+                                        Cache::kHighPriority);
+  }
+  return reinterpret_cast<CachedFilter*>(
+      block_cache->Value(*cache_handle))->reader;
+}
+
 Status Table::Open(const Options& options,
                    RandomAccessFile* file,
                    uint64_t size,
@@ -68,14 +217,34 @@ Status Table::Open(const Options& options,
     // We've successfully read the footer and the index block: we're
     // ready to serve requests.
     Block* index_block = new Block(index_block_contents); //DHQ: block结构，主要用于读取。先从盘上获取内容，在构造Block结构。
-    Rep* rep = new Table::Rep; //DHQ: index_block，并没有放到 Cache中
+    Rep* rep = new Table::Rep;
     rep->options = options;
     rep->file = file;
+    rep->file_size = size;
     rep->metaindex_handle = footer.metaindex_handle();
     rep->index_block = index_block;
+    rep->index_handle = footer.index_handle();
     rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
+    rep->compressed_cache_id = (options.compressed_block_cache ?
+                                options.compressed_block_cache->NewId() : 0);
     rep->filter_data = nullptr;
     rep->filter = nullptr;
+    rep->filter_in_cache = false;
+    rep->full_filter = false;
+    rep->prefix_filtered = false;
+    rep->has_properties = false;
+    rep->pinned_index = nullptr;
+    rep->pinned_filter = nullptr;
+    if (options.cache_index_and_filter_blocks &&
+        options.block_cache != nullptr && index_block_contents.cachable) {
+      // Hand the index block over to the block cache.  Blocks that are not
+      // cachable (e.g. they point into an mmap()ed file) stay with the table.
+      char cache_key_buffer[16];
+      options.block_cache->Release(options.block_cache->Insert(
+          rep->CacheKey(rep->index_handle, cache_key_buffer), index_block,
+          index_block->size(), &DeleteCachedBlock, Cache::kHighPriority));
+      rep->index_block = nullptr;
+    }
     *table = new Table(rep);//DHQ: new table并返回
     (*table)->ReadMeta(footer);
   }
@@ -84,10 +253,6 @@ Status Table::Open(const Options& options,
 }
 //DHQ: 读取 bloom filter 等 meta，不是index
 void Table::ReadMeta(const Footer& footer) {
-  if (rep_->options.filter_policy == nullptr) {
-    return;  // Do not need any metadata
-  }
-
   // TODO(sanjay): Skip this if footer.metaindex_handle() size indicates
   // it is an empty block.
   ReadOptions opt;
@@ -102,17 +267,41 @@ void Table::ReadMeta(const Footer& footer) {
   Block* meta = new Block(contents);
   //DHQ: 这个实际是时MetaBlock Index的 iter,
   Iterator* iter = meta->NewIterator(BytewiseComparator());
-  std::string key = "filter.";
+  iter->Seek(kPropertiesBlockName);
+  if (iter->Valid() && iter->key() == Slice(kPropertiesBlockName)) {
+    ReadProperties(iter->value());
+  }
+  if (rep_->options.filter_policy == nullptr) {
+    delete iter;
+    delete meta;
+    return;  // Do not need the filter
+  }
+
+  // A table has at most one of the two filter kinds; prefer the full one.
+  std::string key = "fullfilter.";
   key.append(rep_->options.filter_policy->Name());
   iter->Seek(key); //目前应该只处理了 filter metadata
   if (iter->Valid() && iter->key() == Slice(key)) {
-    ReadFilter(iter->value());
+    ReadFilter(iter->value(), true);
+  } else {
+    key = "filter.";
+    key.append(rep_->options.filter_policy->Name());
+    iter->Seek(key);
+    if (iter->Valid() && iter->key() == Slice(key)) {
+      ReadFilter(iter->value(), false);
+    }
+  }
+  if (rep_->options.prefix_extractor != nullptr) {
+    key = "prefix.";
+    key.append(rep_->options.prefix_extractor->Name());
+    iter->Seek(key);
+    rep_->prefix_filtered = iter->Valid() && iter->key() == Slice(key);
   }
   delete iter;
   delete meta;
 }
 
-void Table::ReadFilter(const Slice& filter_handle_value) {
+void Table::ReadFilter(const Slice& filter_handle_value, bool full_filter) {
   Slice v = filter_handle_value;
   BlockHandle filter_handle;
   if (!filter_handle.DecodeFrom(&v).ok()) {
@@ -129,39 +318,219 @@ void Table::ReadFilter(const Slice& filter_handle_value) {
   if (!ReadBlock(rep_->file, opt, filter_handle, &block).ok()) {
     return;
   }
+  rep_->full_filter = full_filter;
+  Cache* block_cache = rep_->options.block_cache;
+  if (rep_->options.cache_index_and_filter_blocks && block_cache != nullptr &&
+      block.heap_allocated) {
+    CachedFilter* f = new CachedFilter;
+    f->reader = new FilterBlockReader(rep_->options.filter_policy, block.data,
+                                      full_filter);
+    f->data = block.data.data();
+    rep_->filter_handle = filter_handle;
+    rep_->filter_in_cache = true;
+    char cache_key_buffer[16];
+    block_cache->Release(block_cache->Insert(
+        rep_->CacheKey(filter_handle, cache_key_buffer), f, block.data.size(),
+        &DeleteCachedFilter, Cache::kHighPriority));
+    return;
+  }
   if (block.heap_allocated) {
     rep_->filter_data = block.data.data();     // Will need to delete later
   }
-  rep_->filter = new FilterBlockReader(rep_->options.filter_policy, block.data);
+  rep_->filter = new FilterBlockReader(rep_->options.filter_policy, block.data,
+                                       full_filter);
 }
 
-Table::~Table() {
-  delete rep_;
+void Table::ReadProperties(const Slice& properties_handle_value) {
+  Slice v = properties_handle_value;
+  BlockHandle properties_handle;
+  if (!properties_handle.DecodeFrom(&v).ok()) {
+    return;
+  }
+  ReadOptions opt;
+  if (rep_->options.paranoid_checks) {
+    opt.verify_checksums = true;
+  }
+  BlockContents block;
+  if (ReadBlock(rep_->file, opt, properties_handle, &block).ok()) {
+    // Like a missing filter, properties we cannot read are not an error
+    rep_->has_properties =
+        DecodeTableProperties(block, &rep_->properties).ok();
+  }
 }
 
-static void DeleteBlock(void* arg, void* ignored) {
-  delete reinterpret_cast<Block*>(arg);
+const TableProperties* Table::properties() const {
+  return rep_->has_properties ? &rep_->properties : nullptr;
 }
 
-static void DeleteCachedBlock(const Slice& key, void* value) {
-  Block* block = reinterpret_cast<Block*>(value);
-  delete block;
+Table::~Table() {
+  delete rep_;
 }
 
-static void ReleaseBlock(void* arg, void* h) {
-  Cache* cache = reinterpret_cast<Cache*>(arg);
-  Cache::Handle* handle = reinterpret_cast<Cache::Handle*>(h);
-  cache->Release(handle);
+void Table::SetPersistentCacheKeyPrefix(const Slice& prefix) {
+  assert(!prefix.empty());
+  rep_->persistent_cache_prefix = prefix.ToString();
+}
+
+void Table::PinIndexAndFilterBlocks() {
+  Rep* r = rep_;
+  if (r->index_block == nullptr && r->pinned_index == nullptr) {
+    Block* ignored;
+    Cache::Handle* handle;
+    if (r->GetIndexBlock(&ignored, &handle).ok()) {
+      r->pinned_index = handle;
+    }
+  }
+  if (r->filter_in_cache && r->pinned_filter == nullptr) {
+    Cache::Handle* handle;
+    r->GetFilter(&handle);
+    r->pinned_filter = handle;
+  }
 }
 //DHQ: 根据index iter的value，读取data block，返回data block的iter
 // Convert an index iterator value (i.e., an encoded BlockHandle)
 // into an iterator over the contents of the corresponding block.
 Iterator* Table::BlockReader(void* arg,
-
                              const ReadOptions& options,
                              const Slice& index_value) {
   Table* table = reinterpret_cast<Table*>(arg);
-  Cache* block_cache = table->rep_->options.block_cache;
+  return table->DataBlockIterator(table->rep_->file, options, index_value,
+                                  Cache::kLowPriority);
+}
+
+namespace {
+
+// Argument of Table::ReadaheadBlockReader(): the table and the file
+// through which one iterator reads its data blocks.
+struct ReadaheadState {
+  Table* table;
+  RandomAccessFile* file;
+};
+
+static void DeleteReadaheadState(void* arg, void* ignored) {
+  ReadaheadState* state = reinterpret_cast<ReadaheadState*>(arg);
+  delete state->file;
+  delete state;
+}
+
+}  // namespace
+
+Iterator* Table::ReadaheadBlockReader(void* arg,
+                                      const ReadOptions& options,
+                                      const Slice& index_value) {
+  ReadaheadState* state = reinterpret_cast<ReadaheadState*>(arg);
+  return state->table->DataBlockIterator(state->file, options, index_value,
+                                         Cache::kLowPriority);
+}
+
+bool Table::ReadaheadPrefixMayMatchBlock(void* arg, const Slice& key,
+                                         const Slice& index_value) {
+  ReadaheadState* state = reinterpret_cast<ReadaheadState*>(arg);
+  return state->table->PrefixMayMatch(key, &index_value);
+}
+
+// Runs on the prefetch thread of the two-level iterator, so reads through
+// rep_->file rather than the iterator's own readahead file.  Errors are
+// ignored: the iterator reports them when it reads the block itself.
+// The block is cached as not yet used, so that the iterator's own lookup
+// of it is not taken for a second use.
+void Table::PrefetchBlock(void* arg,
+                          const ReadOptions& options,
+                          const Slice& index_value) {
+  Table* table = reinterpret_cast<Table*>(arg);
+  delete table->DataBlockIterator(table->rep_->file, options, index_value,
+                                  Cache::kPrefetched);
+}
+
+void Table::ReadaheadPrefetchBlock(void* arg,
+                                   const ReadOptions& options,
+                                   const Slice& index_value) {
+  ReadaheadState* state = reinterpret_cast<ReadaheadState*>(arg);
+  PrefetchBlock(state->table, options, index_value);
+}
+
+static void DeleteCompressedBlock(const Slice& key, void* value) {
+  delete reinterpret_cast<std::string*>(value);
+}
+
+// Reads the data block at "handle" from options.compressed_block_cache or
+// options.persistent_cache if it is there, and otherwise from "file".
+// Blocks read from the file are added to the persistent cache, and blocks
+// that are stored compressed to the compressed cache.
+Status Table::ReadDataBlock(RandomAccessFile* file,
+                            const ReadOptions& options,
+                            const BlockHandle& handle,
+                            BlockContents* contents) const {
+  Cache* compressed_cache = rep_->options.compressed_block_cache;
+  PersistentCache* persistent_cache =
+      (!rep_->persistent_cache_prefix.empty()
+       ? rep_->options.persistent_cache : nullptr);
+  if (compressed_cache == nullptr && persistent_cache == nullptr) {
+    return ReadBlock(file, options, handle, contents);
+  }
+
+  char cache_key_buffer[16];
+  EncodeFixed64(cache_key_buffer+8, handle.offset());
+  Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+  if (compressed_cache != nullptr) {
+    EncodeFixed64(cache_key_buffer, rep_->compressed_cache_id);
+    Cache::Handle* cache_handle = compressed_cache->Lookup(key);
+    if (cache_handle != nullptr) {
+      const std::string* stored = reinterpret_cast<std::string*>(
+          compressed_cache->Value(cache_handle));
+      Status s = UncompressBlock(*stored, contents);
+      compressed_cache->Release(cache_handle);
+      return s;
+    }
+  }
+
+  // "stored" holds the block as it is stored in the file, followed by
+  // its trailer, which the persistent cache keeps so that hits can be
+  // verified like reads from the file.
+  const size_t n = static_cast<size_t>(handle.size());
+  std::string stored;
+  Status s;
+  bool found = false;
+  std::string persistent_key;
+  if (persistent_cache != nullptr) {
+    persistent_key = rep_->persistent_cache_prefix;
+    PutFixed64(&persistent_key, handle.offset());
+    // A corrupted entry is replaced by the block read from the file.
+    found = persistent_cache->Lookup(persistent_key, &stored).ok() &&
+            stored.size() == n + kBlockTrailerSize &&
+            (!options.verify_checksums || BlockChecksumMatches(stored)) &&
+            UncompressBlock(Slice(stored.data(), n + 1), contents).ok();
+  }
+  if (!found) {
+    s = ReadBlock(file, options, handle, contents, &stored);
+    if (!s.ok() || !options.fill_cache) {
+      return s;
+    }
+    if (persistent_cache != nullptr) {
+      // Errors only cost hits
+      persistent_cache->Insert(persistent_key, stored);
+    }
+  }
+
+  if (compressed_cache != nullptr && options.fill_cache &&
+      stored[n] != static_cast<char>(kNoCompression)) {
+    EncodeFixed64(cache_key_buffer, rep_->compressed_cache_id);
+    std::string* value = new std::string;
+    stored.resize(n + 1);  // The block and its type, for UncompressBlock()
+    value->swap(stored);
+    compressed_cache->Release(compressed_cache->Insert(
+        key, value, value->size(), &DeleteCompressedBlock));
+  }
+  return s;
+}
+
+// Reads the block through "file", which is either rep_->file or a
+// readahead wrapper of it, and caches it with "priority".
+Iterator* Table::DataBlockIterator(RandomAccessFile* file,
+                                   const ReadOptions& options,
+                                   const Slice& index_value,
+                                   Cache::Priority priority) const {
+  Cache* block_cache = rep_->options.block_cache;
   Block* block = nullptr;
   Cache::Handle* cache_handle = nullptr;
 
@@ -175,24 +544,24 @@ Iterator* Table::BlockReader(void* arg,
     BlockContents contents;
     if (block_cache != nullptr) {
       char cache_key_buffer[16];
-      EncodeFixed64(cache_key_buffer, table->rep_->cache_id);//DHQ: 为什么搞个cache_id? 不直接用sst file id? 比较奇怪
+      EncodeFixed64(cache_key_buffer, rep_->cache_id);//DHQ: 为什么搞个cache_id? 不直接用sst file id? 比较奇怪
       EncodeFixed64(cache_key_buffer+8, handle.offset());
       Slice key(cache_key_buffer, sizeof(cache_key_buffer));
       cache_handle = block_cache->Lookup(key);
       if (cache_handle != nullptr) {//DHQ: 从block_cache找到了
         block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
       } else {//DHQ: 未找到，读取后，插入进block_cache
-        s = ReadBlock(table->rep_->file, options, handle, &contents);
+        s = ReadDataBlock(file, options, handle, &contents);
         if (s.ok()) {
           block = new Block(contents);
           if (contents.cachable && options.fill_cache) {
             cache_handle = block_cache->Insert(//会insert到block_cache，如果有block_cache
-                key, block, block->size(), &DeleteCachedBlock);
+                key, block, block->size(), &DeleteCachedBlock, priority);
           }
         }
       }
     } else {//DHQ: 完全没有block_cache，直接读
-      s = ReadBlock(table->rep_->file, options, handle, &contents);
+      s = ReadDataBlock(file, options, handle, &contents);
       if (s.ok()) {
         block = new Block(contents);
       }
@@ -201,7 +570,7 @@ Iterator* Table::BlockReader(void* arg,
 
   Iterator* iter;
   if (block != nullptr) {//DHQ: 调用 block 的 NewIterator
-    iter = block->NewIterator(table->rep_->options.comparator);
+    iter = block->NewIterator(rep_->options.comparator);
     if (cache_handle == nullptr) {
       iter->RegisterCleanup(&DeleteBlock, block, nullptr);//DHQ: delete block自身
     } else {//DHQ: 如果有cache_handle，那么需要注册cache的clean函数，不能直接delete
@@ -213,21 +582,107 @@ Iterator* Table::BlockReader(void* arg,
   return iter;
 }
 //DHQ: 注意Table的 Iterator实现
+Iterator* Table::NewIndexIterator() const {
+  Block* index_block;
+  Cache::Handle* cache_handle;
+  Status s = rep_->GetIndexBlock(&index_block, &cache_handle);
+  if (!s.ok()) {
+    return NewErrorIterator(s);
+  }
+  Iterator* iter = index_block->NewIterator(rep_->options.comparator);
+  if (cache_handle != nullptr) {
+    iter->RegisterCleanup(&ReleaseBlock, rep_->options.block_cache,
+                          cache_handle);
+  }
+  return iter;
+}
+
 Iterator* Table::NewIterator(const ReadOptions& options) const {
+  // Prefetching is pointless if the block cannot be kept for the iterator
+  const bool prefetch = (options.async_prefetch &&
+                         rep_->options.block_cache != nullptr);
+  if (options.readahead_size > 0) {
+    // Give the iterator a file of its own that reads ahead
+    ReadaheadState* state = new ReadaheadState;
+    state->table = const_cast<Table*>(this);
+    state->file = NewReadaheadRandomAccessFile(rep_->file, rep_->file_size,
+                                               options.readahead_size);
+    Iterator* iter = NewTwoLevelIterator(
+        NewIndexIterator(), &Table::ReadaheadBlockReader, state, options,
+        rep_->prefix_filtered ? &Table::ReadaheadPrefixMayMatchBlock : nullptr,
+        rep_->options.comparator,
+        prefetch ? &Table::ReadaheadPrefetchBlock : nullptr);
+    iter->RegisterCleanup(&DeleteReadaheadState, state, nullptr);
+    return iter;
+  }
   return NewTwoLevelIterator(//DHQ: 整体是个两层的
-      rep_->index_block->NewIterator(rep_->options.comparator),
-      &Table::BlockReader, const_cast<Table*>(this), options);
+      NewIndexIterator(),
+      &Table::BlockReader, const_cast<Table*>(this), options,
+      rep_->prefix_filtered ? &Table::PrefixMayMatchBlock : nullptr,
+      rep_->options.comparator,
+      prefetch ? &Table::PrefetchBlock : nullptr);
+}
+
+bool Table::PrefixMayMatch(const Slice& key, const Slice* index_value) const {
+  const SliceTransform* prefix_extractor = rep_->options.prefix_extractor;
+  if (!rep_->prefix_filtered || !prefix_extractor->InDomain(key)) {
+    return true;
+  }
+  const Slice prefix = prefix_extractor->Transform(key);
+
+  bool may_match = true;
+  Cache::Handle* filter_cache_handle;
+  FilterBlockReader* filter = rep_->GetFilter(&filter_cache_handle);
+  if (filter == nullptr) {
+    // No filter to consult
+  } else if (filter->full_filter()) {
+    may_match = filter->KeyMayMatch(prefix);
+  } else if (index_value != nullptr) {
+    Slice input = *index_value;
+    BlockHandle handle;
+    if (handle.DecodeFrom(&input).ok()) {
+      may_match = filter->KeyMayMatch(handle.offset(), prefix);
+    }
+  }
+  if (filter_cache_handle != nullptr) {
+    rep_->options.block_cache->Release(filter_cache_handle);
+  }
+  return may_match;
+}
+
+bool Table::PrefixMayMatchBlock(void* arg, const Slice& key,
+                                const Slice& index_value) {
+  return reinterpret_cast<Table*>(arg)->PrefixMayMatch(key, &index_value);
 }
 
 Status Table::InternalGet(const ReadOptions& options, const Slice& k,
                           void* arg,
-                          void (*saver)(void*, const Slice&, const Slice&)) {
+                          void (*saver)(void*, const Slice&, const Slice&),
+                          Iterator** pinned) {
+  if (pinned != nullptr) {
+    *pinned = nullptr;
+  }
   Status s;
-  Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+  Cache::Handle* filter_cache_handle;
+  FilterBlockReader* filter = rep_->GetFilter(&filter_cache_handle);
+  if (filter != nullptr && filter->full_filter()) {
+    // A whole-table filter can rule the table out without touching
+    // the index block.
+    bool may_match = filter->KeyMayMatch(k);
+    if (filter_cache_handle != nullptr) {
+      rep_->options.block_cache->Release(filter_cache_handle);
+      filter_cache_handle = nullptr;
+    }
+    if (!may_match) {
+      return s;
+    }
+    filter = nullptr;
+  }
+
+  Iterator* iiter = NewIndexIterator();
   iiter->Seek(k);
   if (iiter->Valid()) {
     Slice handle_value = iiter->value();
-    FilterBlockReader* filter = rep_->filter;
     BlockHandle handle;
     if (filter != nullptr &&
         handle.DecodeFrom(&handle_value).ok() &&
@@ -238,11 +693,20 @@ Status Table::InternalGet(const ReadOptions& options, const Slice& k,
       block_iter->Seek(k); //DHQ: 这个值，其实不是准确的。外面会判断到底是不是想要的key.
       if (block_iter->Valid()) {
         (*saver)(arg, block_iter->key(), block_iter->value());
+        if (pinned != nullptr) {
+          *pinned = block_iter;  // Keeps the block alive
+          block_iter = nullptr;
+        }
+      }
+      if (block_iter != nullptr) {
+        s = block_iter->status();
+        delete block_iter;
       }
-      s = block_iter->status();
-      delete block_iter;
     }
   }
+  if (filter_cache_handle != nullptr) {
+    rep_->options.block_cache->Release(filter_cache_handle);
+  }
   if (s.ok()) {
     s = iiter->status();
   }
@@ -252,8 +716,7 @@ Status Table::InternalGet(const ReadOptions& options, const Slice& k,
 
 
 uint64_t Table::ApproximateOffsetOf(const Slice& key) const {
-  Iterator* index_iter =
-      rep_->index_block->NewIterator(rep_->options.comparator);
+  Iterator* index_iter = NewIndexIterator();
   index_iter->Seek(key);
   uint64_t result;
   if (index_iter->Valid()) {
@@ -9,6 +9,7 @@
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/slice_transform.h"
 #include "table/block_builder.h"
 #include "table/filter_block.h"
 #include "table/format.h"
@@ -29,6 +30,7 @@ struct TableBuilder::Rep {
   int64_t num_entries;
   bool closed;          // Either Finish() or Abandon() has been called.
   FilterBlockBuilder* filter_block;
+  TableProperties props;  // Written to the properties block by Finish()
 
   // We do not emit the index entry for a block until we have seen the
   // first key for the next data block.  This allows us to use shorter
@@ -54,7 +56,9 @@ struct TableBuilder::Rep {
         num_entries(0),
         closed(false),
         filter_block(opt.filter_policy == nullptr ? nullptr
-                     : new FilterBlockBuilder(opt.filter_policy)),
+                     : new FilterBlockBuilder(opt.filter_policy,
+                                              opt.full_filter,
+                                              opt.prefix_extractor)),
         pending_index_entry(false) {
     index_block_options.block_restart_interval = 1;
   }
@@ -89,6 +93,22 @@ Status TableBuilder::ChangeOptions(const Options& options) {
   return Status::OK();
 }
 
+void TableBuilder::Add(const Slice& key, const Slice& value,
+                       uint64_t sequence, bool deletion) {
+  Rep* r = rep_;
+  if (!ok()) return;
+  if (r->num_entries == 0 || sequence < r->props.smallest_seqno) {
+    r->props.smallest_seqno = sequence;
+  }
+  if (r->num_entries == 0 || sequence > r->props.largest_seqno) {
+    r->props.largest_seqno = sequence;
+  }
+  if (deletion) {
+    r->props.num_deletions++;
+  }
+  Add(key, value);
+}
+
 void TableBuilder::Add(const Slice& key, const Slice& value) {
   Rep* r = rep_;
   assert(!r->closed);
@@ -115,6 +135,8 @@ void TableBuilder::Add(const Slice& key, const Slice& value) {
 
   r->last_key.assign(key.data(), key.size());
   r->num_entries++;
+  r->props.raw_key_size += key.size();
+  r->props.raw_value_size += value.size();
   r->data_block.Add(key, value);
 
   const size_t estimated_block_size = r->data_block.CurrentSizeEstimate();
@@ -132,6 +154,8 @@ void TableBuilder::Flush() {//DHQ: flush的是 data block，不是整个table。
   // DHQ: WriteBlock里面修改了r->offset
   WriteBlock(&r->data_block, &r->pending_handle);
   if (ok()) {
+    r->props.data_size += r->pending_handle.size() + kBlockTrailerSize;
+    r->props.num_data_blocks++;
     r->pending_index_entry = true;
     r->status = r->file->Flush();
   }
@@ -206,7 +230,12 @@ Status TableBuilder::Finish() {
   assert(!r->closed);
   r->closed = true;
 
-  BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle;
+  BlockHandle filter_block_handle, properties_block_handle,
+      metaindex_block_handle, index_block_handle;
+
+  // The properties and metaindex blocks are read with a bytewise comparator
+  Options meta_options = r->options;
+  meta_options.comparator = BytewiseComparator();
 
   // Write filter block
   if (ok() && r->filter_block != nullptr) {
@@ -214,19 +243,41 @@ Status TableBuilder::Finish() {
                   &filter_block_handle); 
   }//DHQ: bloom filter等，没法压缩，直接 Raw 写
 
+  // Write properties block
+  if (ok()) {
+    r->props.num_entries = r->num_entries;
+    BlockBuilder properties_block(&meta_options);
+    EncodeTableProperties(r->props, &properties_block);
+    WriteBlock(&properties_block, &properties_block_handle);
+  }
+
   // Write metaindex block
   if (ok()) {
-    BlockBuilder meta_index_block(&r->options);
+    BlockBuilder meta_index_block(&meta_options);
     if (r->filter_block != nullptr) {
-      // Add mapping from "filter.Name" to location of filter data
-      std::string key = "filter.";
+      // Add mapping from "filter.Name" (or "fullfilter.Name") to
+      // location of filter data
+      std::string key = r->options.full_filter ? "fullfilter." : "filter.";
       key.append(r->options.filter_policy->Name());
       std::string handle_encoding;
       filter_block_handle.EncodeTo(&handle_encoding);
       meta_index_block.Add(key, handle_encoding);
     }
 
-    // TODO(postrelease): Add stats and other meta blocks
+    // Add mapping from "leveldb.properties" to location of the properties
+    std::string handle_encoding;
+    properties_block_handle.EncodeTo(&handle_encoding);
+    meta_index_block.Add(kPropertiesBlockName, handle_encoding);
+
+    if (r->filter_block != nullptr &&
+        r->options.prefix_extractor != nullptr) {
+      // Record that the filter also holds the prefixes produced by
+      // "prefix.Name" ("prefix." sorts after all the keys above).
+      std::string key = "prefix.";
+      key.append(r->options.prefix_extractor->Name());
+      meta_index_block.Add(key, Slice());
+    }
+
     WriteBlock(&meta_index_block, &metaindex_block_handle);
   }
 
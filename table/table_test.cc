@@ -4,18 +4,24 @@
 
 #include "leveldb/table.h"
 
+#include <algorithm>
 #include <map>
 #include <string>
+#include <vector>
 #include "db/dbformat.h"
 #include "db/memtable.h"
 #include "db/write_batch_internal.h"
+#include "leveldb/cache.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
 #include "leveldb/table_builder.h"
+#include "leveldb/table_properties.h"
 #include "table/block.h"
 #include "table/block_builder.h"
 #include "table/format.h"
+#include "table/merger.h"
+#include "util/logging.h"
 #include "util/random.h"
 #include "util/testharness.h"
 #include "util/testutil.h"
@@ -110,15 +116,17 @@ class StringSink: public WritableFile {
 class StringSource: public RandomAccessFile {
  public:
   StringSource(const Slice& contents)
-      : contents_(contents.data(), contents.size()) {
+      : contents_(contents.data(), contents.size()), reads_(0) {
   }
 
   virtual ~StringSource() { }
 
   uint64_t Size() const { return contents_.size(); }
+  int reads() const { return reads_; }
 
   virtual Status Read(uint64_t offset, size_t n, Slice* result,
                        char* scratch) const {
+    reads_++;
     if (offset > contents_.size()) {
       return Status::InvalidArgument("invalid Read offset");
     }
@@ -132,6 +140,7 @@ class StringSource: public RandomAccessFile {
 
  private:
   std::string contents_;
+  mutable int reads_;
 };
 
 typedef std::map<std::string, std::string, STLLessThan> KVMap;
@@ -827,6 +836,97 @@ TEST(TableTest, ApproximateOffsetOfPlain) {
 
 }
 
+TEST(TableTest, CacheIndexAndFilterBlocks) {
+  Options options;
+  options.block_size = 256;
+  options.compression = kNoCompression;
+  options.filter_policy = NewBloomFilterPolicy(10);
+  StringSink sink;
+  TableBuilder builder(options, &sink);
+  char key[20];
+  for (int i = 0; i < 1000; i++) {
+    snprintf(key, sizeof(key), "k%06d", i);
+    builder.Add(key, "value");
+  }
+  ASSERT_OK(builder.Finish());
+
+  StringSource source(sink.contents());
+  options.block_cache = NewLRUCache(1 << 20);
+  options.cache_index_and_filter_blocks = true;
+  Table* table = nullptr;
+  ASSERT_OK(Table::Open(options, &source, sink.contents().size(), &table));
+
+  // The index and filter blocks are now charged to the block cache.
+  ASSERT_GT(options.block_cache->TotalCharge(), 0);
+
+  // Evicting them is harmless: they are reloaded on demand.
+  options.block_cache->Prune();
+  ASSERT_EQ(0, options.block_cache->TotalCharge());
+  Iterator* iter = table->NewIterator(ReadOptions());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_OK(iter->status());
+  ASSERT_EQ(1000, count);
+  delete iter;
+  ASSERT_GT(options.block_cache->TotalCharge(), 0);
+  ASSERT_GT(table->ApproximateOffsetOf("k000500"), 0);
+
+  delete table;
+  delete options.block_cache;
+  delete options.filter_policy;
+}
+
+TEST(TableTest, Properties) {
+  Options options;
+  options.block_size = 256;
+  options.compression = kNoCompression;
+  options.filter_policy = NewBloomFilterPolicy(10);
+  StringSink sink;
+  TableBuilder builder(options, &sink);
+  char key[20];
+  for (int i = 0; i < 1000; i++) {
+    snprintf(key, sizeof(key), "k%06d", i);
+    builder.Add(key, "value", 1000 - i, i % 10 == 0);
+  }
+  ASSERT_OK(builder.Finish());
+
+  StringSource source(sink.contents());
+  Table* table = nullptr;
+  ASSERT_OK(Table::Open(options, &source, sink.contents().size(), &table));
+  const TableProperties* props = table->properties();
+  ASSERT_TRUE(props != nullptr);
+  ASSERT_EQ(1000, props->num_entries);
+  ASSERT_EQ(100, props->num_deletions);
+  ASSERT_EQ(7000, props->raw_key_size);
+  ASSERT_EQ(5000, props->raw_value_size);
+  ASSERT_EQ(1, props->smallest_seqno);
+  ASSERT_EQ(1000, props->largest_seqno);
+  ASSERT_GT(props->num_data_blocks, 1);
+  ASSERT_LT(props->data_size, sink.contents().size());
+
+  // Keys share their prefixes within a data block.
+  ASSERT_GT(props->CompressionRatio(), 1.0);
+  delete table;
+
+  // Tables built without sequence numbers have zero ones.
+  StringSink sink2;
+  TableBuilder builder2(options, &sink2);
+  builder2.Add("k1", "v1");
+  ASSERT_OK(builder2.Finish());
+  StringSource source2(sink2.contents());
+  ASSERT_OK(Table::Open(options, &source2, sink2.contents().size(), &table));
+  props = table->properties();
+  ASSERT_TRUE(props != nullptr);
+  ASSERT_EQ(1, props->num_entries);
+  ASSERT_EQ(0, props->num_deletions);
+  ASSERT_EQ(0, props->largest_seqno);
+  ASSERT_EQ(1, props->num_data_blocks);
+  delete table;
+  delete options.filter_policy;
+}
+
 static bool SnappyCompressionSupported() {
   std::string out;
   Slice in = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
@@ -869,6 +969,241 @@ TEST(TableTest, ApproximateOffsetOfCompressed) {
   ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"), 2 * min_z, 2 * max_z));
 }
 
+TEST(TableTest, CompressedBlockCache) {
+  if (!SnappyCompressionSupported()) {
+    fprintf(stderr, "skipping compression tests\n");
+    return;
+  }
+
+  Random rnd(301);
+  Options options;
+  options.block_size = 1024;
+  options.compression = kSnappyCompression;
+  StringSink sink;
+  TableBuilder builder(options, &sink);
+  char key[20];
+  std::string tmp;
+  for (int i = 0; i < 200; i++) {
+    snprintf(key, sizeof(key), "k%06d", i);
+    builder.Add(key, test::CompressibleString(&rnd, 0.25, 500, &tmp));
+  }
+  ASSERT_OK(builder.Finish());
+
+  StringSource source(sink.contents());
+  options.block_cache = NewLRUCache(1 << 20);
+  options.compressed_block_cache = NewLRUCache(1 << 20);
+  Table* table = nullptr;
+  ASSERT_OK(Table::Open(options, &source, sink.contents().size(), &table));
+
+  Iterator* iter = table->NewIterator(ReadOptions());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_OK(iter->status());
+  ASSERT_EQ(200, count);
+  delete iter;
+
+  // Blocks are held in both tiers, in much less space in the second.
+  const size_t uncompressed = options.block_cache->TotalCharge();
+  const size_t compressed = options.compressed_block_cache->TotalCharge();
+  ASSERT_GT(compressed, 0);
+  ASSERT_LT(compressed, uncompressed / 2);
+
+  // Blocks evicted from block_cache are served from the compressed tier
+  // without reading the file.
+  options.block_cache->Prune();
+  const int reads = source.reads();
+  iter = table->NewIterator(ReadOptions());
+  std::string last;
+  count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+    last = iter->key().ToString();
+  }
+  ASSERT_OK(iter->status());
+  ASSERT_EQ(200, count);
+  ASSERT_EQ("k000199", last);
+  delete iter;
+  ASSERT_EQ(reads, source.reads());
+  ASSERT_EQ(uncompressed, options.block_cache->TotalCharge());
+
+  delete table;
+  delete options.block_cache;
+  delete options.compressed_block_cache;
+}
+
+// Iterates over a sorted vector of keys whose values are "<tag>:<key>".
+class VectorIterator : public Iterator {
+ public:
+  VectorIterator(const std::vector<std::string>& keys, int tag)
+      : keys_(keys), tag_(NumberToString(tag)), pos_(keys.size()) { }
+
+  virtual bool Valid() const { return pos_ < keys_.size(); }
+  virtual void SeekToFirst() { pos_ = 0; }
+  virtual void SeekToLast() {
+    pos_ = keys_.empty() ? keys_.size() : keys_.size() - 1;
+  }
+  virtual void Seek(const Slice& target) {
+    pos_ = std::lower_bound(keys_.begin(), keys_.end(), target.ToString()) -
+           keys_.begin();
+  }
+  virtual void Next() { assert(Valid()); pos_++; }
+  virtual void Prev() {
+    assert(Valid());
+    pos_ = (pos_ == 0) ? keys_.size() : pos_ - 1;
+  }
+  virtual Slice key() const { assert(Valid()); return keys_[pos_]; }
+  virtual Slice value() const {
+    assert(Valid());
+    value_ = tag_ + ":" + keys_[pos_];
+    return value_;
+  }
+  virtual Status status() const { return Status::OK(); }
+
+ private:
+  const std::vector<std::string> keys_;
+  const std::string tag_;
+  size_t pos_;
+  mutable std::string value_;
+};
+
+class MergerTest { };
+
+// Checks a merging iterator over many children against the sorted
+// union of their keys, including after changes of direction.
+TEST(MergerTest, ManyChildren) {
+  Random rnd(test::RandomSeed());
+  for (int num_children = 1; num_children <= 200; num_children *= 3) {
+    // Each key goes to a single child so that the merged order is total.
+    std::vector<std::vector<std::string> > child_keys(num_children);
+    std::vector<std::string> model;
+    for (int i = 0; i < 1000; i++) {
+      char buf[20];
+      snprintf(buf, sizeof(buf), "%08d", i * 2);
+      child_keys[rnd.Uniform(num_children)].push_back(buf);
+      model.push_back(buf);
+    }
+    std::vector<Iterator*> children;
+    for (int c = 0; c < num_children; c++) {
+      children.push_back(new VectorIterator(child_keys[c], c));
+    }
+    Iterator* iter = NewMergingIterator(BytewiseComparator(), &children[0],
+                                        num_children);
+
+    int n = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      ASSERT_EQ(model[n], iter->key().ToString());
+      n++;
+    }
+    ASSERT_EQ(model.size(), n);
+    for (iter->SeekToLast(); iter->Valid(); iter->Prev()) {
+      n--;
+      ASSERT_EQ(model[n], iter->key().ToString());
+    }
+    ASSERT_EQ(0, n);
+
+    // Random walk mixing seeks and both directions.
+    int pos = -1;  // Index in model, or -1 if !Valid()
+    for (int step = 0; step < 5000; step++) {
+      switch (rnd.Uniform(pos < 0 ? 3 : 5)) {
+        case 0: {
+          const int k = rnd.Uniform(2 * model.size());
+          char buf[20];
+          snprintf(buf, sizeof(buf), "%08d", k);
+          iter->Seek(buf);
+          pos = (k + 1) / 2;
+          if (pos == model.size()) pos = -1;
+          break;
+        }
+        case 1:
+          iter->SeekToFirst();
+          pos = 0;
+          break;
+        case 2:
+          iter->SeekToLast();
+          pos = model.size() - 1;
+          break;
+        case 3:
+          iter->Next();
+          pos++;
+          if (pos == model.size()) pos = -1;
+          break;
+        case 4:
+          iter->Prev();
+          pos--;
+          break;
+      }
+      if (pos < 0) {
+        ASSERT_TRUE(!iter->Valid());
+      } else {
+        ASSERT_TRUE(iter->Valid());
+        ASSERT_EQ(model[pos], iter->key().ToString());
+      }
+    }
+    ASSERT_OK(iter->status());
+    delete iter;
+  }
+}
+
+// Keys present in several children are yielded once per child, in
+// child order going forward and in reverse child order going backward.
+TEST(MergerTest, DuplicateKeys) {
+  const int kNumChildren = 9;
+  std::vector<Iterator*> children;
+  for (int c = 0; c < kNumChildren; c++) {
+    std::vector<std::string> keys;
+    keys.push_back("a");
+    if (c % 2 == 0) keys.push_back("b");
+    keys.push_back("c");
+    children.push_back(new VectorIterator(keys, c));
+  }
+  Iterator* iter = NewMergingIterator(BytewiseComparator(), &children[0],
+                                      kNumChildren);
+  std::string forward, backward;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    forward += iter->value().ToString() + " ";
+  }
+  for (iter->SeekToLast(); iter->Valid(); iter->Prev()) {
+    backward += iter->value().ToString() + " ";
+  }
+  ASSERT_EQ("0:a 1:a 2:a 3:a 4:a 5:a 6:a 7:a 8:a "
+            "0:b 2:b 4:b 6:b 8:b "
+            "0:c 1:c 2:c 3:c 4:c 5:c 6:c 7:c 8:c ",
+            forward);
+  ASSERT_EQ("8:c 7:c 6:c 5:c 4:c 3:c 2:c 1:c 0:c "
+            "8:b 6:b 4:b 2:b 0:b "
+            "8:a 7:a 6:a 5:a 4:a 3:a 2:a 1:a 0:a ",
+            backward);
+  delete iter;
+}
+
+TEST(MergerTest, BorrowedChildren) {
+  std::vector<Iterator*> children;
+  for (int c = 0; c < 3; c++) {
+    std::vector<std::string> keys;
+    keys.push_back(std::string(1, 'a' + c));
+    children.push_back(new VectorIterator(keys, c));
+  }
+
+  // The children outlive a merge of all of them and can be merged again
+  Iterator* iter = NewBorrowingMergingIterator(BytewiseComparator(),
+                                               &children[0], 3);
+  iter->SeekToLast();
+  ASSERT_EQ("c", iter->key().ToString());
+  delete iter;
+  iter = NewBorrowingMergingIterator(BytewiseComparator(), &children[1], 1);
+  std::string keys;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    keys += iter->key().ToString();
+  }
+  ASSERT_EQ("b", keys);
+  delete iter;
+  for (int c = 0; c < 3; c++) {
+    delete children[c];
+  }
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
@@ -4,16 +4,103 @@
 
 #include "table/two_level_iterator.h"
 
+#include <algorithm>
+#include <deque>
+#include <vector>
+#include "leveldb/comparator.h"
+#include "leveldb/env.h"
 #include "leveldb/table.h"
+#include "port/port.h"
 #include "table/block.h"
 #include "table/format.h"
 #include "table/iterator_wrapper.h"
+#include "util/mutexlock.h"
 
 namespace leveldb {
 
 namespace {
 
 typedef Iterator* (*BlockFunction)(void*, const ReadOptions&, const Slice&);
+typedef bool (*PrefixFunction)(void*, const Slice&, const Slice&);
+typedef void (*PrefetchFunction)(void*, const ReadOptions&, const Slice&);
+
+// A call of a prefetch function, owned by the iterator that makes it
+struct PrefetchRequest {
+  PrefetchFunction function;
+  void* arg;
+  ReadOptions options;
+  std::string index_value;
+  bool queued;   // Waiting in PrefetchThread::queue_
+  bool running;  // Being run by the prefetch thread
+};
+
+// Single background thread, shared by all iterators, that runs the
+// prefetch requests in the order they were submitted.
+class PrefetchThread {
+ public:
+  PrefetchThread() : work_cv_(&mu_), done_cv_(&mu_), started_(false) { }
+
+  // REQUIRES: r is neither queued nor running
+  void Submit(PrefetchRequest* r) {
+    MutexLock l(&mu_);
+    if (!started_) {
+      started_ = true;
+      Env::Default()->StartThread(&PrefetchThread::BGThreadWrapper, this);
+    }
+    r->queued = true;
+    queue_.push_back(r);
+    work_cv_.Signal();
+  }
+
+  // Removes r from the queue if it has not started yet; otherwise waits
+  // until it has finished.
+  void Cancel(PrefetchRequest* r) {
+    MutexLock l(&mu_);
+    if (r->queued) {
+      queue_.erase(std::find(queue_.begin(), queue_.end(), r));
+      r->queued = false;
+    }
+    while (r->running) {
+      done_cv_.Wait();
+    }
+  }
+
+ private:
+  static void BGThreadWrapper(void* arg) {
+    reinterpret_cast<PrefetchThread*>(arg)->BGThread();
+  }
+
+  void BGThread() {
+    mu_.Lock();
+    while (true) {
+      while (queue_.empty()) {
+        work_cv_.Wait();
+      }
+      PrefetchRequest* r = queue_.front();
+      queue_.pop_front();
+      r->queued = false;
+      r->running = true;
+      mu_.Unlock();
+      (*r->function)(r->arg, r->options, r->index_value);
+      mu_.Lock();
+      r->running = false;
+      done_cv_.SignalAll();
+    }
+  }
+
+  port::Mutex mu_;
+  port::CondVar work_cv_;
+  port::CondVar done_cv_;
+  bool started_;
+  std::deque<PrefetchRequest*> queue_;
+};
+
+static port::OnceType prefetch_once = LEVELDB_ONCE_INIT;
+static PrefetchThread* prefetch_thread;
+
+static void InitPrefetchThread() {
+  prefetch_thread = new PrefetchThread;
+}
 
 class TwoLevelIterator: public Iterator {
  public:
@@ -21,7 +108,10 @@ class TwoLevelIterator: public Iterator {
     Iterator* index_iter,
     BlockFunction block_function,
     void* arg,
-    const ReadOptions& options);
+    const ReadOptions& options,
+    PrefixFunction prefix_may_match,
+    const Comparator* comparator,
+    PrefetchFunction prefetch_block);
 
   virtual ~TwoLevelIterator();
 
@@ -57,12 +147,18 @@ class TwoLevelIterator: public Iterator {
   void SaveError(const Status& s) {
     if (status_.ok() && !s.ok()) status_ = s;
   }
+  bool BlockEndsPastUpperBound() const;
+  bool BlockEndsBeforeLowerBound() const;
   void SkipEmptyDataBlocksForward();
   void SkipEmptyDataBlocksBackward();
   void SetDataIterator(Iterator* data_iter);
   void InitDataBlock();
+  void PrefetchNextBlock();
+  void CancelPrefetch();
 
   BlockFunction block_function_;
+  PrefixFunction prefix_may_match_;  // nullptr unless prefix seeks may skip
+  const Comparator* comparator_;     // nullptr unless bounds may skip blocks
   void* arg_;
   const ReadOptions options_;
   Status status_;
@@ -71,28 +167,74 @@ class TwoLevelIterator: public Iterator {
   // If data_iter_ is non-null, then "data_block_handle_" holds the
   // "index_value" passed to block_function_ to create the data_iter_.
   std::string data_block_handle_;
+  // prefetch_.function is nullptr unless blocks are prefetched
+  PrefetchRequest prefetch_;
+  bool prefetch_pending_;  // prefetch_ was submitted and not cancelled
+  // Data iterators replaced while options_.pin_data is set.  They keep
+  // their blocks alive until we are gone.
+  std::vector<Iterator*> pinned_iters_;
 };
 
 TwoLevelIterator::TwoLevelIterator(
     Iterator* index_iter,
     BlockFunction block_function,
     void* arg,
-    const ReadOptions& options)
+    const ReadOptions& options,
+    PrefixFunction prefix_may_match,
+    const Comparator* comparator,
+    PrefetchFunction prefetch_block)
     : block_function_(block_function),
+      prefix_may_match_(options.prefix_same_as_start ? prefix_may_match
+                                                     : nullptr),
+      comparator_(comparator),
       arg_(arg),
       options_(options),
       index_iter_(index_iter),
-      data_iter_(nullptr) {
+      data_iter_(nullptr),
+      prefetch_pending_(false) {
+  prefetch_.function = options.async_prefetch ? prefetch_block : nullptr;
+  prefetch_.arg = arg;
+  prefetch_.options = options;
+  prefetch_.options.fill_cache = true;
+  prefetch_.queued = false;
+  prefetch_.running = false;
+  if (prefetch_.function != nullptr) {
+    port::InitOnce(&prefetch_once, InitPrefetchThread);
+  }
 }
 
 TwoLevelIterator::~TwoLevelIterator() {
+  // "arg" may be released once we are gone
+  CancelPrefetch();
+  for (size_t i = 0; i < pinned_iters_.size(); i++) {
+    delete pinned_iters_[i];
+  }
 }
 
 void TwoLevelIterator::Seek(const Slice& target) {
   index_iter_.Seek(target);
+  if (prefix_may_match_ != nullptr && index_iter_.Valid() &&
+      !(*prefix_may_match_)(arg_, target, index_iter_.value())) {
+    // The block holds no key with the prefix.  Index keys may lie past the
+    // last key of their block, so the first key with the prefix that
+    // follows target can still start the next block; beyond that, no
+    // block can hold one since keys with the same prefix are adjacent.
+    index_iter_.Next();
+    if (!index_iter_.Valid() ||
+        !(*prefix_may_match_)(arg_, target, index_iter_.value())) {
+      SetDataIterator(nullptr);
+      return;
+    }
+    InitDataBlock();
+    if (data_iter_.iter() != nullptr) data_iter_.SeekToFirst();
+    SkipEmptyDataBlocksForward();
+    PrefetchNextBlock();
+    return;
+  }
   InitDataBlock();
   if (data_iter_.iter() != nullptr) data_iter_.Seek(target);
   SkipEmptyDataBlocksForward();//DHQ: Skip也有 Backward 和 Forward 两个方向
+  PrefetchNextBlock();
 }
 
 void TwoLevelIterator::SeekToFirst() {
@@ -100,6 +242,7 @@ void TwoLevelIterator::SeekToFirst() {
   InitDataBlock();
   if (data_iter_.iter() != nullptr) data_iter_.SeekToFirst();
   SkipEmptyDataBlocksForward();
+  PrefetchNextBlock();
 }
 
 void TwoLevelIterator::SeekToLast() {
@@ -112,7 +255,15 @@ void TwoLevelIterator::SeekToLast() {
 void TwoLevelIterator::Next() {
   assert(Valid());
   data_iter_.Next();
-  SkipEmptyDataBlocksForward();
+  if (!data_iter_.Valid() && BlockEndsPastUpperBound()) {
+    // Every key of the next block is past the bound
+    SetDataIterator(nullptr);
+    return;
+  }
+  if (!data_iter_.Valid()) {
+    SkipEmptyDataBlocksForward();
+    PrefetchNextBlock();
+  }
   //DHQ: 这个函数内判断并可能调用 index_iter_的函数，保证下次 data_iter_操作是有效的。有可能会换block
   //Next过后，data_iter_ 可能变得 invalid，这时需要 index_iter_ 
 }
@@ -120,9 +271,36 @@ void TwoLevelIterator::Next() {
 void TwoLevelIterator::Prev() {
   assert(Valid());
   data_iter_.Prev();
+  if (!data_iter_.Valid() && index_iter_.Valid() &&
+      comparator_ != nullptr && options_.iterate_lower_bound != nullptr) {
+    index_iter_.Prev();
+    if (BlockEndsBeforeLowerBound()) {
+      // Every key of this block is before the bound
+      SetDataIterator(nullptr);
+      return;
+    }
+    InitDataBlock();
+    if (data_iter_.iter() != nullptr) data_iter_.SeekToLast();
+  }
   SkipEmptyDataBlocksBackward();
 }
 
+// An index key is at or after the last key of its block and before the
+// first key of the next block.
+bool TwoLevelIterator::BlockEndsPastUpperBound() const {
+  return comparator_ != nullptr && options_.iterate_upper_bound != nullptr &&
+         index_iter_.Valid() &&
+         comparator_->Compare(index_iter_.key(),
+                              *options_.iterate_upper_bound) >= 0;
+}
+
+bool TwoLevelIterator::BlockEndsBeforeLowerBound() const {
+  return comparator_ != nullptr && options_.iterate_lower_bound != nullptr &&
+         index_iter_.Valid() &&
+         comparator_->Compare(index_iter_.key(),
+                              *options_.iterate_lower_bound) < 0;
+}
+
 
 void TwoLevelIterator::SkipEmptyDataBlocksForward() {
   while (data_iter_.iter() == nullptr || !data_iter_.Valid()) {
@@ -151,7 +329,12 @@ void TwoLevelIterator::SkipEmptyDataBlocksBackward() {
 }
 
 void TwoLevelIterator::SetDataIterator(Iterator* data_iter) {
-  if (data_iter_.iter() != nullptr) SaveError(data_iter_.status());
+  if (data_iter_.iter() != nullptr) {
+    SaveError(data_iter_.status());
+    if (options_.pin_data) {
+      pinned_iters_.push_back(data_iter_.Release());
+    }
+  }
   data_iter_.Set(data_iter);
 }
 
@@ -164,6 +347,7 @@ void TwoLevelIterator::InitDataBlock() {
       // data_iter_ is already constructed with this iterator, so
       // no need to change anything
     } else {
+      CancelPrefetch();
       Iterator* iter = (*block_function_)(arg_, options_, handle);
       data_block_handle_.assign(handle.data(), handle.size());
       SetDataIterator(iter);
@@ -171,14 +355,45 @@ void TwoLevelIterator::InitDataBlock() {
   }
 }
 
+// Submits the block after the current one to the prefetch thread, unless
+// the iterator is at the last block or stops before the next one.
+void TwoLevelIterator::PrefetchNextBlock() {
+  if (prefetch_.function == nullptr || !data_iter_.Valid() ||
+      BlockEndsPastUpperBound()) {
+    return;
+  }
+  index_iter_.Next();
+  if (index_iter_.Valid()) {
+    Slice next = index_iter_.value();
+    CancelPrefetch();
+    prefetch_.index_value.assign(next.data(), next.size());
+    prefetch_thread->Submit(&prefetch_);
+    prefetch_pending_ = true;
+    index_iter_.Prev();
+  } else {
+    index_iter_.SeekToLast();
+  }
+}
+
+void TwoLevelIterator::CancelPrefetch() {
+  if (prefetch_pending_) {
+    prefetch_thread->Cancel(&prefetch_);
+    prefetch_pending_ = false;
+  }
+}
+
 }  // namespace
 
 Iterator* NewTwoLevelIterator(
     Iterator* index_iter,
     BlockFunction block_function,
     void* arg,
-    const ReadOptions& options) {
-  return new TwoLevelIterator(index_iter, block_function, arg, options);
+    const ReadOptions& options,
+    PrefixFunction prefix_may_match,
+    const Comparator* comparator,
+    PrefetchFunction prefetch_block) {
+  return new TwoLevelIterator(index_iter, block_function, arg, options,
+                              prefix_may_match, comparator, prefetch_block);
 }
 
 }  // namespace leveldb
@@ -9,6 +9,7 @@
 
 namespace leveldb {
 
+class Comparator;
 struct ReadOptions;
 
 // Return a new two level iterator.  A two-level iterator contains an
@@ -20,6 +21,25 @@ struct ReadOptions;
 //
 // Uses a supplied function to convert an index_iter value into
 // an iterator over the contents of the corresponding block.
+//
+// If "prefix_may_match" is non-null and options.prefix_same_as_start is
+// set, Seek(target) calls it with the index entry found for target, and
+// with the following one if the first call returns false.  The iterator
+// is left invalid if both calls return false, i.e. if neither block can
+// hold a key with the prefix of target.
+//
+// If "comparator" is non-null, Next() and Prev() compare index keys with
+// options.iterate_upper_bound and options.iterate_lower_bound (keys in
+// the same format as those of the blocks) and do not move into blocks
+// that lie entirely outside of the bounds; the iterator becomes invalid
+// instead.
+//
+// If "prefetch_block" is non-null and options.async_prefetch is set, the
+// iterator calls it on a background thread with the index entry of the
+// next block whenever it moves forward into a block, so that the block
+// can be loaded (e.g. into a cache) before block_function is called for
+// it.  A pending call is either cancelled or waited for before the
+// iterator calls block_function again and before it is deleted.
 Iterator* NewTwoLevelIterator(
     Iterator* index_iter,
     Iterator* (*block_function)(
@@ -27,7 +47,16 @@ Iterator* NewTwoLevelIterator(
         const ReadOptions& options,
         const Slice& index_value),
     void* arg,
-    const ReadOptions& options);
+    const ReadOptions& options,
+    bool (*prefix_may_match)(
+        void* arg,
+        const Slice& target,
+        const Slice& index_value) = nullptr,
+    const Comparator* comparator = nullptr,
+    void (*prefetch_block)(
+        void* arg,
+        const ReadOptions& options,
+        const Slice& index_value) = nullptr);
 
 }  // namespace leveldb
 
@@ -0,0 +1,186 @@
+// Copyright (c) 2012 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A Bloom filter that confines all probes for a key to one 64-byte cache
+// line.  The filter is an array of 512-bit lines followed by one byte
+// holding the number of probes.  The high bits of a key's hash select its
+// line, and a rotation of the hash is stepped by multiplication to produce
+// 9-bit offsets within that line, so a probe costs one memory access
+// instead of one per bit.  On x86 CPUs with AVX2, up to eight bit offsets are
+// computed and tested at once; elsewhere the same bits are tested one at
+// a time.
+
+#include "leveldb/filter_policy.h"
+
+#include <stdint.h>
+#include "leveldb/slice.h"
+#include "util/hash.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LEVELDB_BLOOM_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace leveldb {
+
+namespace {
+
+static const size_t kLineBytes = 64;
+static const size_t kLineBits = kLineBytes * 8;
+static const size_t kMaxProbes = 16;
+
+// kMultipliers[i] == 0x9e3779b9^i.  The i-th probe of a key uses the top
+// nine bits of h * kMultipliers[i], which lets the probes be computed
+// independently of each other.
+static const uint32_t kMultipliers[kMaxProbes] = {
+  0x00000001u, 0x9e3779b9u, 0xe35e67b1u, 0x734297e9u,
+  0x35fbe861u, 0xdeb7c719u, 0x0448b211u, 0x3459b749u,
+  0xab25f4c1u, 0x52941879u, 0x9c95e071u, 0xf5ab9aa9u,
+  0x2d6ba521u, 0x8bededd9u, 0x9bfb72d1u, 0x3ae1c209u,
+};
+
+static uint32_t BloomHash(const Slice& key) {
+  return Hash(key.data(), key.size(), 0xbc9f1d34);
+}
+
+// Feeds the low bits of the hash, which barely affect the choice of line,
+// into the top bits used by the probes.
+static uint32_t ProbeHash(uint32_t h) {
+  return (h >> 17) | (h << 15);  // Rotate right 17 bits
+}
+
+// Maps h uniformly onto [0, n) without a division.
+static inline size_t LineIndex(uint32_t h, size_t n) {
+  return static_cast<size_t>((static_cast<uint64_t>(h) * n) >> 32);
+}
+
+static bool ProbeScalar(const char* line, uint32_t h, size_t k) {
+  for (size_t i = 0; i < k; i++) {
+    const uint32_t bitpos = (h * kMultipliers[i]) >> 23;
+    if ((line[bitpos/8] & (1 << (bitpos % 8))) == 0) return false;
+  }
+  return true;
+}
+
+#if defined(LEVELDB_BLOOM_AVX2)
+// Tests eight probes per step.  The bit offsets are computed with one
+// vector multiply, and the 32-bit word holding each bit is picked out of
+// the two halves of the line with permutes rather than a gather, which is
+// slow on many CPUs.  Bit b of the line is bit b%32 of word b/32, which
+// matches the byte layout used by ProbeScalar on little-endian x86.
+__attribute__((target("avx2")))
+static bool ProbeAVX2(const char* line, uint32_t h, size_t k) {
+  const __m256i lower = _mm256_loadu_si256(
+      reinterpret_cast<const __m256i*>(line));
+  const __m256i upper = _mm256_loadu_si256(
+      reinterpret_cast<const __m256i*>(line + 32));
+  const __m256i ones = _mm256_set1_epi32(1);
+  const __m256i low5 = _mm256_set1_epi32(31);
+  const __m256i seven = _mm256_set1_epi32(7);
+  const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  for (size_t i = 0; i < k; i += 8) {
+    const __m256i mult = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(&kMultipliers[i]));
+    const __m256i bitpos = _mm256_srli_epi32(
+        _mm256_mullo_epi32(_mm256_set1_epi32(h), mult), 23);
+    const __m256i index = _mm256_srli_epi32(bitpos, 5);  // Word in [0,16)
+    // permutevar8x32 only looks at the low three bits of the index
+    const __m256i word = _mm256_blendv_epi8(
+        _mm256_permutevar8x32_epi32(lower, index),
+        _mm256_permutevar8x32_epi32(upper, index),
+        _mm256_cmpgt_epi32(index, seven));
+    __m256i bit = _mm256_sllv_epi32(ones, _mm256_and_si256(bitpos, low5));
+    // Ignore lanes past the last probe
+    const __m256i live = _mm256_cmpgt_epi32(
+        _mm256_set1_epi32(static_cast<int>(k - i)), lanes);
+    bit = _mm256_and_si256(bit, live);
+    const __m256i missing = _mm256_andnot_si256(word, bit);
+    if (!_mm256_testz_si256(missing, missing)) return false;
+  }
+  return true;
+}
+
+static bool HaveAVX2() {
+  static const bool have = __builtin_cpu_supports("avx2");
+  return have;
+}
+#endif
+
+class BlockedBloomFilterPolicy : public FilterPolicy {
+ private:
+  size_t bits_per_key_;
+  size_t k_;
+
+ public:
+  explicit BlockedBloomFilterPolicy(int bits_per_key)
+      : bits_per_key_(bits_per_key) {
+    // We intentionally round down to reduce probing cost a little bit
+    k_ = static_cast<size_t>(bits_per_key * 0.69);  // 0.69 =~ ln(2)
+    if (k_ < 1) k_ = 1;
+    if (k_ > kMaxProbes) k_ = kMaxProbes;
+  }
+
+  virtual const char* Name() const {
+    return "leveldb.BlockedBloomFilter";
+  }
+
+  virtual void CreateFilter(const Slice* keys, int n, std::string* dst) const {
+    // Round the filter up to a whole number of cache lines (at least one)
+    const size_t bits = n * bits_per_key_;
+    size_t lines = (bits + kLineBits - 1) / kLineBits;
+    if (lines == 0) lines = 1;
+    const size_t bytes = lines * kLineBytes;
+
+    const size_t init_size = dst->size();
+    dst->resize(init_size + bytes, 0);
+    dst->push_back(static_cast<char>(k_));  // Remember # of probes in filter
+    char* array = &(*dst)[init_size];
+    for (int i = 0; i < n; i++) {
+      const uint32_t hash = BloomHash(keys[i]);
+      char* line = array + LineIndex(hash, lines) * kLineBytes;
+      const uint32_t h = ProbeHash(hash);
+      for (size_t j = 0; j < k_; j++) {
+        const uint32_t bitpos = (h * kMultipliers[j]) >> 23;
+        line[bitpos/8] |= (1 << (bitpos % 8));
+      }
+    }
+  }
+
+  virtual bool KeyMayMatch(const Slice& key, const Slice& filter) const {
+    const size_t len = filter.size();
+    if (len < kLineBytes + 1) return false;
+    if ((len - 1) % kLineBytes != 0) {
+      // Not a filter we wrote.  Consider it a match.
+      return true;
+    }
+
+    // Use the encoded k so that we can read filters generated with
+    // different parameters.
+    const char* array = filter.data();
+    const size_t k = array[len-1];
+    if (k > kMaxProbes) {
+      // Reserved for potentially new encodings.  Consider it a match.
+      return true;
+    }
+
+    const size_t lines = (len - 1) / kLineBytes;
+    const uint32_t hash = BloomHash(key);
+    const char* line = array + LineIndex(hash, lines) * kLineBytes;
+    const uint32_t h = ProbeHash(hash);
+#if defined(LEVELDB_BLOOM_AVX2)
+    if (HaveAVX2()) {
+      return ProbeAVX2(line, h, k);
+    }
+#endif
+    return ProbeScalar(line, h, k);
+  }
+};
+
+}  // namespace
+
+const FilterPolicy* NewBlockedBloomFilterPolicy(int bits_per_key) {
+  return new BlockedBloomFilterPolicy(bits_per_key);
+}
+
+}  // namespace leveldb
@@ -17,6 +17,12 @@ namespace leveldb {
 Cache::~Cache() {
 }
 
+Cache::Handle* Cache::Insert(const Slice& key, void* value, size_t charge,
+                             void (*deleter)(const Slice& key, void* value),
+                             Priority priority) {
+  return Insert(key, value, charge, deleter);
+}
+
 namespace {
 //DHQ: in_cache表示Cache本身对entry有ref.  提到了duplicate key
 //所以，那些已经被从cache移除，但是还被用户Ref的，in_cache应当为0，且没有cache对它的ref. 并且不在任何一个list上
@@ -34,10 +40,23 @@ namespace {
 //   particular order.  (This list is used for invariant checking.  If we
 //   removed the check, elements that would otherwise be on this list could be
 //   left as disconnected singleton lists.)
-// - LRU:  contains the items not currently referenced by clients, in LRU order
+// - LRU:  contains the items of the low-priority pool not currently
+//   referenced by clients, in LRU order
+// - high-priority LRU:  like LRU, but for items of the high-priority pool.
+//   Only drained once LRU is empty.
 // Elements are moved between these lists by the Ref() and Unref() methods,
 // when they detect an element in the cache acquiring or losing its only
 // external reference.
+//
+// The high-priority pool makes the cache resistant to scans.  Items enter
+// it when inserted with Cache::kHighPriority, or when they are looked up
+// while cached, i.e. on their second use; other items enter the
+// low-priority pool.  Items inserted with Cache::kPrefetched have not been
+// used yet, so only their second lookup promotes them.  The pool is limited to high_pri_pool_capacity_; its
+// oldest unused items beyond that are moved to the newest end of LRU, so
+// that LRU order is kept across both lists.  Items used only once, such
+// as the blocks read by a scan, thus never evict more than the
+// low-priority pool.
 
 // An entry is a variable length heap-allocated structure.  Entries
 // are kept in a circular doubly linked list ordered by access time.
@@ -50,6 +69,8 @@ struct LRUHandle {
   size_t charge;      // TODO(opt): Only allow uint32_t?
   size_t key_length;
   bool in_cache;      // Whether entry is in the cache.
+  bool in_high_pri_pool;  // Whether entry is in the high-priority pool.
+  bool prefetched;    // Inserted with kPrefetched and not looked up since.
   uint32_t refs;      // References, including cache reference, if present.
   uint32_t hash;      // Hash of key(); used for fast sharding and comparisons
   char key_data[1];   // Beginning of key
@@ -156,12 +177,16 @@ class LRUCache {
   ~LRUCache();
 
   // Separate from constructor so caller can easily make an array of LRUCache
-  void SetCapacity(size_t capacity) { capacity_ = capacity; }
+  void SetCapacity(size_t capacity, double high_pri_pool_ratio) {
+    capacity_ = capacity;
+    high_pri_pool_capacity_ = capacity * high_pri_pool_ratio;
+  }
 
   // Like Cache methods, but with an extra "hash" parameter.
   Cache::Handle* Insert(const Slice& key, uint32_t hash,
                         void* value, size_t charge,
-                        void (*deleter)(const Slice& key, void* value));
+                        void (*deleter)(const Slice& key, void* value),
+                        Cache::Priority priority);
   Cache::Handle* Lookup(const Slice& key, uint32_t hash);
   void Release(Cache::Handle* handle);
   void Erase(const Slice& key, uint32_t hash);
@@ -177,19 +202,26 @@ class LRUCache {
   void Ref(LRUHandle* e);
   void Unref(LRUHandle* e);
   bool FinishErase(LRUHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  LRUHandle* OldestUnused() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void MaintainPoolSize() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   // Initialized before use.
   size_t capacity_;
+  size_t high_pri_pool_capacity_;
 
   // mutex_ protects the following state.
   mutable port::Mutex mutex_;
   size_t usage_ GUARDED_BY(mutex_);
+  size_t high_pri_pool_usage_ GUARDED_BY(mutex_);
 
   // Dummy head of LRU list.
   // lru.prev is newest entry, lru.next is oldest entry.
   // Entries have refs==1 and in_cache==true.
   LRUHandle lru_ GUARDED_BY(mutex_);
 
+  // Dummy head of high-priority LRU list.  Same invariants as lru_.
+  LRUHandle high_pri_lru_ GUARDED_BY(mutex_);
+
   // Dummy head of in-use list.
   // Entries are in use by clients, and have refs >= 2 and in_cache==true.
   LRUHandle in_use_ GUARDED_BY(mutex_);
@@ -198,23 +230,29 @@ class LRUCache {
 };
 
 LRUCache::LRUCache()
-    : usage_(0) {
+    : usage_(0),
+      high_pri_pool_usage_(0) {
   // Make empty circular linked lists.
   lru_.next = &lru_;
   lru_.prev = &lru_;
+  high_pri_lru_.next = &high_pri_lru_;
+  high_pri_lru_.prev = &high_pri_lru_;
   in_use_.next = &in_use_;
   in_use_.prev = &in_use_;
 }
 
 LRUCache::~LRUCache() {
   assert(in_use_.next == &in_use_);  // Error if caller has an unreleased handle
-  for (LRUHandle* e = lru_.next; e != &lru_; ) {
-    LRUHandle* next = e->next;
-    assert(e->in_cache);
-    e->in_cache = false;
-    assert(e->refs == 1);  // Invariant of lru_ list.
-    Unref(e);
-    e = next;
+  LRUHandle* lists[] = { &lru_, &high_pri_lru_ };
+  for (int i = 0; i < 2; i++) {
+    for (LRUHandle* e = lists[i]->next; e != lists[i]; ) {
+      LRUHandle* next = e->next;
+      assert(e->in_cache);
+      e->in_cache = false;
+      assert(e->refs == 1);  // Invariant of lru_ list.
+      Unref(e);
+      e = next;
+    }
   }
 }
 
@@ -236,7 +274,7 @@ void LRUCache::Unref(LRUHandle* e) {
   } else if (e->in_cache && e->refs == 1) {//只有cache在ref它，没有user ref，肯定不在in_use，但是可能在lru
     // No longer in use; move to lru_ list.
     LRU_Remove(e);
-    LRU_Append(&lru_, e);//append到lru的末尾
+    LRU_Append(e->in_high_pri_pool ? &high_pri_lru_ : &lru_, e);//append到lru的末尾
   }
 }
 //DHQ： 从当前所在list删除
@@ -258,6 +296,14 @@ Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash) {
   LRUHandle* e = table_.Lookup(key, hash);
   if (e != nullptr) {
     Ref(e); //DHQ: Lookup隐含了Ref
+    if (e->prefetched) {  // First use of a prefetched entry
+      e->prefetched = false;
+    } else if (!e->in_high_pri_pool) {
+      // Second use; promote to high-priority pool
+      e->in_high_pri_pool = true;
+      high_pri_pool_usage_ += e->charge;
+      MaintainPoolSize();
+    }
   }
   return reinterpret_cast<Cache::Handle*>(e);
 }
@@ -265,11 +311,13 @@ Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash) {
 void LRUCache::Release(Cache::Handle* handle) {
   MutexLock l(&mutex_);
   Unref(reinterpret_cast<LRUHandle*>(handle));
+  MaintainPoolSize();
 }
 
 Cache::Handle* LRUCache::Insert(
     const Slice& key, uint32_t hash, void* value, size_t charge,
-    void (*deleter)(const Slice& key, void* value)) {
+    void (*deleter)(const Slice& key, void* value),
+    Cache::Priority priority) {
   MutexLock l(&mutex_);
   //DHQ: key作为LRUHandle的一部分了
   LRUHandle* e = reinterpret_cast<LRUHandle*>(
@@ -280,6 +328,8 @@ Cache::Handle* LRUCache::Insert(
   e->key_length = key.size();
   e->hash = hash;
   e->in_cache = false;
+  e->in_high_pri_pool = false;
+  e->prefetched = (priority == Cache::kPrefetched);
   e->refs = 1;  // for the returned handle.
   memcpy(e->key_data, key.data(), key.size());
 
@@ -288,23 +338,53 @@ Cache::Handle* LRUCache::Insert(
     e->in_cache = true;//DHQ: Cache自身对其的ref
     LRU_Append(&in_use_, e);
     usage_ += charge;
+    if (priority == Cache::kHighPriority) {
+      e->in_high_pri_pool = true;
+      high_pri_pool_usage_ += charge;
+    }
     FinishErase(table_.Insert(e)); //DHQ: Insert返回了同样key的old entry，Insert 将其从lru/in_use list删除。 删除前，有user ref，在in_use上，无user ref，则在lru上
   } else {  // don't cache. (capacity_==0 is supported and turns off caching.)
     // next is read by key() in an assert, so it must be initialized
     e->next = nullptr;
   }
-  while (usage_ > capacity_ && lru_.next != &lru_) {//DHQ: 遍历LRU
-    LRUHandle* old = lru_.next;
+  LRUHandle* old;
+  while (usage_ > capacity_ && (old = OldestUnused()) != nullptr) {//DHQ: 遍历LRU
     assert(old->refs == 1);
     bool erased = FinishErase(table_.Remove(old->key(), old->hash)); //从table_删除
     if (!erased) {  // to avoid unused variable when compiled NDEBUG
       assert(erased);
     }
   }
+  MaintainPoolSize();
 
   return reinterpret_cast<Cache::Handle*>(e);
 }
 
+// Return the next entry to evict: the oldest unused low priority entry if
+// there is one, else the oldest unused high priority entry, else nullptr.
+LRUHandle* LRUCache::OldestUnused() {
+  if (lru_.next != &lru_) {
+    return lru_.next;
+  } else if (high_pri_lru_.next != &high_pri_lru_) {
+    return high_pri_lru_.next;
+  }
+  return nullptr;
+}
+
+// Move the oldest unused entries of the high-priority pool to the newest
+// end of the low-priority pool until the pool fits in its capacity.
+// Entries in use stay in the pool until they are released.
+void LRUCache::MaintainPoolSize() {
+  while (high_pri_pool_usage_ > high_pri_pool_capacity_ &&
+         high_pri_lru_.next != &high_pri_lru_) {
+    LRUHandle* e = high_pri_lru_.next;
+    LRU_Remove(e);
+    LRU_Append(&lru_, e);
+    e->in_high_pri_pool = false;
+    high_pri_pool_usage_ -= e->charge;
+  }
+}
+
 // If e != nullptr, finish removing *e from the cache; it has already been
 // removed from the hash table.  Return whether e != nullptr.
 bool LRUCache::FinishErase(LRUHandle* e) {
@@ -313,6 +393,9 @@ bool LRUCache::FinishErase(LRUHandle* e) {
     LRU_Remove(e);//DHQ: 从in_use list删除
     e->in_cache = false;
     usage_ -= e->charge;
+    if (e->in_high_pri_pool) {
+      high_pri_pool_usage_ -= e->charge;
+    }
     Unref(e);
   }
   return e != nullptr;
@@ -325,8 +408,8 @@ void LRUCache::Erase(const Slice& key, uint32_t hash) {//DHQ: 这个是对应提
 
 void LRUCache::Prune() {
   MutexLock l(&mutex_);
-  while (lru_.next != &lru_) {
-    LRUHandle* e = lru_.next;
+  LRUHandle* e;
+  while ((e = OldestUnused()) != nullptr) {
     assert(e->refs == 1);
     bool erased = FinishErase(table_.Remove(e->key(), e->hash));
     if (!erased) {  // to avoid unused variable when compiled NDEBUG
@@ -353,18 +436,24 @@ class ShardedLRUCache : public Cache {
   }
 
  public:
-  explicit ShardedLRUCache(size_t capacity)
+  ShardedLRUCache(size_t capacity, double high_pri_pool_ratio)
       : last_id_(0) {
     const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
     for (int s = 0; s < kNumShards; s++) {
-      shard_[s].SetCapacity(per_shard);
+      shard_[s].SetCapacity(per_shard, high_pri_pool_ratio);
     }
   }
   virtual ~ShardedLRUCache() { }
   virtual Handle* Insert(const Slice& key, void* value, size_t charge,
                          void (*deleter)(const Slice& key, void* value)) {
+    return Insert(key, value, charge, deleter, kLowPriority);
+  }
+  virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+                         void (*deleter)(const Slice& key, void* value),
+                         Priority priority) {
     const uint32_t hash = HashSlice(key);
-    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter);
+    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter,
+                                      priority);
   }
   virtual Handle* Lookup(const Slice& key) {
     const uint32_t hash = HashSlice(key);
@@ -402,7 +491,12 @@ class ShardedLRUCache : public Cache {
 }  // end anonymous namespace
 
 Cache* NewLRUCache(size_t capacity) {
-  return new ShardedLRUCache(capacity);
+  return NewLRUCache(capacity, 0.5);
+}
+
+Cache* NewLRUCache(size_t capacity, double high_pri_pool_ratio) {
+  assert(high_pri_pool_ratio >= 0.0 && high_pri_pool_ratio <= 1.0);
+  return new ShardedLRUCache(capacity, high_pri_pool_ratio);
 }
 
 }  // namespace leveldb
@@ -59,6 +59,12 @@ class CacheTest {
                                    &CacheTest::Deleter));
   }
 
+  void InsertHighPriority(int key, int value, int charge = 1) {
+    cache_->Release(cache_->Insert(EncodeKey(key), EncodeValue(value), charge,
+                                   &CacheTest::Deleter,
+                                   Cache::kHighPriority));
+  }
+
   Cache::Handle* InsertAndReturnHandle(int key, int value, int charge = 1) {
     return cache_->Insert(EncodeKey(key), EncodeValue(value), charge,
                           &CacheTest::Deleter);
@@ -156,6 +162,101 @@ TEST(CacheTest, EvictionPolicy) {
   cache_->Release(h);
 }
 
+TEST(CacheTest, HighPriorityEvictedLast) {
+  InsertHighPriority(100, 101);
+  Insert(200, 201);
+
+  // Unused high priority entries outlive any number of low priority ones.
+  for (int i = 0; i < kCacheSize + 100; i++) {
+    Insert(1000+i, 2000+i);
+  }
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(-1, Lookup(200));
+
+  // Once only high priority entries remain, they are evicted in LRU order.
+  for (int i = 0; i < kCacheSize + 100; i++) {
+    InsertHighPriority(1000+i, 3000+i);
+  }
+  ASSERT_EQ(-1, Lookup(100));
+  ASSERT_EQ(3000+kCacheSize+99, Lookup(1000+kCacheSize+99));
+}
+
+TEST(CacheTest, PruneHighPriority) {
+  InsertHighPriority(1, 100);
+  Insert(2, 200);
+  cache_->Prune();
+  ASSERT_EQ(-1, Lookup(1));
+  ASSERT_EQ(-1, Lookup(2));
+  ASSERT_EQ(0, cache_->TotalCharge());
+}
+
+TEST(CacheTest, ScanResistance) {
+  // Entries used twice are promoted to the high-priority pool.
+  for (int i = 0; i < 100; i++) {
+    Insert(i, 100+i);
+    ASSERT_EQ(100+i, Lookup(i));
+  }
+
+  // A scan that uses each entry once does not evict them.
+  for (int i = 0; i < 2*kCacheSize; i++) {
+    Insert(1000+i, 2000+i);
+  }
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(100+i, Lookup(i));
+  }
+  ASSERT_EQ(-1, Lookup(1000));
+  ASSERT_EQ(2000+2*kCacheSize-1, Lookup(1000+2*kCacheSize-1));
+}
+
+TEST(CacheTest, PrefetchedEntriesUsedOnce) {
+  for (int i = 0; i < 100; i++) {
+    Insert(i, 100+i);
+    ASSERT_EQ(100+i, Lookup(i));
+  }
+
+  // A scan whose entries were prefetched looks each of them up once,
+  // which is their first use, so it does not evict the entries above.
+  for (int i = 0; i < 2*kCacheSize; i++) {
+    cache_->Release(cache_->Insert(EncodeKey(1000+i), EncodeValue(2000+i), 1,
+                                   &CacheTest::Deleter, Cache::kPrefetched));
+    ASSERT_EQ(2000+i, Lookup(1000+i));
+  }
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(100+i, Lookup(i));
+  }
+  ASSERT_EQ(-1, Lookup(1000));
+}
+
+TEST(CacheTest, HighPriorityPoolOverflow) {
+  // Entries beyond the high-priority pool go back to the low-priority
+  // pool, oldest first, and are evicted by a scan.
+  for (int i = 0; i < kCacheSize; i++) {
+    InsertHighPriority(i, 100+i);
+  }
+  for (int i = 0; i < 2*kCacheSize; i++) {
+    Insert(1000+i, 2000+i);
+  }
+  ASSERT_EQ(-1, Lookup(0));
+  ASSERT_EQ(100+kCacheSize-1, Lookup(kCacheSize-1));
+  ASSERT_LE(cache_->TotalCharge(), kCacheSize + kCacheSize/10);
+}
+
+TEST(CacheTest, NoHighPriorityPool) {
+  delete cache_;
+  cache_ = NewLRUCache(kCacheSize, 0.0);
+
+  // Without a high-priority pool, the cache is a plain LRU cache.
+  InsertHighPriority(1, 100);
+  Insert(2, 200);
+  ASSERT_EQ(200, Lookup(2));
+  for (int i = 0; i < 2*kCacheSize; i++) {
+    Insert(1000+i, 2000+i);
+  }
+  ASSERT_EQ(-1, Lookup(1));
+  ASSERT_EQ(-1, Lookup(2));
+  ASSERT_EQ(2000+2*kCacheSize-1, Lookup(1000+2*kCacheSize-1));
+}
+
 TEST(CacheTest, UseExceedsCacheSize) {
   // Overfill the cache, keeping handles on all inserted entries.
   std::vector<Cache::Handle*> h;
@@ -0,0 +1,536 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <vector>
+
+#include "leveldb/cache.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/hash.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+namespace {
+
+// CLOCK cache implementation
+//
+// Unlike the LRU cache, a hit does not take the shard mutex: Lookup()
+// walks the hash chain through atomic pointers, takes a reference with a
+// compare-and-swap on the entry's reference count and sets its usage
+// counter.  Release() of an entry that is still in the cache only
+// decrements the count.  Everything that changes the set of cached
+// entries (Insert, Erase, eviction) runs under the shard mutex.
+//
+// The reference count includes the cache's own reference while an entry
+// is in the cache.  An entry is claimed for eviction by changing its
+// count from 1 (only the cache's reference) to 0 under the mutex; a
+// count of 0 is final, and Lookup() never takes a reference on such an
+// entry.  Eviction is a CLOCK sweep over a ring of all cached entries,
+// which decrements usage counters until it finds an unused entry with a
+// zero counter.
+//
+// Entries and hash bucket arrays that have been unlinked may still be
+// traversed by concurrent lookups, so their memory is only freed once
+// those lookups are done.  Lookups announce themselves in one of two
+// reader counts, selected by the current epoch.  Memory retired during
+// an epoch is freed once the epoch has been flipped and the readers of
+// the old epoch have drained.
+
+struct ClockHandle {
+  void* value;
+  void (*deleter)(const Slice&, void* value);
+  std::atomic<ClockHandle*> next_hash;
+  ClockHandle* next;  // Ring of cached entries; protected by the mutex
+  ClockHandle* prev;
+  size_t charge;
+  size_t key_length;
+  std::atomic<uint32_t> refs;   // References, including the cache's
+  std::atomic<uint8_t> usage;   // Sweeps left before eviction
+  std::atomic<bool> prefetched;  // Not hit since inserted with kPrefetched
+  bool high_priority;
+  uint32_t hash;
+  char key_data[1];   // Beginning of key
+
+  Slice key() const {
+    return Slice(key_data, key_length);
+  }
+};
+
+// Hash table buckets.  The length is kept with the buckets so that a
+// lookup always indexes the array it loaded with its own length.
+struct BucketArray {
+  uint32_t length;
+  std::atomic<ClockHandle*>* buckets;
+};
+
+static void DeleteBucketArray(BucketArray* table) {
+  delete[] table->buckets;
+  delete table;
+}
+
+// Every hit increments the usage counter of an entry, up to a limit
+// that is one higher for high priority entries.  Frequently used entries
+// thus survive more sweeps than entries used only once.
+static const uint8_t kMaxUsage = 3;
+
+static uint8_t UsageLimit(const ClockHandle* e) {
+  return e->high_priority ? kMaxUsage : kMaxUsage - 1;
+}
+
+// A single shard of sharded cache.
+class ClockCache {
+ public:
+  ClockCache();
+  ~ClockCache();
+
+  // Separate from constructor so caller can easily make an array of them
+  void SetCapacity(size_t capacity) { capacity_ = capacity; }
+
+  // Like Cache methods, but with an extra "hash" parameter.
+  Cache::Handle* Insert(const Slice& key, uint32_t hash,
+                        void* value, size_t charge,
+                        void (*deleter)(const Slice& key, void* value),
+                        Cache::Priority priority);
+  Cache::Handle* Lookup(const Slice& key, uint32_t hash);
+  void Release(Cache::Handle* handle);
+  void Erase(const Slice& key, uint32_t hash);
+  void Prune();
+  size_t TotalCharge() const {
+    MutexLock l(&mutex_);
+    return usage_;
+  }
+
+ private:
+  std::atomic<ClockHandle*>* FindPointer(const Slice& key, uint32_t hash)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void TableInsert(ClockHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void Resize() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void RingAppend(ClockHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void RingRemove(ClockHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void Remove(ClockHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void DropCacheReference(ClockHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void Free(ClockHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  bool TryEvict(ClockHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void Reclaim() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Initialized before use.
+  size_t capacity_;
+
+  // Hash table, readable without the mutex
+  std::atomic<BucketArray*> table_;
+
+  // Lookups in progress, by epoch
+  std::atomic<int> epoch_;
+  std::atomic<int> readers_[2];
+
+  // mutex_ protects the following state.
+  mutable port::Mutex mutex_;
+  size_t usage_ GUARDED_BY(mutex_);
+  uint32_t elems_ GUARDED_BY(mutex_);
+  ClockHandle* hand_ GUARDED_BY(mutex_);  // nullptr iff the ring is empty
+
+  // Memory unlinked during each epoch, freed once no lookup can reach it
+  std::vector<ClockHandle*> retired_handles_[2] GUARDED_BY(mutex_);
+  std::vector<BucketArray*> retired_tables_[2] GUARDED_BY(mutex_);
+};
+
+ClockCache::ClockCache()
+    : capacity_(0),
+      table_(nullptr),
+      epoch_(0),
+      usage_(0),
+      elems_(0),
+      hand_(nullptr) {
+  readers_[0].store(0);
+  readers_[1].store(0);
+  MutexLock l(&mutex_);
+  Resize();
+}
+
+ClockCache::~ClockCache() {
+  MutexLock l(&mutex_);
+  while (hand_ != nullptr) {
+    ClockHandle* e = hand_;
+    assert(e->refs.load() == 1);  // Error if caller has an unreleased handle
+    RingRemove(e);
+    (*e->deleter)(e->key(), e->value);
+    free(e);
+  }
+  for (int i = 0; i < 2; i++) {
+    for (size_t j = 0; j < retired_handles_[i].size(); j++) {
+      free(retired_handles_[i][j]);
+    }
+    for (size_t j = 0; j < retired_tables_[i].size(); j++) {
+      DeleteBucketArray(retired_tables_[i][j]);
+    }
+  }
+  DeleteBucketArray(table_.load());
+}
+
+Cache::Handle* ClockCache::Lookup(const Slice& key, uint32_t hash) {
+  // Register as a reader of the current epoch.  If the epoch changes
+  // before we are counted, memory retired before the change may already
+  // be gone, so register again.
+  int epoch;
+  while (true) {
+    epoch = epoch_.load();
+    readers_[epoch].fetch_add(1);
+    if (epoch_.load() == epoch) break;
+    readers_[epoch].fetch_sub(1);
+  }
+
+  ClockHandle* result = nullptr;
+  const BucketArray* table = table_.load(std::memory_order_acquire);
+  for (ClockHandle* e = table->buckets[hash & (table->length - 1)].load(
+           std::memory_order_acquire);
+       e != nullptr;
+       e = e->next_hash.load(std::memory_order_acquire)) {
+    if (e->hash != hash || key != e->key()) {
+      continue;
+    }
+    uint32_t refs = e->refs.load();
+    while (refs != 0 && !e->refs.compare_exchange_weak(refs, refs + 1)) {
+    }
+    if (refs != 0) {
+      // Racing hits may lose increments, which does not matter.  The
+      // first hit of a prefetched entry is its first use.
+      const uint8_t usage = e->usage.load(std::memory_order_relaxed);
+      if (e->prefetched.load(std::memory_order_relaxed)) {
+        e->prefetched.store(false, std::memory_order_relaxed);
+      } else if (usage < UsageLimit(e)) {
+        e->usage.store(usage + 1, std::memory_order_relaxed);
+      }
+      result = e;
+      break;
+    }
+    // Evicted or erased concurrently; a newer entry may follow
+  }
+
+  readers_[epoch].fetch_sub(1);
+  return reinterpret_cast<Cache::Handle*>(result);
+}
+
+void ClockCache::Release(Cache::Handle* handle) {
+  ClockHandle* e = reinterpret_cast<ClockHandle*>(handle);
+  if (e->refs.fetch_sub(1) == 1) {
+    // The cache had already dropped its reference
+    MutexLock l(&mutex_);
+    Free(e);
+  }
+}
+
+Cache::Handle* ClockCache::Insert(
+    const Slice& key, uint32_t hash, void* value, size_t charge,
+    void (*deleter)(const Slice& key, void* value),
+    Cache::Priority priority) {
+  ClockHandle* e = reinterpret_cast<ClockHandle*>(
+      malloc(sizeof(ClockHandle)-1 + key.size()));
+  e->value = value;
+  e->deleter = deleter;
+  e->next_hash.store(nullptr, std::memory_order_relaxed);
+  e->next = e->prev = nullptr;
+  e->charge = charge;
+  e->key_length = key.size();
+  e->refs.store(1, std::memory_order_relaxed);  // for the returned handle.
+  e->usage.store(0, std::memory_order_relaxed);
+  e->prefetched.store(priority == Cache::kPrefetched,
+                      std::memory_order_relaxed);
+  e->high_priority = (priority == Cache::kHighPriority);
+  e->hash = hash;
+  memcpy(e->key_data, key.data(), key.size());
+
+  MutexLock l(&mutex_);
+  if (capacity_ > 0) {
+    e->refs.fetch_add(1);  // for the cache's reference.
+    usage_ += charge;
+    TableInsert(e);
+    RingAppend(e);
+  }  // else don't cache. (capacity_==0 is supported and turns off caching.)
+
+  // CLOCK sweep.  Each turn of the hand decrements every usage counter,
+  // so kMaxUsage + 1 turns reach every entry that can be evicted.
+  size_t steps = 0;
+  const size_t max_steps = (kMaxUsage + 1) * static_cast<size_t>(elems_);
+  while (usage_ > capacity_ && hand_ != nullptr && steps < max_steps) {
+    ClockHandle* candidate = hand_;
+    hand_ = candidate->next;
+    steps++;
+    if (candidate != e) {
+      TryEvict(candidate);
+    }
+  }
+  Reclaim();
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+// Evicts "e" unless it is in use or has been used since the last sweep.
+// Returns whether it was evicted.
+bool ClockCache::TryEvict(ClockHandle* e) {
+  uint8_t usage = e->usage.load(std::memory_order_relaxed);
+  if (usage > 0) {
+    e->usage.store(usage - 1, std::memory_order_relaxed);
+    return false;
+  }
+  uint32_t only_cache = 1;
+  if (!e->refs.compare_exchange_strong(only_cache, 0)) {
+    return false;  // In use
+  }
+  Remove(e);
+  Free(e);
+  return true;
+}
+
+void ClockCache::Erase(const Slice& key, uint32_t hash) {
+  MutexLock l(&mutex_);
+  ClockHandle* e = FindPointer(key, hash)->load(std::memory_order_relaxed);
+  if (e != nullptr) {
+    Remove(e);
+    DropCacheReference(e);
+  }
+  Reclaim();
+}
+
+void ClockCache::Prune() {
+  MutexLock l(&mutex_);
+  ClockHandle* e = hand_;
+  for (uint32_t n = elems_; n > 0; n--) {
+    ClockHandle* next = e->next;
+    uint32_t only_cache = 1;
+    if (e->refs.compare_exchange_strong(only_cache, 0)) {
+      Remove(e);
+      Free(e);
+    }
+    e = next;
+  }
+  Reclaim();
+}
+
+// Return a pointer to slot that points to a cache entry that
+// matches key/hash.  If there is no such cache entry, return a
+// pointer to the trailing slot in the corresponding linked list.
+std::atomic<ClockHandle*>* ClockCache::FindPointer(const Slice& key,
+                                                   uint32_t hash) {
+  BucketArray* table = table_.load(std::memory_order_relaxed);
+  std::atomic<ClockHandle*>* ptr = &table->buckets[hash & (table->length - 1)];
+  ClockHandle* e;
+  while ((e = ptr->load(std::memory_order_relaxed)) != nullptr &&
+         (e->hash != hash || key != e->key())) {
+    ptr = &e->next_hash;
+  }
+  return ptr;
+}
+
+void ClockCache::TableInsert(ClockHandle* e) {
+  std::atomic<ClockHandle*>* ptr = FindPointer(e->key(), e->hash);
+  ClockHandle* old = ptr->load(std::memory_order_relaxed);
+  if (old != nullptr) {
+    // Replace the old entry in place, then let go of it
+    e->next_hash.store(old->next_hash.load(std::memory_order_relaxed),
+                       std::memory_order_relaxed);
+    ptr->store(e, std::memory_order_release);
+    RingRemove(old);
+    usage_ -= old->charge;
+    DropCacheReference(old);
+    return;
+  }
+  ptr->store(e, std::memory_order_release);
+  ++elems_;
+  if (elems_ > table_.load(std::memory_order_relaxed)->length) {
+    // Since each cache entry is fairly large, we aim for a small
+    // average linked list length (<= 1).
+    Resize();
+  }
+}
+
+// Builds a new bucket array.  Entries are relinked in place, so a
+// concurrent lookup may be led into another chain and miss its key,
+// which is harmless for a cache; every chain stays acyclic and
+// nullptr-terminated throughout.
+void ClockCache::Resize() {
+  uint32_t new_length = 4;
+  while (new_length < elems_) {
+    new_length *= 2;
+  }
+  BucketArray* new_table = new BucketArray;
+  new_table->length = new_length;
+  new_table->buckets = new std::atomic<ClockHandle*>[new_length];
+  for (uint32_t i = 0; i < new_length; i++) {
+    new_table->buckets[i].store(nullptr, std::memory_order_relaxed);
+  }
+  BucketArray* old_table = table_.load(std::memory_order_relaxed);
+  const uint32_t old_length = (old_table == nullptr) ? 0 : old_table->length;
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < old_length; i++) {
+    ClockHandle* h = old_table->buckets[i].load(std::memory_order_relaxed);
+    while (h != nullptr) {
+      ClockHandle* next = h->next_hash.load(std::memory_order_relaxed);
+      std::atomic<ClockHandle*>* ptr =
+          &new_table->buckets[h->hash & (new_length - 1)];
+      h->next_hash.store(ptr->load(std::memory_order_relaxed),
+                         std::memory_order_release);
+      ptr->store(h, std::memory_order_relaxed);
+      h = next;
+      count++;
+    }
+  }
+  assert(elems_ == count);
+  table_.store(new_table, std::memory_order_release);
+  if (old_table != nullptr) {
+    retired_tables_[epoch_.load()].push_back(old_table);
+  }
+}
+
+void ClockCache::RingAppend(ClockHandle* e) {
+  if (hand_ == nullptr) {
+    e->next = e->prev = e;
+    hand_ = e;
+  } else {
+    // Just behind the hand, i.e. last in line for the next sweep
+    e->next = hand_;
+    e->prev = hand_->prev;
+    e->prev->next = e;
+    e->next->prev = e;
+  }
+}
+
+void ClockCache::RingRemove(ClockHandle* e) {
+  if (e->next == e) {
+    hand_ = nullptr;
+  } else {
+    if (hand_ == e) {
+      hand_ = e->next;
+    }
+    e->next->prev = e->prev;
+    e->prev->next = e->next;
+  }
+  e->next = e->prev = nullptr;
+}
+
+// Unlinks "e" from the hash table and the ring.
+void ClockCache::Remove(ClockHandle* e) {
+  std::atomic<ClockHandle*>* ptr = FindPointer(e->key(), e->hash);
+  assert(ptr->load(std::memory_order_relaxed) == e);
+  ptr->store(e->next_hash.load(std::memory_order_relaxed),
+             std::memory_order_release);
+  --elems_;
+  RingRemove(e);
+  usage_ -= e->charge;
+}
+
+void ClockCache::DropCacheReference(ClockHandle* e) {
+  if (e->refs.fetch_sub(1) == 1) {
+    Free(e);
+  }
+}
+
+// Deletes the value of "e", which no one references any more, and
+// retires its memory.
+void ClockCache::Free(ClockHandle* e) {
+  (*e->deleter)(e->key(), e->value);
+  retired_handles_[epoch_.load()].push_back(e);
+}
+
+void ClockCache::Reclaim() {
+  const int current = epoch_.load();
+  const int previous = 1 - current;
+  if (readers_[previous].load() != 0) {
+    return;  // Try again later
+  }
+  // No lookup started before the last flip is still running
+  for (size_t i = 0; i < retired_handles_[previous].size(); i++) {
+    free(retired_handles_[previous][i]);
+  }
+  for (size_t i = 0; i < retired_tables_[previous].size(); i++) {
+    DeleteBucketArray(retired_tables_[previous][i]);
+  }
+  retired_handles_[previous].clear();
+  retired_tables_[previous].clear();
+  if (!retired_handles_[current].empty() ||
+      !retired_tables_[current].empty()) {
+    epoch_.store(previous);
+  }
+}
+
+static const int kNumShardBits = 4;
+static const int kNumShards = 1 << kNumShardBits;
+
+class ShardedClockCache : public Cache {
+ private:
+  ClockCache shard_[kNumShards];
+  port::Mutex id_mutex_;
+  uint64_t last_id_;
+
+  static inline uint32_t HashSlice(const Slice& s) {
+    return Hash(s.data(), s.size(), 0);
+  }
+
+  static uint32_t Shard(uint32_t hash) {
+    return hash >> (32 - kNumShardBits);
+  }
+
+ public:
+  explicit ShardedClockCache(size_t capacity)
+      : last_id_(0) {
+    const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
+    for (int s = 0; s < kNumShards; s++) {
+      shard_[s].SetCapacity(per_shard);
+    }
+  }
+  virtual ~ShardedClockCache() { }
+  virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+                         void (*deleter)(const Slice& key, void* value)) {
+    return Insert(key, value, charge, deleter, kLowPriority);
+  }
+  virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+                         void (*deleter)(const Slice& key, void* value),
+                         Priority priority) {
+    const uint32_t hash = HashSlice(key);
+    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter,
+                                      priority);
+  }
+  virtual Handle* Lookup(const Slice& key) {
+    const uint32_t hash = HashSlice(key);
+    return shard_[Shard(hash)].Lookup(key, hash);
+  }
+  virtual void Release(Handle* handle) {
+    ClockHandle* h = reinterpret_cast<ClockHandle*>(handle);
+    shard_[Shard(h->hash)].Release(handle);
+  }
+  virtual void Erase(const Slice& key) {
+    const uint32_t hash = HashSlice(key);
+    shard_[Shard(hash)].Erase(key, hash);
+  }
+  virtual void* Value(Handle* handle) {
+    return reinterpret_cast<ClockHandle*>(handle)->value;
+  }
+  virtual uint64_t NewId() {
+    MutexLock l(&id_mutex_);
+    return ++(last_id_);
+  }
+  virtual void Prune() {
+    for (int s = 0; s < kNumShards; s++) {
+      shard_[s].Prune();
+    }
+  }
+  virtual size_t TotalCharge() const {
+    size_t total = 0;
+    for (int s = 0; s < kNumShards; s++) {
+      total += shard_[s].TotalCharge();
+    }
+    return total;
+  }
+};
+
+}  // end anonymous namespace
+
+Cache* NewClockCache(size_t capacity) {
+  return new ShardedClockCache(capacity);
+}
+
+}  // namespace leveldb
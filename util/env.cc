@@ -13,12 +13,33 @@ Status Env::NewAppendableFile(const std::string& fname, WritableFile** result) {
   return Status::NotSupported("NewAppendableFile", fname);
 }
 
+Status Env::NewUnmappedRandomAccessFile(const std::string& fname,
+                                        RandomAccessFile** result) {
+  return NewRandomAccessFile(fname, result);
+}
+
+void Env::SetMaxMappedFiles(int n) {
+}
+
+Status Env::NewDirectRandomAccessFile(const std::string& fname,
+                                      RandomAccessFile** result) {
+  return NewRandomAccessFile(fname, result);
+}
+
+Status Env::NewDirectWritableFile(const std::string& fname,
+                                  WritableFile** result) {
+  return NewWritableFile(fname, result);
+}
+
 SequentialFile::~SequentialFile() {
 }
 
 RandomAccessFile::~RandomAccessFile() {
 }
 
+void RandomAccessFile::Hint(AccessPattern pattern) {
+}
+
 WritableFile::~WritableFile() {
 }
 
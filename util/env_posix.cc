@@ -43,6 +43,13 @@ static int mmap_limit = -1;
 
 static const size_t kBufSize = 65536;
 
+// Alignment of the offsets, lengths and buffers of direct I/O.  4096
+// covers the logical block size of all common devices.
+static const size_t kDirectIOAlignment = 4096;
+
+// Size of the write buffer of files opened for direct I/O.
+static const size_t kDirectBufSize = 1 << 20;
+
 static Status PosixError(const std::string& context, int err_number) {
   if (err_number == ENOENT) {
     return Status::NotFound(context, strerror(err_number));
@@ -58,10 +65,18 @@ static Status PosixError(const std::string& context, int err_number) {
 class Limiter {
  public:
   // Limit maximum number of resources to |n|.
-  Limiter(intptr_t n) {
+  Limiter(intptr_t n) : limit_(n) {
     SetAllowed(n);
   }
 
+  // Change the limit to |n|.  Resources already acquired beyond the new
+  // limit are kept until they are released.
+  void SetLimit(intptr_t n) LOCKS_EXCLUDED(mu_) {
+    MutexLock l(&mu_);
+    SetAllowed(GetAllowed() + n - limit_);
+    limit_ = n;
+  }
+
   // If another resource is available, acquire it and return true.
   // Else return false.
   bool Acquire() LOCKS_EXCLUDED(mu_) {
@@ -88,6 +103,7 @@ class Limiter {
  private:
   port::Mutex mu_;
   port::AtomicPointer allowed_;
+  intptr_t limit_ GUARDED_BY(mu_);
 
   intptr_t GetAllowed() const {
     return reinterpret_cast<intptr_t>(allowed_.Acquire_Load());
@@ -185,6 +201,28 @@ class PosixRandomAccessFile: public RandomAccessFile {
     }
     return s;
   }
+
+  virtual void Hint(AccessPattern pattern) {
+#if defined(POSIX_FADV_SEQUENTIAL)
+    if (temporary_fd_) {
+      return;  // Nothing to apply the advice to
+    }
+    switch (pattern) {
+      case kNormal:
+        posix_fadvise(fd_, 0, 0, POSIX_FADV_NORMAL);
+        break;
+      case kSequential:
+        posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+        break;
+      case kRandom:
+        posix_fadvise(fd_, 0, 0, POSIX_FADV_RANDOM);
+        break;
+      case kDontNeed:
+        posix_fadvise(fd_, 0, 0, POSIX_FADV_DONTNEED);
+        break;
+    }
+#endif
+  }
 };
 
 // mmap() based random-access
@@ -219,6 +257,25 @@ class PosixMmapReadableFile: public RandomAccessFile {
     }
     return s;
   }
+
+  // The mapping is shared by all readers of the table, including point
+  // lookups, so sequential access is not advised: MADV_SEQUENTIAL would
+  // let the kernel drop pages right after they are read.  Instead
+  // kSequential restores the default readahead that kRandom turns off.
+  virtual void Hint(AccessPattern pattern) {
+    switch (pattern) {
+      case kNormal:
+      case kSequential:
+        madvise(mmapped_region_, length_, MADV_NORMAL);
+        break;
+      case kRandom:
+        madvise(mmapped_region_, length_, MADV_RANDOM);
+        break;
+      case kDontNeed:
+        madvise(mmapped_region_, length_, MADV_DONTNEED);
+        break;
+    }
+  }
 };
 
 class PosixWritableFile : public WritableFile {
@@ -348,6 +405,259 @@ class PosixWritableFile : public WritableFile {
   }
 };
 
+static uint64_t RoundDown(uint64_t n) {
+  return n & ~static_cast<uint64_t>(kDirectIOAlignment - 1);
+}
+
+static uint64_t RoundUp(uint64_t n) {
+  return RoundDown(n + kDirectIOAlignment - 1);
+}
+
+static char* NewAlignedBuffer(size_t size) {
+  void* buf = nullptr;
+  if (posix_memalign(&buf, kDirectIOAlignment, size) != 0) {
+    return nullptr;
+  }
+  return reinterpret_cast<char*>(buf);
+}
+
+// Opens fname with "flags" for I/O that bypasses the page cache.
+// Returns -1 with errno set to EINVAL if the file system does not
+// support direct I/O.
+static int OpenDirect(const std::string& fname, int flags) {
+#if defined(O_DIRECT)
+  return open(fname.c_str(), flags | O_DIRECT, 0644);
+#elif defined(F_NOCACHE)
+  int fd = open(fname.c_str(), flags, 0644);
+  if (fd >= 0 && fcntl(fd, F_NOCACHE, 1) < 0) {
+    close(fd);
+    errno = EINVAL;
+    return -1;
+  }
+  return fd;
+#else
+  errno = EINVAL;
+  return -1;
+#endif
+}
+
+// pread() based random access that bypasses the page cache.  Direct I/O
+// requires aligned offsets, lengths and buffers, so reads that are not
+// aligned go through an aligned buffer covering the pages they touch.
+// The file keeps one such buffer for reuse; a reader that finds it taken
+// by a concurrent read allocates its own.
+class PosixDirectRandomAccessFile: public RandomAccessFile {
+ private:
+  // Larger bounce buffers are freed after use rather than kept.
+  static const size_t kMaxRetainedBuffer = 64 << 10;
+
+  std::string filename_;
+  int fd_;
+  mutable port::Mutex mu_;
+  mutable char* buf_ GUARDED_BY(mu_);  // nullptr while in use
+  mutable size_t buf_size_ GUARDED_BY(mu_);
+
+ public:
+  PosixDirectRandomAccessFile(const std::string& fname, int fd)
+      : filename_(fname), fd_(fd), buf_(nullptr), buf_size_(0) { }
+
+  virtual ~PosixDirectRandomAccessFile() {
+    free(buf_);
+    close(fd_);
+  }
+
+  virtual Status Read(uint64_t offset, size_t n, Slice* result,
+                      char* scratch) const {
+    const uint64_t start = RoundDown(offset);
+    const uint64_t end = RoundUp(offset + n);
+    if (start == offset && end == offset + n &&
+        reinterpret_cast<uintptr_t>(scratch) % kDirectIOAlignment == 0) {
+      size_t r = 0;
+      Status s = ReadAligned(offset, n, scratch, &r);
+      *result = Slice(scratch, r);
+      return s;
+    }
+
+    const size_t size = end - start;
+    char* buf;
+    size_t buf_size;
+    {
+      MutexLock l(&mu_);
+      buf = buf_;
+      buf_size = buf_size_;
+      buf_ = nullptr;
+      buf_size_ = 0;
+    }
+    if (buf_size < size) {
+      free(buf);
+      buf = NewAlignedBuffer(size);
+      buf_size = size;
+      if (buf == nullptr) {
+        *result = Slice();
+        return PosixError(filename_, ENOMEM);
+      }
+    }
+    size_t r = 0;
+    Status s = ReadAligned(start, size, buf, &r);
+    const size_t skip = offset - start;
+    r = (r > skip) ? std::min(r - skip, n) : 0;
+    memcpy(scratch, buf + skip, r);
+    *result = Slice(scratch, r);
+    ReleaseBuffer(buf, buf_size);
+    return s;
+  }
+
+ private:
+  // Keeps buf for the next unaligned read unless it is too large or
+  // another reader already returned one.
+  void ReleaseBuffer(char* buf, size_t size) const {
+    if (size <= kMaxRetainedBuffer) {
+      MutexLock l(&mu_);
+      if (buf_ == nullptr) {
+        buf_ = buf;
+        buf_size_ = size;
+        return;
+      }
+    }
+    free(buf);
+  }
+
+  // Reads up to n bytes at offset into buf, stopping early only at the
+  // end of the file.  Stores the number of bytes read in *bytes.
+  Status ReadAligned(uint64_t offset, size_t n, char* buf,
+                     size_t* bytes) const {
+    *bytes = 0;
+    while (*bytes < n) {
+      ssize_t r = pread(fd_, buf + *bytes, n - *bytes,
+                        static_cast<off_t>(offset + *bytes));
+      if (r < 0) {
+        if (errno == EINTR) {
+          continue;  // Retry
+        }
+        return PosixError(filename_, errno);
+      }
+      if (r == 0) {
+        break;  // End of file
+      }
+      *bytes += r;
+    }
+    return Status::OK();
+  }
+};
+
+// Writable file that bypasses the page cache.  Data is gathered in an
+// aligned buffer that is written out in whole pages once it fills up.
+// Sync() and Close() also write the partly filled last page, padded, and
+// then truncate the file to its real size; the partial page stays in the
+// buffer to be written again once more data is appended.  Flush() does
+// nothing, since writing partial pages on every call would cost a
+// rewrite of the last page each time.
+class PosixDirectWritableFile : public WritableFile {
+ private:
+  // buf_[0, pos_-1] contains data to be written to fd_ at file_offset_.
+  std::string filename_;
+  int fd_;
+  char* buf_;
+  size_t pos_;
+  uint64_t file_offset_;  // Always a multiple of kDirectIOAlignment
+
+ public:
+  PosixDirectWritableFile(const std::string& fname, int fd, char* buf)
+      : filename_(fname), fd_(fd), buf_(buf), pos_(0), file_offset_(0) { }
+
+  ~PosixDirectWritableFile() {
+    if (fd_ >= 0) {
+      // Ignoring any potential errors
+      Close();
+    }
+    free(buf_);
+  }
+
+  virtual Status Append(const Slice& data) {
+    const char* p = data.data();
+    size_t n = data.size();
+    while (n > 0) {
+      const size_t copy = std::min(n, kDirectBufSize - pos_);
+      memcpy(buf_ + pos_, p, copy);
+      p += copy;
+      n -= copy;
+      pos_ += copy;
+      if (pos_ == kDirectBufSize) {
+        Status s = WriteAligned(kDirectBufSize);
+        if (!s.ok()) {
+          return s;
+        }
+        file_offset_ += kDirectBufSize;
+        pos_ = 0;
+      }
+    }
+    return Status::OK();
+  }
+
+  virtual Status Close() {
+    Status result = WriteTail();
+    const int r = close(fd_);
+    if (r < 0 && result.ok()) {
+      result = PosixError(filename_, errno);
+    }
+    fd_ = -1;
+    return result;
+  }
+
+  virtual Status Flush() {
+    return Status::OK();
+  }
+
+  virtual Status Sync() {
+    Status s = WriteTail();
+    if (s.ok() && fdatasync(fd_) != 0) {
+      s = PosixError(filename_, errno);
+    }
+    return s;
+  }
+
+ private:
+  // Writes out buf_[0, pos_-1], padded to whole pages, and truncates the
+  // file to its real size.  Keeps the partial last page in buf_.
+  Status WriteTail() {
+    if (pos_ == 0) {
+      return Status::OK();
+    }
+    const size_t padded = RoundUp(pos_);
+    memset(buf_ + pos_, 0, padded - pos_);
+    Status s = WriteAligned(padded);
+    if (s.ok() &&
+        ftruncate(fd_, static_cast<off_t>(file_offset_ + pos_)) != 0) {
+      s = PosixError(filename_, errno);
+    }
+    if (s.ok()) {
+      const size_t full = RoundDown(pos_);
+      memmove(buf_, buf_ + full, pos_ - full);
+      file_offset_ += full;
+      pos_ -= full;
+    }
+    return s;
+  }
+
+  // Writes buf_[0, n-1] at file_offset_.
+  // REQUIRES: n is a multiple of kDirectIOAlignment
+  Status WriteAligned(size_t n) {
+    size_t done = 0;
+    while (done < n) {
+      ssize_t r = pwrite(fd_, buf_ + done, n - done,
+                         static_cast<off_t>(file_offset_ + done));
+      if (r < 0) {
+        if (errno == EINTR) {
+          continue;  // Retry
+        }
+        return PosixError(filename_, errno);
+      }
+      done += r;
+    }
+    return Status::OK();
+  }
+};
+
 static int LockOrUnlock(int fd, bool lock) {
   errno = 0;
   struct flock f;
@@ -432,6 +742,21 @@ class PosixEnv : public Env {
     return s;
   }
 
+  virtual Status NewUnmappedRandomAccessFile(const std::string& fname,
+                                             RandomAccessFile** result) {
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0) {
+      *result = nullptr;
+      return PosixError(fname, errno);
+    }
+    *result = new PosixRandomAccessFile(fname, fd, &fd_limit_);
+    return Status::OK();
+  }
+
+  virtual void SetMaxMappedFiles(int n) {
+    mmap_limit_.SetLimit(n);
+  }
+
   virtual Status NewWritableFile(const std::string& fname,
                                  WritableFile** result) {
     Status s;
@@ -458,6 +783,42 @@ class PosixEnv : public Env {
     return s;
   }
 
+  virtual Status NewDirectRandomAccessFile(const std::string& fname,
+                                           RandomAccessFile** result) {
+    *result = nullptr;
+    int fd = OpenDirect(fname, O_RDONLY);
+    if (fd < 0 && errno == EINVAL) {
+      // No direct I/O on this file system.  Still use pread() rather
+      // than mmap(), so that the blocks read can go to the block cache.
+      return NewUnmappedRandomAccessFile(fname, result);
+    }
+    if (fd < 0) {
+      return PosixError(fname, errno);
+    }
+    *result = new PosixDirectRandomAccessFile(fname, fd);
+    return Status::OK();
+  }
+
+  virtual Status NewDirectWritableFile(const std::string& fname,
+                                       WritableFile** result) {
+    *result = nullptr;
+    const int flags = O_TRUNC | O_WRONLY | O_CREAT;
+    int fd = OpenDirect(fname, flags);
+    if (fd < 0 && errno == EINVAL) {
+      return NewWritableFile(fname, result);  // No direct I/O available
+    }
+    if (fd < 0) {
+      return PosixError(fname, errno);
+    }
+    char* buf = NewAlignedBuffer(kDirectBufSize);
+    if (buf == nullptr) {
+      close(fd);
+      return PosixError(fname, ENOMEM);
+    }
+    *result = new PosixDirectWritableFile(fname, fd, buf);
+    return Status::OK();
+  }
+
   virtual bool FileExists(const std::string& fname) {
     return access(fname.c_str(), F_OK) == 0;
   }
@@ -729,6 +1090,8 @@ void PosixEnv::StartThread(void (*function)(void* arg), void* arg) {
   state->arg = arg;
   PthreadCall("start thread",
               pthread_create(&t, nullptr,  &StartThreadWrapper, state));
+  // Nobody joins the thread, so let it release its resources on exit
+  PthreadCall("detach thread", pthread_detach(t));
 }
 
 }  // namespace
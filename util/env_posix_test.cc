@@ -56,6 +56,93 @@ TEST(EnvPosixTest, TestOpenOnRead) {
   ASSERT_OK(env_->DeleteFile(test_file));
 }
 
+TEST(EnvPosixTest, MaxMappedFiles) {
+  std::string test_dir;
+  ASSERT_OK(env_->GetTestDirectory(&test_dir));
+  std::string test_file = test_dir + "/max_mapped_files.txt";
+  ASSERT_OK(WriteStringToFile(env_, "abcdefghijklmnopqrstuvwxyz", test_file));
+
+  // Reads of mapped files point into the mapping rather than scratch.
+  char scratch[10];
+  Slice result;
+  RandomAccessFile* file;
+  ASSERT_OK(env_->NewRandomAccessFile(test_file, &file));
+  ASSERT_OK(file->Read(1, 3, &result, scratch));
+  ASSERT_EQ("bcd", result.ToString());
+  ASSERT_TRUE(result.data() != scratch);
+  delete file;
+
+  ASSERT_OK(env_->NewUnmappedRandomAccessFile(test_file, &file));
+  ASSERT_OK(file->Read(1, 3, &result, scratch));
+  ASSERT_EQ("bcd", result.ToString());
+  ASSERT_TRUE(result.data() == scratch);
+  delete file;
+
+  env_->SetMaxMappedFiles(0);
+  ASSERT_OK(env_->NewRandomAccessFile(test_file, &file));
+  file->Hint(RandomAccessFile::kRandom);
+  ASSERT_OK(file->Read(1, 3, &result, scratch));
+  ASSERT_EQ("bcd", result.ToString());
+  ASSERT_TRUE(result.data() == scratch);
+  delete file;
+  env_->SetMaxMappedFiles(kMMapLimit);
+  ASSERT_OK(env_->DeleteFile(test_file));
+}
+
+TEST(EnvPosixTest, DirectIO) {
+  std::string test_dir;
+  ASSERT_OK(env_->GetTestDirectory(&test_dir));
+  std::string test_file = test_dir + "/direct_io.txt";
+
+  // Unaligned appends that fill the write buffer more than once, with a
+  // Sync() of a partial page in between.
+  std::string data;
+  for (int i = 0; data.size() < 3 << 20; i++) {
+    data.append(std::string(1 + (i * 7919) % 10000, 'a' + i % 26));
+  }
+  WritableFile* writable_file;
+  ASSERT_OK(env_->NewDirectWritableFile(test_file, &writable_file));
+  const size_t half = data.size() / 2 + 123;
+  ASSERT_OK(writable_file->Append(Slice(data.data(), half)));
+  ASSERT_OK(writable_file->Sync());
+  uint64_t size;
+  ASSERT_OK(env_->GetFileSize(test_file, &size));
+  ASSERT_EQ(half, size);
+  ASSERT_OK(writable_file->Append(Slice(data.data() + half,
+                                        data.size() - half)));
+  ASSERT_OK(writable_file->Close());
+  delete writable_file;
+  ASSERT_OK(env_->GetFileSize(test_file, &size));
+  ASSERT_EQ(data.size(), size);
+
+  RandomAccessFile* file;
+  ASSERT_OK(env_->NewDirectRandomAccessFile(test_file, &file));
+  std::string scratch(100000, '\0');
+  Slice result;
+  const uint64_t offsets[] = { 0, 1, 4095, 4096, half, data.size() - 10 };
+  for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+    const size_t n = std::min<size_t>(scratch.size(),
+                                      data.size() - offsets[i]);
+    ASSERT_OK(file->Read(offsets[i], n, &result, &scratch[0]));
+    ASSERT_TRUE(result == Slice(data.data() + offsets[i], n));
+  }
+
+  // Small unaligned reads of varying sizes, which reuse the file's
+  // bounce buffer.
+  for (int i = 0; i < 100; i++) {
+    const uint64_t offset = (i * 104729) % (data.size() - 20000);
+    const size_t n = 1 + (i * 7919) % 20000;
+    ASSERT_OK(file->Read(offset, n, &result, &scratch[0]));
+    ASSERT_TRUE(result == Slice(data.data() + offset, n));
+  }
+
+  // Reads past the end of the file are cut short.
+  ASSERT_OK(file->Read(data.size() - 5, 100, &result, &scratch[0]));
+  ASSERT_TRUE(result == Slice(data.data() + data.size() - 5, 5));
+  delete file;
+  ASSERT_OK(env_->DeleteFile(test_file));
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
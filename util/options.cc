@@ -18,13 +18,28 @@ Options::Options()
       info_log(nullptr),
       write_buffer_size(4<<20),
       max_open_files(1000),
+      preload_tables_on_open(false),
+      max_file_opening_threads(16),
       block_cache(nullptr),
+      cache_index_and_filter_blocks(false),
+      pin_l0_filter_and_index_blocks_in_cache(false),
+      row_cache(nullptr),
+      compressed_block_cache(nullptr),
+      persistent_cache(nullptr),
       block_size(4096),
       block_restart_interval(16),
       max_file_size(2<<20),
+      compaction_readahead_size(2<<20),
+      mmap_max_level(6),
+      mmap_max_file_size(0),
+      advise_random_on_open(false),
+      use_direct_reads(false),
+      use_direct_io_for_flush_and_compaction(false),
       compression(kSnappyCompression),
       reuse_logs(false),
-      filter_policy(nullptr) {
+      filter_policy(nullptr),
+      full_filter(false),
+      prefix_extractor(nullptr) {
 }
 
 }  // namespace leveldb
@@ -0,0 +1,393 @@
+// Copyright (c) 2012 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/persistent_cache.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "leveldb/env.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+#include "util/logging.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+PersistentCache::~PersistentCache() { }
+
+namespace {
+
+// Log-structured persistent cache
+//
+// Entries are appended to an in-memory buffer that becomes a segment file
+// in the cache directory once it holds segment_size_ bytes.  Segment
+// files are never modified; when the segments take up more than the
+// capacity, the oldest one is deleted along with the entries it holds.
+// Each entry is stored as a record:
+//
+//    checksum: uint32     // masked crc32c of key_size, data_size, key, data
+//    key_size: uint32
+//    data_size: uint32
+//    key: uint8[key_size]
+//    data: uint8[data_size]
+//
+// The in-memory index maps every key to the place of its data in the
+// newest segment holding it.  Opening the cache rebuilds the index by
+// reading all segments, stopping at the first bad record of each, e.g.
+// one that was only partly written before a crash.
+//
+// Reads from segment files are done without holding the mutex, so each
+// segment is reference counted and its file is only closed once the
+// segment has been dropped and the last read of it is done.  Likewise the
+// buffer of a full segment is written to its file without holding the
+// mutex, so that readers and writers do not wait for the I/O; its entries
+// are served from the buffer until the file is open.  The files of dropped
+// segments are also deleted after the mutex is released.
+
+static const size_t kHeaderSize = 4 + 4 + 4;
+
+class LogStructuredCache : public PersistentCache {
+ public:
+  LogStructuredCache(Env* env, const std::string& dir, uint64_t capacity);
+  ~LogStructuredCache() override;
+
+  // Rebuild the index from the segment files in the directory.
+  Status Recover();
+
+  Status Insert(const Slice& key, const Slice& data) override;
+  Status Lookup(const Slice& key, std::string* data) override;
+  uint64_t TotalSize() override;
+
+ private:
+  struct Segment {
+    uint64_t number;
+    RandomAccessFile* file;  // nullptr until the segment has been written
+    std::string buffer;      // Contents of the segment while file is nullptr
+    uint64_t size;
+    int refs;
+    std::vector<std::string> keys;  // Keys of the records in the segment
+  };
+
+  struct Location {
+    Segment* segment;
+    uint64_t offset;  // Offset of the data in the segment
+    uint32_t size;
+  };
+
+  std::string SegmentFileName(uint64_t number) const;
+  Status LoadSegments() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  Status AddEntry(const Slice& key, const Slice& data)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void DeleteObsoleteFiles() LOCKS_EXCLUDED(mu_);
+  void Unref(Segment* segment) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  Status SealSegment(Segment* segment) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void DropSegment(Segment* segment) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void EvictOldSegments() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  Env* const env_;
+  const std::string dir_;
+  const uint64_t capacity_;
+  const uint64_t segment_size_;
+
+  port::Mutex mu_;
+  uint64_t next_number_ GUARDED_BY(mu_);
+  uint64_t total_size_ GUARDED_BY(mu_);
+  std::deque<Segment*> segments_ GUARDED_BY(mu_);  // Oldest first
+  Segment* active_ GUARDED_BY(mu_);  // Segment being filled, or nullptr
+  std::unordered_map<std::string, Location> index_ GUARDED_BY(mu_);
+  // Files of dropped segments, to be deleted without holding mu_
+  std::vector<std::string> obsolete_files_ GUARDED_BY(mu_);
+};
+
+LogStructuredCache::LogStructuredCache(Env* env, const std::string& dir,
+                                       uint64_t capacity)
+    : env_(env),
+      dir_(dir),
+      capacity_(capacity),
+      segment_size_(std::min<uint64_t>(std::max<uint64_t>(capacity / 16,
+                                                          4 << 10),
+                                       4 << 20)),
+      next_number_(1),
+      total_size_(0),
+      active_(nullptr) {
+}
+
+LogStructuredCache::~LogStructuredCache() {
+  {
+    MutexLock l(&mu_);
+    if (active_ != nullptr) {
+      Segment* segment = active_;
+      active_ = nullptr;
+      SealSegment(segment);  // Errors only lose cached data
+    }
+    for (size_t i = 0; i < segments_.size(); i++) {
+      Unref(segments_[i]);
+    }
+  }
+  DeleteObsoleteFiles();
+}
+
+std::string LogStructuredCache::SegmentFileName(uint64_t number) const {
+  char buf[100];
+  snprintf(buf, sizeof(buf), "/%06llu.pcache",
+           static_cast<unsigned long long>(number));
+  return dir_ + buf;
+}
+
+void LogStructuredCache::Unref(Segment* segment) {
+  assert(segment->refs > 0);
+  segment->refs--;
+  if (segment->refs == 0) {
+    delete segment->file;
+    delete segment;
+  }
+}
+
+Status LogStructuredCache::Recover() {
+  Status s;
+  {
+    MutexLock l(&mu_);
+    s = LoadSegments();
+  }
+  DeleteObsoleteFiles();
+  return s;
+}
+
+Status LogStructuredCache::LoadSegments() {
+  env_->CreateDir(dir_);  // Ignore error; the directory may already exist
+  std::vector<std::string> filenames;
+  Status s = env_->GetChildren(dir_, &filenames);
+  if (!s.ok()) {
+    return s;
+  }
+  std::vector<uint64_t> numbers;
+  for (size_t i = 0; i < filenames.size(); i++) {
+    Slice rest(filenames[i]);
+    uint64_t number;
+    if (ConsumeDecimalNumber(&rest, &number) && rest == Slice(".pcache")) {
+      numbers.push_back(number);
+    }
+  }
+  std::sort(numbers.begin(), numbers.end());
+
+  for (size_t i = 0; i < numbers.size(); i++) {
+    const std::string fname = SegmentFileName(numbers[i]);
+    next_number_ = numbers[i] + 1;
+    std::string contents;
+    RandomAccessFile* file = nullptr;
+    s = ReadFileToString(env_, fname, &contents);
+    if (s.ok()) {
+      s = env_->NewRandomAccessFile(fname, &file);
+    }
+    if (!s.ok()) {
+      env_->DeleteFile(fname);
+      continue;
+    }
+
+    Segment* segment = new Segment;
+    segment->number = numbers[i];
+    segment->file = file;
+    segment->size = contents.size();
+    segment->refs = 1;
+    size_t pos = 0;
+    while (pos + kHeaderSize <= contents.size()) {
+      const char* header = contents.data() + pos;
+      const uint32_t key_size = DecodeFixed32(header + 4);
+      const uint32_t data_size = DecodeFixed32(header + 8);
+      const uint64_t end = pos + kHeaderSize + uint64_t(key_size) + data_size;
+      if (end > contents.size() ||
+          crc32c::Unmask(DecodeFixed32(header)) !=
+          crc32c::Value(header + 4, end - pos - 4)) {
+        break;
+      }
+      Location location;
+      location.segment = segment;
+      location.offset = pos + kHeaderSize + key_size;
+      location.size = data_size;
+      std::string key(header + kHeaderSize, key_size);
+      index_[key] = location;
+      segment->keys.push_back(key);
+      pos = end;
+    }
+    segments_.push_back(segment);
+    total_size_ += segment->size;
+  }
+  EvictOldSegments();
+  return Status::OK();
+}
+
+Status LogStructuredCache::Insert(const Slice& key, const Slice& data) {
+  Status s;
+  {
+    MutexLock l(&mu_);
+    if (capacity_ == 0) {
+      return Status::OK();
+    }
+    s = AddEntry(key, data);
+    EvictOldSegments();
+  }
+  DeleteObsoleteFiles();
+  return s;
+}
+
+void LogStructuredCache::DeleteObsoleteFiles() {
+  std::vector<std::string> files;
+  {
+    MutexLock l(&mu_);
+    files.swap(obsolete_files_);
+  }
+  for (size_t i = 0; i < files.size(); i++) {
+    env_->DeleteFile(files[i]);
+  }
+}
+
+Status LogStructuredCache::AddEntry(const Slice& key, const Slice& data) {
+  if (active_ == nullptr) {
+    active_ = new Segment;
+    active_->number = next_number_++;
+    active_->file = nullptr;
+    active_->size = 0;
+    active_->refs = 1;
+    segments_.push_back(active_);
+  }
+
+  char header[kHeaderSize];
+  EncodeFixed32(header + 4, key.size());
+  EncodeFixed32(header + 8, data.size());
+  uint32_t crc = crc32c::Value(header + 4, 8);
+  crc = crc32c::Extend(crc, key.data(), key.size());
+  crc = crc32c::Extend(crc, data.data(), data.size());
+  EncodeFixed32(header, crc32c::Mask(crc));
+  std::string* buffer = &active_->buffer;
+  buffer->append(header, kHeaderSize);
+  buffer->append(key.data(), key.size());
+  Location location;
+  location.segment = active_;
+  location.offset = buffer->size();
+  location.size = data.size();
+  buffer->append(data.data(), data.size());
+
+  std::string k = key.ToString();
+  index_[k] = location;
+  active_->keys.push_back(k);
+  total_size_ += buffer->size() - active_->size;
+  active_->size = buffer->size();
+
+  Status s;
+  if (buffer->size() >= segment_size_) {
+    Segment* segment = active_;
+    active_ = nullptr;
+    s = SealSegment(segment);
+  }
+  return s;
+}
+
+// Writes the buffer of "segment", which is no longer being filled, to its
+// file.  Releases mu_ during the I/O.  On failure the segment and its
+// entries are dropped.
+Status LogStructuredCache::SealSegment(Segment* segment) {
+  assert(segment != active_ && segment->file == nullptr);
+  segment->refs++;
+  mu_.Unlock();
+  // Nothing modifies the buffer while the file is nullptr, and lookups
+  // only read it.
+  const std::string fname = SegmentFileName(segment->number);
+  RandomAccessFile* file = nullptr;
+  Status s = WriteStringToFile(env_, segment->buffer, fname);
+  if (s.ok()) {
+    s = env_->NewRandomAccessFile(fname, &file);
+  }
+  mu_.Lock();
+  if (s.ok()) {
+    segment->file = file;
+    std::string empty;
+    segment->buffer.swap(empty);
+  } else {
+    DropSegment(segment);
+  }
+  Unref(segment);
+  return s;
+}
+
+// Removes "segment" from segments_ and drops its entries and file.
+void LogStructuredCache::DropSegment(Segment* segment) {
+  segments_.erase(std::find(segments_.begin(), segments_.end(), segment));
+  for (size_t i = 0; i < segment->keys.size(); i++) {
+    auto iter = index_.find(segment->keys[i]);
+    if (iter != index_.end() && iter->second.segment == segment) {
+      index_.erase(iter);
+    }
+  }
+  total_size_ -= segment->size;
+  obsolete_files_.push_back(SegmentFileName(segment->number));
+  Unref(segment);
+}
+
+// Segments without a file, i.e. the active one and those being written,
+// are not evicted.
+void LogStructuredCache::EvictOldSegments() {
+  while (total_size_ > capacity_ && !segments_.empty() &&
+         segments_.front()->file != nullptr) {
+    DropSegment(segments_.front());
+  }
+}
+
+Status LogStructuredCache::Lookup(const Slice& key, std::string* data) {
+  MutexLock l(&mu_);
+  auto iter = index_.find(key.ToString());
+  if (iter == index_.end()) {
+    return Status::NotFound(Slice());
+  }
+  const Location location = iter->second;
+  Segment* segment = location.segment;
+  if (segment->file == nullptr) {
+    data->assign(segment->buffer.data() + location.offset, location.size);
+    return Status::OK();
+  }
+
+  // Read the segment file without holding the mutex.
+  segment->refs++;
+  mu_.Unlock();
+  data->resize(location.size);
+  Slice result;
+  Status s = segment->file->Read(location.offset, location.size, &result,
+                                 &(*data)[0]);
+  if (s.ok()) {
+    if (result.size() != location.size) {
+      s = Status::Corruption("truncated persistent cache segment");
+    } else if (result.data() != data->data()) {
+      data->assign(result.data(), result.size());
+    }
+  }
+  mu_.Lock();
+  Unref(segment);
+  return s;
+}
+
+uint64_t LogStructuredCache::TotalSize() {
+  MutexLock l(&mu_);
+  return total_size_;
+}
+
+}  // end anonymous namespace
+
+Status NewPersistentCache(Env* env, const std::string& dir,
+                          uint64_t capacity, PersistentCache** result) {
+  LogStructuredCache* cache = new LogStructuredCache(env, dir, capacity);
+  Status s = cache->Recover();
+  if (!s.ok()) {
+    delete cache;
+    cache = nullptr;
+  }
+  *result = cache;
+  return s;
+}
+
+}  // namespace leveldb
@@ -0,0 +1,304 @@
+// Copyright (c) 2012 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/persistent_cache.h"
+
+#include <string>
+#include <vector>
+#include "leveldb/env.h"
+#include "port/port.h"
+#include "util/coding.h"
+#include "util/mutexlock.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+static std::string Key(int i) {
+  std::string result;
+  PutFixed64(&result, 7);
+  PutFixed64(&result, i);
+  return result;
+}
+
+static std::string Value(int i, size_t size = 100) {
+  return std::string(size, static_cast<char>('a' + i % 26));
+}
+
+class PersistentCacheTest {
+ public:
+  static const uint64_t kCapacity = 1 << 20;
+
+  Env* env_;
+  std::string dir_;
+  PersistentCache* cache_;
+
+  PersistentCacheTest()
+      : env_(Env::Default()),
+        dir_(test::TmpDir() + "/persistent_cache_test"),
+        cache_(nullptr) {
+    DestroyDir();
+    Open();
+  }
+
+  ~PersistentCacheTest() {
+    delete cache_;
+    DestroyDir();
+  }
+
+  void Open(uint64_t capacity = kCapacity) {
+    delete cache_;
+    cache_ = nullptr;
+    ASSERT_OK(NewPersistentCache(env_, dir_, capacity, &cache_));
+  }
+
+  void DestroyDir() {
+    std::vector<std::string> files;
+    env_->GetChildren(dir_, &files);
+    for (size_t i = 0; i < files.size(); i++) {
+      env_->DeleteFile(dir_ + "/" + files[i]);
+    }
+    env_->DeleteDir(dir_);
+  }
+
+  std::vector<std::string> SegmentFiles() {
+    std::vector<std::string> files, result;
+    env_->GetChildren(dir_, &files);
+    for (size_t i = 0; i < files.size(); i++) {
+      if (files[i].find(".pcache") != std::string::npos) {
+        result.push_back(dir_ + "/" + files[i]);
+      }
+    }
+    return result;
+  }
+
+  void Insert(int i, size_t size = 100) {
+    ASSERT_OK(cache_->Insert(Key(i), Value(i, size)));
+  }
+
+  std::string Lookup(int i) {
+    std::string data;
+    Status s = cache_->Lookup(Key(i), &data);
+    if (s.IsNotFound()) {
+      return "NOT_FOUND";
+    } else if (!s.ok()) {
+      return s.ToString();
+    }
+    return data;
+  }
+};
+
+TEST(PersistentCacheTest, Empty) {
+  ASSERT_EQ("NOT_FOUND", Lookup(1));
+  ASSERT_EQ(0, cache_->TotalSize());
+}
+
+TEST(PersistentCacheTest, InsertAndLookup) {
+  for (int i = 0; i < 1000; i++) {
+    Insert(i);
+  }
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(Value(i), Lookup(i));
+  }
+  ASSERT_EQ("NOT_FOUND", Lookup(1000));
+
+  // Entries have been written to segment files as well as buffered.
+  ASSERT_GT(SegmentFiles().size(), 0);
+  ASSERT_GT(cache_->TotalSize(), 1000 * 100);
+}
+
+TEST(PersistentCacheTest, Replace) {
+  Insert(1);
+  ASSERT_OK(cache_->Insert(Key(1), "new"));
+  ASSERT_EQ("new", Lookup(1));
+  Open();
+  ASSERT_EQ("new", Lookup(1));
+}
+
+TEST(PersistentCacheTest, Recovery) {
+  for (int i = 0; i < 1000; i++) {
+    Insert(i);
+  }
+  const uint64_t size = cache_->TotalSize();
+  Open();
+  ASSERT_EQ(size, cache_->TotalSize());
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(Value(i), Lookup(i));
+  }
+
+  // New entries go to new segments.
+  Insert(1000);
+  Open();
+  ASSERT_EQ(Value(0), Lookup(0));
+  ASSERT_EQ(Value(1000), Lookup(1000));
+}
+
+TEST(PersistentCacheTest, Eviction) {
+  const uint64_t kSmall = 100 << 10;
+  Open(kSmall);
+  for (int i = 0; i < 2000; i++) {
+    Insert(i);
+    ASSERT_LE(cache_->TotalSize(), kSmall);
+  }
+
+  // The oldest entries were dropped along with their segment files.
+  ASSERT_EQ("NOT_FOUND", Lookup(0));
+  ASSERT_EQ(Value(1999), Lookup(1999));
+  uint64_t on_disk = 0;
+  std::vector<std::string> files = SegmentFiles();
+  for (size_t i = 0; i < files.size(); i++) {
+    uint64_t size;
+    ASSERT_OK(env_->GetFileSize(files[i], &size));
+    on_disk += size;
+  }
+  ASSERT_LE(on_disk, kSmall);
+
+  // Reopening with a smaller capacity drops more.
+  Open(kSmall / 2);
+  ASSERT_LE(cache_->TotalSize(), kSmall / 2);
+  ASSERT_EQ(Value(1999), Lookup(1999));
+}
+
+TEST(PersistentCacheTest, LargeEntry) {
+  Insert(1, 200 << 10);
+  Insert(2);
+  ASSERT_EQ(Value(1, 200 << 10), Lookup(1));
+  Open();
+  ASSERT_EQ(Value(1, 200 << 10), Lookup(1));
+  ASSERT_EQ(Value(2), Lookup(2));
+}
+
+TEST(PersistentCacheTest, TruncatedSegment) {
+  Insert(1);
+  Insert(2);
+  delete cache_;
+  cache_ = nullptr;
+
+  // Cut the last record short, as if the process had crashed while
+  // writing it.
+  std::vector<std::string> files = SegmentFiles();
+  ASSERT_EQ(1, files.size());
+  std::string contents;
+  ASSERT_OK(ReadFileToString(env_, files[0], &contents));
+  contents.resize(contents.size() - 10);
+  ASSERT_OK(WriteStringToFile(env_, contents, files[0]));
+
+  Open();
+  ASSERT_EQ(Value(1), Lookup(1));
+  ASSERT_EQ("NOT_FOUND", Lookup(2));
+}
+
+TEST(PersistentCacheTest, CorruptedRecord) {
+  Insert(1);
+  Insert(2);
+  delete cache_;
+  cache_ = nullptr;
+
+  std::vector<std::string> files = SegmentFiles();
+  ASSERT_EQ(1, files.size());
+  std::string contents;
+  ASSERT_OK(ReadFileToString(env_, files[0], &contents));
+  contents[contents.size() - 1] ^= 0x80;
+  ASSERT_OK(WriteStringToFile(env_, contents, files[0]));
+
+  Open();
+  ASSERT_EQ(Value(1), Lookup(1));
+  ASSERT_EQ("NOT_FOUND", Lookup(2));
+}
+
+// Env that holds up the creation of writable files until Unblock().
+class BlockingWriteEnv : public EnvWrapper {
+ public:
+  explicit BlockingWriteEnv(Env* base)
+      : EnvWrapper(base), cv_(&mu_), blocked_(true), waiting_(false) { }
+
+  Status NewWritableFile(const std::string& f, WritableFile** r) override {
+    {
+      MutexLock l(&mu_);
+      waiting_ = true;
+      cv_.SignalAll();
+      while (blocked_) {
+        cv_.Wait();
+      }
+    }
+    return target()->NewWritableFile(f, r);
+  }
+
+  void WaitForWriter() {
+    MutexLock l(&mu_);
+    while (!waiting_) {
+      cv_.Wait();
+    }
+  }
+
+  void Unblock() {
+    MutexLock l(&mu_);
+    blocked_ = false;
+    cv_.SignalAll();
+  }
+
+ private:
+  port::Mutex mu_;
+  port::CondVar cv_;
+  bool blocked_;
+  bool waiting_;
+};
+
+struct FillState {
+  PersistentCache* cache;
+  int count;
+  port::AtomicPointer done;
+};
+
+static void FillCache(void* arg) {
+  FillState* state = reinterpret_cast<FillState*>(arg);
+  for (int i = 0; i < state->count; i++) {
+    ASSERT_OK(state->cache->Insert(Key(i), Value(i)));
+  }
+  state->done.Release_Store(state);
+}
+
+TEST(PersistentCacheTest, LookupWhileWritingSegment) {
+  BlockingWriteEnv env(env_);
+  delete cache_;
+  cache_ = nullptr;
+  ASSERT_OK(NewPersistentCache(&env, dir_, kCapacity, &cache_));
+
+  // Fill a segment on another thread, which then writes it out.
+  FillState state;
+  state.cache = cache_;
+  state.count = 1000;
+  state.done.Release_Store(nullptr);
+  env_->StartThread(&FillCache, &state);
+  env.WaitForWriter();
+
+  // The entries of the segment are served, and new ones are added, while
+  // the write is held up.
+  ASSERT_EQ(Value(0), Lookup(0));
+  ASSERT_OK(cache_->Insert(Key(5000), Value(5000)));
+  ASSERT_EQ(Value(5000), Lookup(5000));
+
+  env.Unblock();
+  while (state.done.Acquire_Load() == nullptr) {
+    env_->SleepForMicroseconds(1000);
+  }
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(Value(i), Lookup(i));
+  }
+  ASSERT_GT(SegmentFiles().size(), 0);
+  Open();
+  ASSERT_EQ(Value(0), Lookup(0));
+}
+
+TEST(PersistentCacheTest, ZeroCapacity) {
+  Open(0);
+  Insert(1);
+  ASSERT_EQ("NOT_FOUND", Lookup(1));
+  ASSERT_EQ(0, cache_->TotalSize());
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  return leveldb::test::RunAllTests();
+}
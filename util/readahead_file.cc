@@ -0,0 +1,100 @@
+// Copyright (c) 2012 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/readahead_file.h"
+
+#include <string.h>
+#include <string>
+#include "leveldb/env.h"
+
+namespace leveldb {
+
+namespace {
+
+// Size of the first readahead, which then doubles on sequential reads
+static const size_t kInitialReadahead = 8 * 1024;
+
+class ReadaheadRandomAccessFile : public RandomAccessFile {
+ private:
+  RandomAccessFile* const file_;
+  const uint64_t file_size_;
+  const size_t max_readahead_;
+
+  // State of the readahead.  Read() is logically const but updates these.
+  mutable size_t readahead_;       // Size of the last readahead, or 0
+  mutable uint64_t next_offset_;   // Offset just past the last read
+  mutable uint64_t buffer_offset_; // File offset of buffer_[0]
+  mutable size_t buffer_size_;     // Number of valid bytes in buffer_
+  mutable std::string buffer_;
+
+ public:
+  ReadaheadRandomAccessFile(RandomAccessFile* file, uint64_t file_size,
+                            size_t max_readahead)
+      : file_(file),
+        file_size_(file_size),
+        max_readahead_(max_readahead),
+        readahead_(0),
+        next_offset_(0),
+        buffer_offset_(0),
+        buffer_size_(0) {
+  }
+
+  virtual Status Read(uint64_t offset, size_t n, Slice* result,
+                      char* scratch) const {
+    const uint64_t buffer_end = buffer_offset_ + buffer_size_;
+    if (offset >= buffer_offset_ && offset + n <= buffer_end) {
+      // Served by an earlier readahead
+      memcpy(scratch, buffer_.data() + (offset - buffer_offset_), n);
+      *result = Slice(scratch, n);
+      next_offset_ = offset + n;
+      return Status::OK();
+    }
+
+    const bool sequential = (offset == next_offset_) ||
+                            (offset >= buffer_offset_ && offset < buffer_end);
+    next_offset_ = offset + n;
+    if (!sequential || max_readahead_ == 0) {
+      readahead_ = 0;
+      return file_->Read(offset, n, result, scratch);
+    }
+
+    readahead_ = (readahead_ == 0) ? kInitialReadahead : 2 * readahead_;
+    if (readahead_ > max_readahead_) {
+      readahead_ = max_readahead_;
+    }
+    size_t len = n + readahead_;
+    if (offset + len > file_size_) {
+      len = (offset + n > file_size_) ? n : file_size_ - offset;
+    }
+    if (buffer_.size() < len) {
+      buffer_.resize(len);
+    }
+    Slice data;
+    Status s = file_->Read(offset, len, &data, &buffer_[0]);
+    if (!s.ok()) {
+      buffer_size_ = 0;
+      return s;
+    }
+    if (data.data() != buffer_.data()) {
+      memcpy(&buffer_[0], data.data(), data.size());
+    }
+    buffer_offset_ = offset;
+    buffer_size_ = data.size();
+
+    const size_t available = (buffer_size_ < n) ? buffer_size_ : n;
+    memcpy(scratch, buffer_.data(), available);
+    *result = Slice(scratch, available);
+    return Status::OK();
+  }
+};
+
+}  // namespace
+
+RandomAccessFile* NewReadaheadRandomAccessFile(RandomAccessFile* file,
+                                               uint64_t file_size,
+                                               size_t max_readahead) {
+  return new ReadaheadRandomAccessFile(file, file_size, max_readahead);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,31 @@
+// Copyright (c) 2012 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_UTIL_READAHEAD_FILE_H_
+#define STORAGE_LEVELDB_UTIL_READAHEAD_FILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace leveldb {
+
+class RandomAccessFile;
+
+// Return a file that serves reads of "file" and reads ahead once it sees
+// the file being read sequentially, i.e. each read starting where the
+// previous one ended or inside the data it read ahead.  The readahead
+// window starts at a few kilobytes and doubles on every sequential read,
+// up to "max_readahead" bytes; any other read resets it.  Readahead never
+// extends past "file_size", the size of "file".
+//
+// Unlike other RandomAccessFiles, the result is not safe for concurrent
+// use: it is meant for a single iterator.  The caller must delete the
+// result when no longer needed; "file" must outlive it.
+RandomAccessFile* NewReadaheadRandomAccessFile(RandomAccessFile* file,
+                                               uint64_t file_size,
+                                               size_t max_readahead);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_READAHEAD_FILE_H_
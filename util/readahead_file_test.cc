@@ -0,0 +1,108 @@
+// Copyright (c) 2012 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/readahead_file.h"
+
+#include <string.h>
+#include <string>
+#include <vector>
+#include "leveldb/env.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+// In-memory file that records the size of every read
+class RecordingFile : public RandomAccessFile {
+ public:
+  explicit RecordingFile(const std::string& contents) : contents_(contents) { }
+
+  virtual Status Read(uint64_t offset, size_t n, Slice* result,
+                      char* scratch) const {
+    reads_.push_back(n);
+    if (offset + n > contents_.size()) {
+      // Like the mmap-based posix file
+      return Status::InvalidArgument("past end of file");
+    }
+    memcpy(scratch, contents_.data() + offset, n);
+    *result = Slice(scratch, n);
+    return Status::OK();
+  }
+
+  const std::string contents_;
+  mutable std::vector<size_t> reads_;
+};
+
+class ReadaheadFileTest {
+ public:
+  ReadaheadFileTest() {
+    std::string contents;
+    for (int i = 0; i < 1 << 20; i++) {
+      contents.push_back(static_cast<char>(i % 251));
+    }
+    base_ = new RecordingFile(contents);
+    file_ = NewReadaheadRandomAccessFile(base_, contents.size(),
+                                         64 * 1024);
+  }
+
+  ~ReadaheadFileTest() {
+    delete file_;
+    delete base_;
+  }
+
+  // Reads [offset, offset+n) through file_ and checks the data.
+  void CheckRead(uint64_t offset, size_t n) {
+    std::string scratch(n, '\0');
+    Slice result;
+    ASSERT_OK(file_->Read(offset, n, &result, &scratch[0]));
+    ASSERT_EQ(result.data(), scratch.data());
+    ASSERT_EQ(base_->contents_.substr(offset, n), result.ToString());
+  }
+
+  RecordingFile* base_;
+  RandomAccessFile* file_;
+};
+
+TEST(ReadaheadFileTest, Sequential) {
+  const size_t kBlock = 4096;
+  const size_t kBlocks = 200;
+  for (size_t i = 0; i < kBlocks; i++) {
+    CheckRead(i * kBlock, kBlock);
+  }
+
+  // The window grows 8K, 16K, 32K, then stays at 64K
+  ASSERT_LE(base_->reads_.size(), kBlocks * kBlock / (64 * 1024) + 5);
+  ASSERT_EQ(kBlock + 8 * 1024, base_->reads_[0]);
+  ASSERT_EQ(kBlock + 16 * 1024, base_->reads_[1]);
+  ASSERT_EQ(kBlock + 64 * 1024, base_->reads_.back());
+}
+
+TEST(ReadaheadFileTest, Random) {
+  // Reads that do not follow each other are passed through
+  const uint64_t offsets[] = { 500000, 3000, 900000, 100000, 700000 };
+  for (int i = 0; i < 5; i++) {
+    CheckRead(offsets[i], 1000);
+  }
+  ASSERT_EQ(5, base_->reads_.size());
+  for (int i = 0; i < 5; i++) {
+    ASSERT_EQ(1000, base_->reads_[i]);
+  }
+}
+
+TEST(ReadaheadFileTest, EndOfFile) {
+  const uint64_t size = base_->contents_.size();
+  CheckRead(size - 10000, 5000);
+  CheckRead(size - 5000, 5000);
+
+  CheckRead(size - 50, 50);
+
+  // Readahead stopped at the end of the file
+  ASSERT_EQ(2, base_->reads_.size());
+  ASSERT_EQ(5000, base_->reads_[1]);
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  return leveldb::test::RunAllTests();
+}
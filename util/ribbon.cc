@@ -0,0 +1,239 @@
+// Copyright (c) 2012 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A Ribbon filter (Dillinger & Walzer, "Ribbon filter: practically smaller
+// than Bloom and Xor", 2021).  Every key is mapped to an r-bit fingerprint
+// and to a linear equation over GF(2) whose 64 coefficients start at a
+// hashed position among m slots.  Construction solves the system for an
+// r-bit value per slot; a query recomputes the key's equation and checks
+// that the XOR of the selected slot values equals its fingerprint.  The
+// false positive rate is 2^-r at about r * 1.07 bits per key, compared to
+// roughly 1.44 * log2(1/fp) bits per key for a bloom filter.
+//
+// Filter format:
+//    [solution words]  : 8 * r * (m/64) bytes
+//    r                 : 1 byte
+//    seed              : 1 byte
+// The solution is stored in blocks of 64 slots; block b holds r words and
+// bit i of word j of block b is bit j of the value of slot 64*b + i.
+
+#include "leveldb/filter_policy.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+#include "leveldb/slice.h"
+#include "util/coding.h"
+#include "util/hash.h"
+
+namespace leveldb {
+
+namespace {
+
+static const int kMaxResultBits = 16;
+static const int kMaxSeeds = 256;  // Seed must fit in one byte
+
+static uint64_t Mix64(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+static uint64_t KeyHash(const Slice& key) {
+  return (static_cast<uint64_t>(Hash(key.data(), key.size(), 0xbc9f1d34))
+          << 32) | Hash(key.data(), key.size(), 0x3c6ef372);
+}
+
+static int Parity(uint64_t x) {
+  return __builtin_parityll(x);
+}
+
+// The equation of one key for a given seed.
+struct Equation {
+  size_t start;     // First slot covered by coeff
+  uint64_t coeff;   // Bit i set => slot start+i participates; bit 0 is set
+  uint32_t result;  // Fingerprint the selected slots must XOR to
+};
+
+static void MakeEquation(uint64_t key_hash, int seed, size_t slots, int r,
+                         Equation* eq) {
+  const uint64_t a = Mix64(key_hash + seed * 0x9e3779b97f4a7c15ull);
+  const uint64_t b = Mix64(a ^ 0x6a09e667f3bcc909ull);
+  // Starts range over [0, slots - 64] so the window stays in bounds
+  eq->start = static_cast<size_t>(((a >> 32) * (slots - 63)) >> 32);
+  eq->coeff = b | 1;
+  eq->result = static_cast<uint32_t>(a) & ((1u << r) - 1);
+}
+
+// Number of slots used for n keys.  Slightly more slots than keys are
+// needed for the system to be solvable with high probability.
+static size_t NumSlots(size_t n) {
+  size_t slots = n + n / 16 + 64;
+  return (slots + 63) / 64 * 64;
+}
+
+class RibbonFilterPolicy : public FilterPolicy {
+ private:
+  int r_;
+
+ public:
+  explicit RibbonFilterPolicy(int bloom_equivalent_bits_per_key) {
+    // Match the false positive rate of NewBloomFilterPolicy() with the
+    // same number of bits per key.
+    int bits = bloom_equivalent_bits_per_key;
+    if (bits < 1) bits = 1;
+    int k = static_cast<int>(bits * 0.69);
+    if (k < 1) k = 1;
+    if (k > 30) k = 30;
+    const double fp = pow(1.0 - exp(-static_cast<double>(k) / bits), k);
+    r_ = static_cast<int>(ceil(-log2(fp) - 0.001));
+    if (r_ < 1) r_ = 1;
+    if (r_ > kMaxResultBits) r_ = kMaxResultBits;
+  }
+
+  virtual const char* Name() const {
+    return "leveldb.RibbonFilter";
+  }
+
+  virtual void CreateFilter(const Slice* keys, int n, std::string* dst) const {
+    if (n == 0) {
+      // No slots: matches nothing
+      dst->push_back(static_cast<char>(r_));
+      dst->push_back(0);
+      return;
+    }
+
+    std::vector<uint64_t> hashes(n);
+    for (int i = 0; i < n; i++) {
+      hashes[i] = KeyHash(keys[i]);
+    }
+
+    // Banding fails with small probability.  Retry with another seed, and
+    // after a few failures add slots as well.
+    size_t slots = NumSlots(n);
+    std::vector<uint64_t> coeff_rows;
+    std::vector<uint32_t> result_rows;
+    int seed = 0;
+    for (int attempt = 0; ; attempt++) {
+      seed = attempt % kMaxSeeds;
+      if (attempt > 0 && attempt % 4 == 0) {
+        slots += (slots / 8 + 63) / 64 * 64;
+      }
+      if (Band(hashes, slots, seed, &coeff_rows, &result_rows)) {
+        break;
+      }
+    }
+
+    const size_t blocks = slots / 64;
+    const size_t init_size = dst->size();
+    dst->resize(init_size + blocks * r_ * 8);
+    char* out = &(*dst)[init_size];
+    BackSubstitute(coeff_rows, result_rows, out);
+    dst->push_back(static_cast<char>(r_));
+    dst->push_back(static_cast<char>(seed));
+  }
+
+  virtual bool KeyMayMatch(const Slice& key, const Slice& filter) const {
+    const size_t len = filter.size();
+    if (len < 2) return false;
+
+    const int r = static_cast<unsigned char>(filter[len-2]);
+    const int seed = static_cast<unsigned char>(filter[len-1]);
+    if (r < 1 || r > kMaxResultBits || (len - 2) % (8 * r) != 0) {
+      // Reserved for potentially new encodings.  Consider it a match.
+      return true;
+    }
+    const size_t blocks = (len - 2) / (8 * r);
+    if (blocks == 0) return false;
+    const size_t slots = blocks * 64;
+
+    Equation eq;
+    MakeEquation(KeyHash(key), seed, slots, r, &eq);
+    const char* lo = filter.data() + (eq.start / 64) * r * 8;
+    const char* hi = lo + r * 8;
+    const int shift = eq.start % 64;
+    uint32_t result = 0;
+    for (int j = 0; j < r; j++) {
+      uint64_t segment = DecodeFixed64(lo + j * 8) >> shift;
+      if (shift != 0) {
+        segment |= DecodeFixed64(hi + j * 8) << (64 - shift);
+      }
+      result |= Parity(segment & eq.coeff) << j;
+    }
+    return result == eq.result;
+  }
+
+ private:
+  // Gaussian elimination into row echelon form where the row stored at
+  // slot i has bit 0 (slot i) as its leading coefficient.  Returns false
+  // if the system is inconsistent.
+  bool Band(const std::vector<uint64_t>& hashes, size_t slots, int seed,
+            std::vector<uint64_t>* coeff_rows,
+            std::vector<uint32_t>* result_rows) const {
+    coeff_rows->assign(slots, 0);
+    result_rows->assign(slots, 0);
+    for (size_t k = 0; k < hashes.size(); k++) {
+      Equation eq;
+      MakeEquation(hashes[k], seed, slots, r_, &eq);
+      size_t i = eq.start;
+      uint64_t c = eq.coeff;
+      uint32_t rr = eq.result;
+      while (true) {
+        if ((*coeff_rows)[i] == 0) {
+          (*coeff_rows)[i] = c;
+          (*result_rows)[i] = rr;
+          break;
+        }
+        c ^= (*coeff_rows)[i];
+        rr ^= (*result_rows)[i];
+        if (c == 0) {
+          // Redundant (e.g. a duplicate key) if consistent
+          if (rr != 0) return false;
+          break;
+        }
+        const int tz = __builtin_ctzll(c);
+        i += tz;
+        c >>= tz;
+      }
+    }
+    return true;
+  }
+
+  // Solves the banded system from the last slot to the first.  For each
+  // result bit j, state[j] holds the solution bits of the 64 slots that
+  // follow the current one.  Slots without a row are free and get 0.
+  void BackSubstitute(const std::vector<uint64_t>& coeff_rows,
+                      const std::vector<uint32_t>& result_rows,
+                      char* out) const {
+    const size_t slots = coeff_rows.size();
+    uint64_t state[kMaxResultBits] = { 0 };
+    for (size_t i = slots; i-- > 0; ) {
+      const uint64_t c = coeff_rows[i];
+      const uint32_t rr = result_rows[i];
+      for (int j = 0; j < r_; j++) {
+        uint64_t s = state[j] << 1;
+        s |= Parity(s & c) ^ ((rr >> j) & 1);
+        state[j] = s;
+      }
+      if (i % 64 == 0) {
+        // state[j] now holds slots i..i+63, i.e. one whole block
+        char* block = out + (i / 64) * r_ * 8;
+        for (int j = 0; j < r_; j++) {
+          EncodeFixed64(block + j * 8, state[j]);
+        }
+      }
+    }
+  }
+};
+
+}  // namespace
+
+const FilterPolicy* NewRibbonFilterPolicy(int bloom_equivalent_bits_per_key) {
+  return new RibbonFilterPolicy(bloom_equivalent_bits_per_key);
+}
+
+}  // namespace leveldb